@@ -0,0 +1,40 @@
+#ifndef AABB_2D
+#define AABB_2D
+
+#include "vector2.hpp"
+
+// axis aligned bounding box
+struct aabb {
+    vec2 min;
+    vec2 max;
+
+    inline bool overlaps ( const aabb& other ) const;
+    inline bool contains ( const aabb& other ) const;
+
+    inline float perimeter ( ) const;
+};
+
+// two bodies by dense index whose bounds overlap, a < b
+struct body_pair {
+    unsigned int a;
+    unsigned int b;
+};
+
+inline bool aabb::overlaps ( const aabb& other ) const
+{
+    return min.x ( ) <= other.max.x ( ) && other.min.x ( ) <= max.x ( ) &&
+           min.y ( ) <= other.max.y ( ) && other.min.y ( ) <= max.y ( );
+}
+
+inline bool aabb::contains ( const aabb& other ) const
+{
+    return min.x ( ) <= other.min.x ( ) && min.y ( ) <= other.min.y ( ) &&
+           other.max.x ( ) <= max.x ( ) && other.max.y ( ) <= max.y ( );
+}
+
+inline float aabb::perimeter ( ) const
+{
+    return 2.0f * ( ( max.x ( ) - min.x ( ) ) + ( max.y ( ) - min.y ( ) ) );
+}
+
+#endif
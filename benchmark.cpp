@@ -0,0 +1,446 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "profiler.hpp"
+#include "quad_world.hpp"
+#include "scene.hpp"
+
+using namespace std::chrono;
+
+// runs the canned scenes at a range of body counts and reports how the
+// step scales. a summary line per run goes to stderr and the full
+// results to stdout as json, so runs can be diffed or plotted. usage:
+//
+//     rigid_quads_bench [ --scenes pyramid,rain ] [ --bodies 250,1000,4000 ]
+//                       [ --steps 300 ] [ --warmup 30 ] [ --threads 0 ]
+//                       [ --broad-phase grid | sweep | tree ] [ --seed 1 ]
+//
+// the same arguments always build and step the same worlds
+
+namespace {
+
+    const float k_dt = 1.0f / 60.0f;
+    const float k_friction = 0.1f;
+
+    // every allocation while a counter is running, across all threads
+    std::atomic<bool> g_counting { false };
+    std::atomic<unsigned long long> g_allocations { 0 };
+    std::atomic<unsigned long long> g_allocated_bytes { 0 };
+
+    // heap bytes held right now and the most held since the last reset,
+    // always tracked so a run can measure its own peak. each block keeps
+    // its size in front of it, aligned for anything
+    const size_t k_block_header = alignof ( std::max_align_t );
+
+    std::atomic<unsigned long long> g_live_bytes { 0 };
+    std::atomic<unsigned long long> g_peak_bytes { 0 };
+
+    struct options {
+        std::vector<scene_kind> scenes;
+        std::vector<unsigned int> bodies;
+        unsigned int steps;
+        unsigned int warmup;
+        unsigned int threads;
+        unsigned int seed;
+        broad_phase_kind broad_phase;
+    };
+
+    struct result {
+        scene_kind kind;
+        unsigned int bodies;
+        unsigned int world_size;
+        unsigned int threads;
+
+        double build_ms;
+        double steps_per_second;
+        double mean_ms;
+        double p50_ms;
+        double p95_ms;
+        double max_ms;
+
+        // means over the timed steps
+        step_timings phases;
+
+        // candidate pairs through the narrow phase per step, and per
+        // second of narrow phase time
+        double pairs;
+        double pair_tests_per_second;
+
+        unsigned long long allocations;
+        unsigned long long allocated_bytes;
+        // most heap the run held above what was held before it, over
+        // building and stepping the world
+        unsigned long long peak_heap_kb;
+
+        unsigned int awake;
+        unsigned int contacts;
+
+        // per step means, only filled in a PROFILE=1 build
+        double counters [ k_num_counters ];
+    };
+
+    const char* broad_phase_name ( broad_phase_kind kind )
+    {
+        switch ( kind ) {
+            case broad_phase_sweep:
+                return "sweep";
+            case broad_phase_tree:
+                return "tree";
+            default:
+                return "grid";
+        }
+    }
+
+    std::vector<std::string> split ( const std::string& list )
+    {
+        std::vector<std::string> parts;
+        std::stringstream stream { list };
+        std::string part;
+
+        while ( std::getline ( stream, part, ',' ) ) {
+            if ( !part.empty ( ) ) {
+                parts.push_back ( part );
+            }
+        }
+
+        return parts;
+    }
+
+    bool parse_options ( int argc, char** argv, options& opts )
+    {
+        for ( int i = 1; i < argc; ++i ) {
+            std::string arg = argv [ i ];
+
+            if ( i + 1 >= argc ) {
+                std::cerr << "missing value for " << arg << std::endl;
+                return false;
+            }
+
+            std::string value = argv [ ++i ];
+
+            if ( arg == "--scenes" ) {
+                opts.scenes.clear ( );
+
+                for ( const std::string& name : split ( value ) ) {
+                    scene_kind kind = scene_stack;
+
+                    if ( !scene::parse ( name, kind ) ) {
+                        std::cerr << "unknown scene " << name << std::endl;
+                        return false;
+                    }
+
+                    opts.scenes.push_back ( kind );
+                }
+            } else if ( arg == "--bodies" ) {
+                opts.bodies.clear ( );
+
+                for ( const std::string& count : split ( value ) ) {
+                    opts.bodies.push_back ( static_cast<unsigned int> ( std::atoi ( count.c_str ( ) ) ) );
+                }
+            } else if ( arg == "--steps" ) {
+                opts.steps = static_cast<unsigned int> ( std::atoi ( value.c_str ( ) ) );
+            } else if ( arg == "--warmup" ) {
+                opts.warmup = static_cast<unsigned int> ( std::atoi ( value.c_str ( ) ) );
+            } else if ( arg == "--threads" ) {
+                opts.threads = static_cast<unsigned int> ( std::atoi ( value.c_str ( ) ) );
+            } else if ( arg == "--seed" ) {
+                opts.seed = static_cast<unsigned int> ( std::atoi ( value.c_str ( ) ) );
+            } else if ( arg == "--broad-phase" ) {
+                if ( value == "grid" ) {
+                    opts.broad_phase = broad_phase_grid;
+                } else if ( value == "sweep" ) {
+                    opts.broad_phase = broad_phase_sweep;
+                } else if ( value == "tree" ) {
+                    opts.broad_phase = broad_phase_tree;
+                } else {
+                    std::cerr << "unknown broad phase " << value << std::endl;
+                    return false;
+                }
+            } else {
+                std::cerr << "unknown option " << arg << std::endl;
+                return false;
+            }
+        }
+
+        return !opts.scenes.empty ( ) && !opts.bodies.empty ( ) && opts.steps > 0;
+    }
+
+    double elapsed_ms ( steady_clock::time_point start )
+    {
+        return duration<double, std::milli> ( steady_clock::now ( ) - start ).count ( );
+    }
+
+    // value at fraction of the way through sorted
+    double percentile ( const std::vector<double>& sorted, double fraction )
+    {
+        size_t index = static_cast<size_t> ( fraction * ( sorted.size ( ) - 1 ) + 0.5 );
+
+        return sorted [ index ];
+    }
+
+    void add ( step_timings& sum, const step_timings& t )
+    {
+        sum.integrate += t.integrate;
+        sum.broad_phase += t.broad_phase;
+        sum.narrow_phase += t.narrow_phase;
+        sum.solve += t.solve;
+        sum.sleep += t.sleep;
+        sum.total += t.total;
+    }
+
+    void scale ( step_timings& t, double s )
+    {
+        t.integrate *= s;
+        t.broad_phase *= s;
+        t.narrow_phase *= s;
+        t.solve *= s;
+        t.sleep *= s;
+        t.total *= s;
+    }
+
+    result run ( const options& opts, scene_kind kind, unsigned int bodies )
+    {
+        result r { };
+        r.kind = kind;
+        r.bodies = bodies;
+
+        unsigned long long baseline = g_live_bytes;
+        g_peak_bytes = baseline;
+
+        quad_world world;
+
+        world.set_threads ( opts.threads );
+        world.set_broad_phase ( opts.broad_phase );
+        world.set_gravity ( vec2 { 0.0f, -9.8f } );
+
+        scene s { kind, bodies, opts.seed };
+
+        auto start = steady_clock::now ( );
+        s.build ( world );
+        r.build_ms = elapsed_ms ( start );
+
+        // let the caches and the broad phase grow to their working size
+        for ( unsigned int i = 0; i < opts.warmup; ++i ) {
+            world.step ( k_dt, k_friction );
+
+            PROFILE_END_FRAME ( );
+        }
+
+        std::vector<double> step_ms;
+        step_ms.reserve ( opts.steps );
+
+        g_allocations = 0;
+        g_allocated_bytes = 0;
+        g_counting = true;
+
+        for ( unsigned int i = 0; i < opts.steps; ++i ) {
+
+            start = steady_clock::now ( );
+            world.step ( k_dt, k_friction );
+            step_ms.push_back ( elapsed_ms ( start ) );
+
+            add ( r.phases, world.timings ( ) );
+            r.pairs += world.pairs ( ).size ( );
+
+#ifdef RIGID_BODY_PROFILE
+            PROFILE_END_FRAME ( );
+
+            for ( unsigned int c = 0; c < k_num_counters; ++c ) {
+                r.counters [ c ] += profiler::instance ( ).last_frame ( ).counters [ c ];
+            }
+#endif
+        }
+
+        g_counting = false;
+
+        r.allocations = g_allocations;
+        r.allocated_bytes = g_allocated_bytes;
+        r.peak_heap_kb = ( g_peak_bytes - baseline ) / 1024;
+
+        r.world_size = world.size ( );
+        r.threads = world.threads ( );
+        r.awake = world.awake_count ( );
+        r.contacts = static_cast<unsigned int> ( world.contacts ( ).size ( ) );
+
+        double total = 0.0;
+
+        for ( double ms : step_ms ) {
+            total += ms;
+        }
+
+        std::sort ( step_ms.begin ( ), step_ms.end ( ) );
+
+        r.mean_ms = total / opts.steps;
+        r.p50_ms = percentile ( step_ms, 0.5 );
+        r.p95_ms = percentile ( step_ms, 0.95 );
+        r.max_ms = step_ms.back ( );
+        r.steps_per_second = total > 0.0 ? opts.steps * 1000.0 / total : 0.0;
+
+        r.pair_tests_per_second = r.phases.narrow_phase > 0.0 ? r.pairs * 1000.0 / r.phases.narrow_phase : 0.0;
+        r.pairs /= opts.steps;
+
+        scale ( r.phases, 1.0 / opts.steps );
+
+        for ( unsigned int c = 0; c < k_num_counters; ++c ) {
+            r.counters [ c ] /= opts.steps;
+        }
+
+        return r;
+    }
+
+    void print_summary ( const result& r )
+    {
+        char line [ 256 ];
+
+        std::snprintf ( line, sizeof ( line ),
+                        "%-8s %6u bodies %2u threads: %9.1f steps/s, %7.3f ms mean, %7.3f ms p95, "
+                        "%7.2f M pair tests/s, %8llu allocs, %6llu KB heap, %5u awake",
+                        scene::name ( r.kind ), r.bodies, r.threads, r.steps_per_second,
+                        r.mean_ms, r.p95_ms, r.pair_tests_per_second / 1.0e6,
+                        r.allocations, r.peak_heap_kb, r.awake );
+
+        std::cerr << line << std::endl;
+    }
+
+    void print_json ( const options& opts, const std::vector<result>& results )
+    {
+        std::cout << "{\n"
+                  << "  \"steps\": " << opts.steps << ",\n"
+                  << "  \"warmup\": " << opts.warmup << ",\n"
+                  << "  \"dt\": " << k_dt << ",\n"
+                  << "  \"seed\": " << opts.seed << ",\n"
+                  << "  \"broad_phase\": \"" << broad_phase_name ( opts.broad_phase ) << "\",\n"
+                  << "  \"runs\": [\n";
+
+        for ( size_t i = 0; i < results.size ( ); ++i ) {
+            const result& r = results [ i ];
+
+            std::cout << "    {\n"
+                      << "      \"scene\": \"" << scene::name ( r.kind ) << "\",\n"
+                      << "      \"bodies\": " << r.bodies << ",\n"
+                      << "      \"world_size\": " << r.world_size << ",\n"
+                      << "      \"threads\": " << r.threads << ",\n"
+                      << "      \"build_ms\": " << r.build_ms << ",\n"
+                      << "      \"steps_per_second\": " << r.steps_per_second << ",\n"
+                      << "      \"step_ms\": { \"mean\": " << r.mean_ms
+                      << ", \"p50\": " << r.p50_ms
+                      << ", \"p95\": " << r.p95_ms
+                      << ", \"max\": " << r.max_ms << " },\n"
+                      << "      \"phase_ms\": { \"integrate\": " << r.phases.integrate
+                      << ", \"broad_phase\": " << r.phases.broad_phase
+                      << ", \"narrow_phase\": " << r.phases.narrow_phase
+                      << ", \"solve\": " << r.phases.solve
+                      << ", \"sleep\": " << r.phases.sleep << " },\n"
+                      << "      \"pairs\": " << r.pairs << ",\n"
+                      << "      \"pair_tests_per_second\": " << r.pair_tests_per_second << ",\n"
+                      << "      \"allocations\": " << r.allocations << ",\n"
+                      << "      \"allocated_bytes\": " << r.allocated_bytes << ",\n"
+                      << "      \"peak_heap_kb\": " << r.peak_heap_kb << ",\n"
+                      << "      \"awake\": " << r.awake << ",\n"
+                      << "      \"contacts\": " << r.contacts;
+
+#ifdef RIGID_BODY_PROFILE
+            std::cout << ",\n      \"counters\": { ";
+
+            for ( unsigned int c = 0; c < k_num_counters; ++c ) {
+                std::cout << ( c ? ", " : "" ) << "\"" << profiler::counter_name ( static_cast<profile_counter> ( c ) )
+                          << "\": " << r.counters [ c ];
+            }
+
+            std::cout << " }";
+#endif
+
+            std::cout << "\n    }" << ( i + 1 < results.size ( ) ? "," : "" ) << "\n";
+        }
+
+        std::cout << "  ]\n"
+                  << "}" << std::endl;
+    }
+
+}
+
+// count allocations made by the steps, the engine's and the standard
+// library's alike, and keep the heap held for each run's peak
+void* operator new ( size_t size )
+{
+    if ( g_counting.load ( std::memory_order_relaxed ) ) {
+        g_allocations.fetch_add ( 1, std::memory_order_relaxed );
+        g_allocated_bytes.fetch_add ( size, std::memory_order_relaxed );
+    }
+
+    char* block = static_cast<char*> ( std::malloc ( size + k_block_header ) );
+
+    if ( !block ) {
+        throw std::bad_alloc ( );
+    }
+
+    *reinterpret_cast<size_t*> ( block ) = size;
+
+    unsigned long long live = g_live_bytes.fetch_add ( size, std::memory_order_relaxed ) + size;
+    unsigned long long peak = g_peak_bytes.load ( std::memory_order_relaxed );
+
+    // a failed exchange reloads peak, stop once it is at least live
+    while ( live > peak && !g_peak_bytes.compare_exchange_weak ( peak, live, std::memory_order_relaxed ) ) {
+        continue;
+    }
+
+    return block + k_block_header;
+}
+
+void operator delete ( void* p ) noexcept
+{
+    if ( !p ) {
+        return;
+    }
+
+    char* block = static_cast<char*> ( p ) - k_block_header;
+
+    g_live_bytes.fetch_sub ( *reinterpret_cast<size_t*> ( block ), std::memory_order_relaxed );
+    std::free ( block );
+}
+
+void operator delete ( void* p, size_t ) noexcept
+{
+    operator delete ( p );
+}
+
+int main ( int argc, char** argv )
+{
+    options opts;
+    opts.scenes = { scene_pyramid, scene_rain, scene_chain, scene_pile, scene_shapes };
+    opts.bodies = { 250, 1000, 4000 };
+    opts.steps = 300;
+    opts.warmup = 30;
+    opts.threads = 0;
+    opts.seed = 1;
+    opts.broad_phase = broad_phase_grid;
+
+    if ( !parse_options ( argc, argv, opts ) ) {
+        std::cerr << "usage: rigid_quads_bench [ --scenes a,b ] [ --bodies n,m ] [ --steps n ] "
+                     "[ --warmup n ] [ --threads n ] [ --broad-phase grid|sweep|tree ] [ --seed n ]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::vector<result> results;
+
+    for ( scene_kind kind : opts.scenes ) {
+        for ( unsigned int bodies : opts.bodies ) {
+            results.push_back ( run ( opts, kind, bodies ) );
+            print_summary ( results.back ( ) );
+        }
+    }
+
+    print_json ( opts, results );
+
+    return 0;
+}
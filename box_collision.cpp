@@ -0,0 +1,371 @@
+#include "box_collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "fast_math.hpp"
+
+namespace {
+
+    const unsigned int k_box_corners = 4;
+    const unsigned int k_min_fixed_vertices = 3;
+    const unsigned int k_num_fixed_counts = k_max_fixed_vertices - k_min_fixed_vertices + 1;
+
+    // prefer the first box as reference unless the second is clearly better
+    const float k_reference_tolerance = 0.98f;
+
+    // conservative advancement gives up after this many steps, short of
+    // the impact but never past it
+    const unsigned int k_max_toi_iterations = 30;
+
+    template < typename T >
+    struct clip_vertex {
+        vector2<T> point;
+        unsigned int id;
+    };
+
+    inline unsigned int next ( unsigned int i, unsigned int count )
+    {
+        return i + 1 < count ? i + 1 : 0;
+    }
+
+    // outward, not normalized, for a counter clockwise polygon
+    template < typename T, typename Count >
+    inline vector2<T> edge_normal ( const vector2<T>* corners, unsigned int i, Count count )
+    {
+        vector2<T> edge = corners [ next ( i, count ) ] - corners [ i ];
+        return vector2<T> { edge.y ( ), -edge.x ( ) };
+    }
+
+    // finds the edge of a with the largest separation from b. the
+    // separation is compared as sep * |sep| / |n| ^ 2 so no square roots
+    // are needed. returns false if an edge separates the polygons.
+    template < typename T, typename Count_a, typename Count_b >
+    bool find_max_separation ( const vector2<T>* a,
+                               Count_a a_count,
+                               const vector2<T>* b,
+                               Count_b b_count,
+                               unsigned int& best_edge,
+                               T& best_separation )
+    {
+        best_edge = 0;
+        best_separation = std::numeric_limits<T>::lowest ( );
+
+        for ( unsigned int i = 0; i < a_count; ++i ) {
+            vector2<T> n = edge_normal ( a, i, a_count );
+
+            // deepest corner of b along -n
+            T s = n.dot ( b [ 0 ] - a [ i ] );
+
+            for ( unsigned int j = 1; j < b_count; ++j ) {
+                T d = n.dot ( b [ j ] - a [ i ] );
+
+                if ( d < s ) {
+                    s = d;
+                }
+            }
+
+            if ( s > T ( ) ) {
+                return false;
+            }
+
+            T scaled = -( s * s ) / n.dot ( n );
+
+            if ( scaled > best_separation ) {
+                best_separation = scaled;
+                best_edge = i;
+            }
+        }
+
+        return true;
+    }
+
+    // keep the part of the segment behind the plane n . p = offset
+    template < typename T >
+    unsigned int clip_segment ( clip_vertex<T>* out,
+                                const clip_vertex<T>* in,
+                                const vector2<T>& n,
+                                T offset )
+    {
+        unsigned int count = 0;
+
+        T d0 = n.dot ( in [ 0 ].point ) - offset;
+        T d1 = n.dot ( in [ 1 ].point ) - offset;
+
+        if ( d0 <= T ( ) ) {
+            out [ count++ ] = in [ 0 ];
+        }
+
+        if ( d1 <= T ( ) ) {
+            out [ count++ ] = in [ 1 ];
+        }
+
+        // compare the signs, the product of two small distances can
+        // round to zero
+        if ( ( d0 < T ( ) ) != ( d1 < T ( ) ) && d0 != T ( ) && d1 != T ( ) ) {
+            T t = d0 / ( d0 - d1 );
+            out [ count ].point = in [ 0 ].point + ( in [ 1 ].point - in [ 0 ].point ) * t;
+            out [ count ].id = d0 > T ( ) ? in [ 0 ].id : in [ 1 ].id;
+            count++;
+        }
+
+        return count;
+    }
+
+    // contact points from the incident polygon's edge most anti parallel
+    // to the reference polygon's face edge. flip says b is the reference
+    template < typename T, typename Count_r, typename Count_i >
+    bool clip_incident ( const vector2<T>* reference,
+                         Count_r reference_count,
+                         unsigned int edge,
+                         const vector2<T>* incident,
+                         Count_i incident_count,
+                         bool flip,
+                         basic_contact_manifold<T>& manifold )
+    {
+        vector2<T> v1 = reference [ edge ];
+        vector2<T> v2 = reference [ next ( edge, reference_count ) ];
+
+        vector2<T> tangent = v2 - v1;
+        tangent.normalize ( );
+
+        vector2<T> normal { tangent.y ( ), -tangent.x ( ) };
+
+        // the incident edge is the one most anti parallel to the normal
+        unsigned int incident_edge = 0;
+        T min_dot = std::numeric_limits<T>::max ( );
+
+        for ( unsigned int i = 0; i < incident_count; ++i ) {
+            T d = normal.dot ( edge_normal ( incident, i, incident_count ) );
+
+            if ( d < min_dot ) {
+                min_dot = d;
+                incident_edge = i;
+            }
+        }
+
+        unsigned int incident_next = next ( incident_edge, incident_count );
+
+        clip_vertex<T> incident_points [ 2 ] = {
+            clip_vertex<T> { incident [ incident_edge ], incident_edge },
+            clip_vertex<T> { incident [ incident_next ], incident_next }
+        };
+
+        // clip against the side planes of the reference edge
+        clip_vertex<T> clip1 [ 2 ];
+        clip_vertex<T> clip2 [ 2 ];
+
+        if ( clip_segment ( clip1, incident_points, -tangent, -tangent.dot ( v1 ) ) < 2 ) {
+            return false;
+        }
+
+        if ( clip_segment ( clip2, clip1, tangent, tangent.dot ( v2 ) ) < 2 ) {
+            return false;
+        }
+
+        T front = normal.dot ( v1 );
+
+        for ( unsigned int i = 0; i < 2; ++i ) {
+            T separation = normal.dot ( clip2 [ i ].point ) - front;
+
+            if ( separation <= T ( ) ) {
+                basic_contact_point<T>& cp = manifold.points [ manifold.count++ ];
+
+                // halfway between the incident point and the reference face
+                cp.point = clip2 [ i ].point - normal * ( separation * T ( 0.5f ) );
+                cp.separation = separation;
+                cp.id = ( edge << 8 ) | ( clip2 [ i ].id << 1 ) | ( flip ? 1u : 0u );
+            }
+        }
+
+        manifold.normal = flip ? -normal : normal;
+
+        return manifold.count > 0;
+    }
+
+    // the whole test for any mix of fixed and run time counts
+    template < typename T, typename Count_a, typename Count_b >
+    bool collide_convex ( const vector2<T>* a_vertices,
+                          Count_a a_count,
+                          const vector2<T>* b_vertices,
+                          Count_b b_count,
+                          basic_contact_manifold<T>& manifold )
+    {
+        manifold.count = 0;
+
+        unsigned int edge_a = 0;
+        unsigned int edge_b = 0;
+        T separation_a = T ( );
+        T separation_b = T ( );
+
+        if ( !find_max_separation ( a_vertices, a_count, b_vertices, b_count, edge_a, separation_a ) ) {
+            return false;
+        }
+
+        if ( !find_max_separation ( b_vertices, b_count, a_vertices, a_count, edge_b, separation_b ) ) {
+            return false;
+        }
+
+        // the reference polygon owns the face the contact is built against,
+        // separations are negative squares so the tolerance scales them
+        if ( separation_b > separation_a * T ( k_reference_tolerance ) ) {
+            return clip_incident ( b_vertices, b_count, edge_b, a_vertices, a_count, true, manifold );
+        }
+
+        return clip_incident ( a_vertices, a_count, edge_a, b_vertices, b_count, false, manifold );
+    }
+
+    template < typename T, unsigned int A, unsigned int B >
+    bool collide_fixed ( const vector2<T>* a_vertices,
+                         const vector2<T>* b_vertices,
+                         basic_contact_manifold<T>& manifold )
+    {
+        return collide_convex ( a_vertices, fixed_count<A> ( ), b_vertices, fixed_count<B> ( ), manifold );
+    }
+
+    template < typename T >
+    struct fixed_kernels {
+        typedef bool ( *kernel ) ( const vector2<T>* a_vertices,
+                                   const vector2<T>* b_vertices,
+                                   basic_contact_manifold<T>& manifold );
+
+        // by the vertex counts of a then b, from k_min_fixed_vertices
+        static const kernel k_table [ k_num_fixed_counts ][ k_num_fixed_counts ];
+    };
+
+    template < typename T >
+    const typename fixed_kernels<T>::kernel fixed_kernels<T>::k_table [ k_num_fixed_counts ][ k_num_fixed_counts ] = {
+        { collide_fixed<T, 3, 3>, collide_fixed<T, 3, 4>, collide_fixed<T, 3, 5>, collide_fixed<T, 3, 6>, collide_fixed<T, 3, 7>, collide_fixed<T, 3, 8> },
+        { collide_fixed<T, 4, 3>, collide_fixed<T, 4, 4>, collide_fixed<T, 4, 5>, collide_fixed<T, 4, 6>, collide_fixed<T, 4, 7>, collide_fixed<T, 4, 8> },
+        { collide_fixed<T, 5, 3>, collide_fixed<T, 5, 4>, collide_fixed<T, 5, 5>, collide_fixed<T, 5, 6>, collide_fixed<T, 5, 7>, collide_fixed<T, 5, 8> },
+        { collide_fixed<T, 6, 3>, collide_fixed<T, 6, 4>, collide_fixed<T, 6, 5>, collide_fixed<T, 6, 6>, collide_fixed<T, 6, 7>, collide_fixed<T, 6, 8> },
+        { collide_fixed<T, 7, 3>, collide_fixed<T, 7, 4>, collide_fixed<T, 7, 5>, collide_fixed<T, 7, 6>, collide_fixed<T, 7, 7>, collide_fixed<T, 7, 8> },
+        { collide_fixed<T, 8, 3>, collide_fixed<T, 8, 4>, collide_fixed<T, 8, 5>, collide_fixed<T, 8, 6>, collide_fixed<T, 8, 7>, collide_fixed<T, 8, 8> }
+    };
+
+    static_assert ( k_num_fixed_counts == 6, "one row and column of kernels per fixed count" );
+
+    struct box_pose {
+        vec2 center;
+        vec2 axis_x;
+        vec2 axis_y;
+        vec2 half_extents;
+    };
+
+    box_pose pose_at ( const box_sweep& sweep, float t )
+    {
+        float s, c;
+        fast_math::sincos ( sweep.rotation + sweep.angle * t, s, c );
+
+        box_pose pose;
+
+        pose.center = sweep.center + sweep.translation * t;
+        pose.axis_x = vec2 { c, s };
+        pose.axis_y = vec2 { -s, c };
+        pose.half_extents = sweep.half_extents;
+
+        return pose;
+    }
+
+    // half the width of the box projected on a unit axis
+    inline float radius_along ( const box_pose& box, const vec2& axis )
+    {
+        return box.half_extents.x ( ) * std::fabs ( axis.dot ( box.axis_x ) ) +
+               box.half_extents.y ( ) * std::fabs ( axis.dot ( box.axis_y ) );
+    }
+
+    // largest gap along the four face normals, a lower bound on the
+    // distance when apart and minus the penetration when overlapping
+    float separation ( const box_pose& a, const box_pose& b )
+    {
+        const vec2 axes [ 4 ] = { a.axis_x, a.axis_y, b.axis_x, b.axis_y };
+
+        vec2 d = b.center - a.center;
+        float best = std::numeric_limits<float>::lowest ( );
+
+        for ( unsigned int i = 0; i < 4; ++i ) {
+            float gap = std::fabs ( axes [ i ].dot ( d ) ) - radius_along ( a, axes [ i ] ) - radius_along ( b, axes [ i ] );
+
+            best = std::max ( best, gap );
+        }
+
+        return best;
+    }
+
+}
+
+template < typename T >
+bool collide_boxes ( const vector2<T>* a_corners,
+                     const vector2<T>* b_corners,
+                     basic_contact_manifold<T>& manifold )
+{
+    return collide_fixed<T, k_box_corners, k_box_corners> ( a_corners, b_corners, manifold );
+}
+
+template < typename T >
+bool collide_polygons ( const vector2<T>* a_vertices,
+                        unsigned int a_count,
+                        const vector2<T>* b_vertices,
+                        unsigned int b_count,
+                        basic_contact_manifold<T>& manifold )
+{
+    if ( a_count >= k_min_fixed_vertices && a_count <= k_max_fixed_vertices &&
+         b_count >= k_min_fixed_vertices && b_count <= k_max_fixed_vertices ) {
+        return fixed_kernels<T>::k_table [ a_count - k_min_fixed_vertices ][ b_count - k_min_fixed_vertices ] ( a_vertices, b_vertices, manifold );
+    }
+
+    return collide_convex ( a_vertices, runtime_count { a_count }, b_vertices, runtime_count { b_count }, manifold );
+}
+
+template bool collide_boxes<float> ( const vec2*, const vec2*, contact_manifold& );
+template bool collide_boxes<q16_16> ( const vec2_q16*, const vec2_q16*, contact_manifold_q16& );
+template bool collide_polygons<float> ( const vec2*, unsigned int, const vec2*, unsigned int, contact_manifold& );
+template bool collide_polygons<q16_16> ( const vec2_q16*, unsigned int, const vec2_q16*, unsigned int, contact_manifold_q16& );
+
+float box_separation ( const box_sweep& a,
+                       const box_sweep& b,
+                       float t )
+{
+    return separation ( pose_at ( a, t ), pose_at ( b, t ) );
+}
+
+float box_time_of_impact ( const box_sweep& a,
+                           const box_sweep& b,
+                           float target,
+                           float tolerance )
+{
+    // how fast the separation can shrink over the step. a face normal
+    // turning swings the projection of the whole center distance, and
+    // the other box's width along it changes with the relative turn
+    vec2 relative = b.translation - a.translation;
+    float reach = ( b.center - a.center ).mag ( ) + relative.mag ( );
+    float extent = std::max ( a.half_extents.x ( ) + a.half_extents.y ( ),
+                              b.half_extents.x ( ) + b.half_extents.y ( ) );
+
+    float bound = relative.mag ( ) +
+                  std::max ( std::fabs ( a.angle ), std::fabs ( b.angle ) ) * reach +
+                  std::fabs ( a.angle - b.angle ) * extent;
+
+    if ( bound <= 0.0f ) {
+        return 1.0f;
+    }
+
+    float t = 0.0f;
+
+    for ( unsigned int i = 0; i < k_max_toi_iterations; ++i ) {
+        float gap = box_separation ( a, b, t );
+
+        if ( gap <= target + tolerance ) {
+            return t;
+        }
+
+        t += ( gap - target ) / bound;
+
+        if ( t >= 1.0f ) {
+            return 1.0f;
+        }
+    }
+
+    return t;
+}
@@ -0,0 +1,104 @@
+#ifndef BOX_COLLISION
+#define BOX_COLLISION
+
+#include "vector2.hpp"
+
+// the scalar type is float for quad_world or a fixed point type for
+// integer only simulation, both are instantiated in box_collision.cpp
+template < typename T >
+struct basic_contact_point {
+    // halfway between the incident corner and the reference edge,
+    // separation is negative when penetrating
+    vector2<T> point;
+    T separation;
+
+    // which edge and vertex made the point, stable between steps
+    // as long as the same features stay in contact
+    unsigned int id;
+};
+
+template < typename T >
+struct basic_contact_manifold {
+    // unit normal pointing from a to b
+    vector2<T> normal;
+
+    unsigned int count;
+    basic_contact_point<T> points [ 2 ];
+};
+
+using contact_point = basic_contact_point<float>;
+using contact_manifold = basic_contact_manifold<float>;
+using contact_manifold_q16 = basic_contact_manifold<q16_16>;
+
+// a vertex count for the convex kernels, either fixed at compile time
+// so the loops over the edges unroll and wrapping around to the first
+// vertex folds to a constant, or only known at run time
+template < unsigned int N >
+struct fixed_count {
+    constexpr operator unsigned int ( ) const { return N; }
+};
+
+struct runtime_count {
+    unsigned int count;
+
+    operator unsigned int ( ) const { return count; }
+};
+
+// collide_polygons runs a kernel with both counts fixed for polygons of
+// three up to this many vertices
+const unsigned int k_max_fixed_vertices = 8;
+
+// separating axis test between two oriented boxes given by their four
+// corners in counter clockwise order, as rigid_quad_2d keeps them.
+// returns false as soon as an edge of either box separates them, that
+// path only uses dot products. on overlap the manifold holds up to two
+// points clipped from the incident edge against the reference edge.
+template < typename T >
+bool collide_boxes ( const vector2<T>* a_corners,
+                     const vector2<T>* b_corners,
+                     basic_contact_manifold<T>& manifold );
+
+// the same test between convex polygons of any vertex count, also
+// counter clockwise. ids keep the edge and vertex indices so they stay
+// stable the same way. both counts up to k_max_fixed_vertices pick an
+// instance of the test compiled for them from a table, the others run
+// the same test with loops over run time counts
+template < typename T >
+bool collide_polygons ( const vector2<T>* a_vertices,
+                        unsigned int a_count,
+                        const vector2<T>* b_vertices,
+                        unsigned int b_count,
+                        basic_contact_manifold<T>& manifold );
+
+// a box's pose at the start of a step and how far it moves and turns
+// over the step
+struct box_sweep {
+    vec2 center;
+    float rotation;
+    vec2 half_extents;
+
+    vec2 translation;
+    float angle;
+};
+
+// the largest gap between the boxes along their face normals at
+// fraction t of the step. no more than their distance when apart and
+// minus the penetration depth when they overlap
+float box_separation ( const box_sweep& a,
+                       const box_sweep& b,
+                       float t );
+
+// first fraction of the step, 0 to 1, at which the boxes come within
+// target of each other, found by conservative advancement on the
+// separating axis distance. a negative target means that much overlap.
+// each advance is bounded by how fast any point of either box can
+// approach, so the boxes never get closer than target before the
+// returned time, and stop within tolerance of it unless the iterations
+// run out first. returns 1 if they do not meet during the step and
+// 0 if they already are within target at the start.
+float box_time_of_impact ( const box_sweep& a,
+                           const box_sweep& b,
+                           float target,
+                           float tolerance );
+
+#endif
@@ -0,0 +1,543 @@
+#include "broad_phase.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+    // below this many grid entries a single thread is faster
+    const unsigned int k_parallel_entries = 4096;
+
+    // more chunks than threads so stealing can even out busy cells
+    const unsigned int k_chunks_per_thread = 4;
+
+    const int k_null_proxy = dynamic_aabb_tree::k_null_node;
+
+    inline body_pair make_pair ( unsigned int a, unsigned int b )
+    {
+        return a < b ? body_pair { a, b } : body_pair { b, a };
+    }
+
+    inline unsigned long long pair_key ( int a, int b )
+    {
+        unsigned long long lo = static_cast<unsigned long long> ( a < b ? a : b );
+        unsigned long long hi = static_cast<unsigned long long> ( a < b ? b : a );
+
+        return ( lo << 32 ) | hi;
+    }
+
+    inline int key_first ( unsigned long long key ) { return static_cast<int> ( key >> 32 ); }
+    inline int key_second ( unsigned long long key ) { return static_cast<int> ( key & 0xffffffffu ); }
+
+}
+
+void broad_phase::remove ( unsigned int, unsigned int )
+{
+
+}
+
+void broad_phase::clear ( )
+{
+
+}
+
+void broad_phase::swap ( unsigned int, unsigned int )
+{
+
+}
+
+void broad_phase::query ( const aabb* bounds,
+                          unsigned int count,
+                          const aabb& box,
+                          std::vector<unsigned int>& out )
+{
+    for ( unsigned int i = 0; i < count; ++i ) {
+        if ( bounds [ i ].overlaps ( box ) ) {
+            out.push_back ( i );
+        }
+    }
+}
+
+void broad_phase::ray_cast ( const aabb* bounds,
+                             unsigned int count,
+                             const vec2& from,
+                             const vec2& to,
+                             const ray_callback& callback )
+{
+    vec2 delta = to - from;
+    float max_fraction = 1.0f;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        if ( !aabb_util::segment_overlaps ( bounds [ i ], from, delta, max_fraction ) ) {
+            continue;
+        }
+
+        float fraction = callback ( i, max_fraction );
+
+        if ( fraction == 0.0f ) {
+            return;
+        }
+
+        max_fraction = std::min ( max_fraction, fraction );
+    }
+}
+
+spatial_hash_grid::spatial_hash_grid ( float cell_size ) :
+    m_cell_size { 0.0f },
+    m_inv_cell_size { 0.0f },
+    m_table_mask { 0 }
+{
+    set_cell_size ( cell_size );
+}
+
+void spatial_hash_grid::set_cell_size ( float cell_size )
+{
+    m_cell_size = cell_size;
+    m_inv_cell_size = 1.0f / cell_size;
+}
+
+inline int spatial_hash_grid::cell ( float v ) const
+{
+    return static_cast<int> ( floor ( v * m_inv_cell_size ) );
+}
+
+inline unsigned int spatial_hash_grid::hash ( int x, int y ) const
+{
+    return ( ( static_cast<unsigned int> ( x ) * 73856093u ) ^
+             ( static_cast<unsigned int> ( y ) * 19349663u ) ) & m_table_mask;
+}
+
+void spatial_hash_grid::find_pairs ( const aabb* bounds,
+                                     unsigned int count,
+                                     std::vector<body_pair>& pairs )
+{
+    pairs.clear ( );
+
+    // count how many cells every body touches to size the table
+    unsigned int total = 0;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        unsigned int w = static_cast<unsigned int> ( cell ( bounds [ i ].max.x ( ) ) - cell ( bounds [ i ].min.x ( ) ) + 1 );
+        unsigned int h = static_cast<unsigned int> ( cell ( bounds [ i ].max.y ( ) ) - cell ( bounds [ i ].min.y ( ) ) + 1 );
+        total += w * h;
+    }
+
+    unsigned int table_size = 64;
+
+    while ( table_size < total * 2 ) {
+        table_size <<= 1;
+    }
+
+    m_table_mask = table_size - 1;
+
+    // counting sort of the entries by bucket, bucket_start ends up
+    // holding the first entry of each bucket
+    m_bucket_start.assign ( table_size + 1, 0 );
+    m_entries.resize ( total );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        int x1 = cell ( bounds [ i ].max.x ( ) );
+        int y1 = cell ( bounds [ i ].max.y ( ) );
+
+        for ( int y = cell ( bounds [ i ].min.y ( ) ); y <= y1; ++y ) {
+            for ( int x = cell ( bounds [ i ].min.x ( ) ); x <= x1; ++x ) {
+                m_bucket_start [ hash ( x, y ) ]++;
+            }
+        }
+    }
+
+    for ( unsigned int b = 1; b <= table_size; ++b ) {
+        m_bucket_start [ b ] += m_bucket_start [ b - 1 ];
+    }
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        int x1 = cell ( bounds [ i ].max.x ( ) );
+        int y1 = cell ( bounds [ i ].max.y ( ) );
+
+        for ( int y = cell ( bounds [ i ].min.y ( ) ); y <= y1; ++y ) {
+            for ( int x = cell ( bounds [ i ].min.x ( ) ); x <= x1; ++x ) {
+                m_entries [ --m_bucket_start [ hash ( x, y ) ] ] = entry { i, x, y };
+            }
+        }
+    }
+
+    // split the buckets between the threads when there is enough to go around
+    if ( !m_pool || m_pool->size ( ) == 1 || total < k_parallel_entries ) {
+        test_buckets ( bounds, 0, table_size, pairs );
+        return;
+    }
+
+    unsigned int chunks = m_pool->size ( ) * k_chunks_per_thread;
+    unsigned int grain = ( table_size + chunks - 1 ) / chunks;
+
+    m_chunk_pairs.resize ( chunks );
+
+    m_pool->parallel_for ( table_size, grain, [ this, bounds, grain ] ( unsigned int first, unsigned int last ) {
+        std::vector<body_pair>& out = m_chunk_pairs [ first / grain ];
+        out.clear ( );
+        test_buckets ( bounds, first, last, out );
+    } );
+
+    // joined in bucket order, same as the serial walk
+    for ( unsigned int c = 0; c * grain < table_size; ++c ) {
+        pairs.insert ( pairs.end ( ), m_chunk_pairs [ c ].begin ( ), m_chunk_pairs [ c ].end ( ) );
+    }
+}
+
+void spatial_hash_grid::test_buckets ( const aabb* bounds,
+                                       unsigned int first_bucket,
+                                       unsigned int last_bucket,
+                                       std::vector<body_pair>& pairs ) const
+{
+    // test everything sharing a cell
+    for ( unsigned int b = first_bucket; b < last_bucket; ++b ) {
+        unsigned int end = m_bucket_start [ b + 1 ];
+
+        for ( unsigned int i = m_bucket_start [ b ]; i < end; ++i ) {
+            const entry& first = m_entries [ i ];
+            const aabb& first_bounds = bounds [ first.body ];
+
+            for ( unsigned int j = i + 1; j < end; ++j ) {
+                const entry& second = m_entries [ j ];
+
+                // different cells that landed in the same bucket
+                if ( first.cell_x != second.cell_x ||
+                     first.cell_y != second.cell_y ) {
+                    continue;
+                }
+
+                const aabb& second_bounds = bounds [ second.body ];
+
+                if ( !first_bounds.overlaps ( second_bounds ) ) {
+                    continue;
+                }
+
+                // only the cell holding the min corner of the overlap reports
+                float min_x = std::max ( first_bounds.min.x ( ), second_bounds.min.x ( ) );
+                float min_y = std::max ( first_bounds.min.y ( ), second_bounds.min.y ( ) );
+
+                if ( cell ( min_x ) == first.cell_x &&
+                     cell ( min_y ) == first.cell_y ) {
+                    pairs.push_back ( make_pair ( first.body, second.body ) );
+                }
+            }
+        }
+    }
+}
+
+sweep_and_prune::sweep_and_prune ( )
+{
+
+}
+
+void sweep_and_prune::find_pairs ( const aabb* bounds,
+                                   unsigned int count,
+                                   std::vector<body_pair>& pairs )
+{
+    pairs.clear ( );
+
+    // bodies were added or removed, start the order over
+    if ( m_order.size ( ) != count ) {
+        m_order.resize ( count );
+
+        for ( unsigned int i = 0; i < count; ++i ) {
+            m_order [ i ] = i;
+        }
+
+        std::sort ( m_order.begin ( ), m_order.end ( ),
+                    [ bounds ] ( unsigned int a, unsigned int b ) {
+                        return bounds [ a ].min.x ( ) < bounds [ b ].min.x ( );
+                    } );
+    }
+
+    // insertion sort on min x, cheap when the order barely changed
+    for ( unsigned int i = 1; i < count; ++i ) {
+        unsigned int body = m_order [ i ];
+        float key = bounds [ body ].min.x ( );
+        unsigned int j = i;
+
+        while ( j > 0 && bounds [ m_order [ j - 1 ] ].min.x ( ) > key ) {
+            m_order [ j ] = m_order [ j - 1 ];
+            --j;
+        }
+
+        m_order [ j ] = body;
+    }
+
+    // sweep, everything starting before the current body ends overlaps on x
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const aabb& first = bounds [ m_order [ i ] ];
+
+        for ( unsigned int j = i + 1; j < count; ++j ) {
+            const aabb& second = bounds [ m_order [ j ] ];
+
+            if ( second.min.x ( ) > first.max.x ( ) ) {
+                break;
+            }
+
+            if ( first.min.y ( ) <= second.max.y ( ) &&
+                 second.min.y ( ) <= first.max.y ( ) ) {
+                pairs.push_back ( make_pair ( m_order [ i ], m_order [ j ] ) );
+            }
+        }
+    }
+}
+
+aabb_tree_broad_phase::aabb_tree_broad_phase ( float margin ) :
+    m_tree { margin }
+{
+
+}
+
+void aabb_tree_broad_phase::set_flag ( int proxy, unsigned char flag )
+{
+    if ( static_cast<unsigned int> ( proxy ) >= m_flags.size ( ) ) {
+        m_flags.resize ( proxy + 1, 0 );
+    }
+
+    m_flags [ proxy ] |= flag;
+}
+
+void aabb_tree_broad_phase::flush_removed ( )
+{
+    unsigned int kept = 0;
+
+    for ( unsigned int i = 0; i < m_pairs.size ( ); ++i ) {
+        if ( !( m_flags [ key_first ( m_pairs [ i ] ) ] & flag_removed ) &&
+             !( m_flags [ key_second ( m_pairs [ i ] ) ] & flag_removed ) ) {
+            m_pairs [ kept++ ] = m_pairs [ i ];
+        }
+    }
+
+    m_pairs.resize ( kept );
+
+    for ( unsigned int i = 0; i < m_removed.size ( ); ++i ) {
+        m_flags [ m_removed [ i ] ] = 0;
+    }
+
+    m_removed.clear ( );
+}
+
+void aabb_tree_broad_phase::sync ( const aabb* bounds, unsigned int count )
+{
+    // pairs with destroyed bodies end without being reported, their
+    // proxies get reused below so drop them first
+    if ( !m_removed.empty ( ) ) {
+        flush_removed ( );
+    }
+
+    unsigned int existing = static_cast<unsigned int> ( m_proxies.size ( ) );
+
+    // new bodies are appended at the end of the dense range
+    m_proxies.resize ( count, k_null_proxy );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        int proxy = m_proxies [ i ];
+
+        if ( i < existing && proxy != k_null_proxy ) {
+            if ( m_tree.move ( proxy, bounds [ i ] ) &&
+                 !( m_flags [ proxy ] & flag_moved ) ) {
+                set_flag ( proxy, flag_moved );
+                m_moved.push_back ( proxy );
+            }
+
+            continue;
+        }
+
+        if ( proxy != k_null_proxy ) {
+            continue;
+        }
+
+        proxy = m_tree.insert ( bounds [ i ], i );
+        m_proxies [ i ] = proxy;
+
+        if ( static_cast<unsigned int> ( proxy ) < m_flags.size ( ) ) {
+            m_flags [ proxy ] = 0;
+        }
+
+        set_flag ( proxy, flag_moved );
+        m_moved.push_back ( proxy );
+    }
+}
+
+void aabb_tree_broad_phase::find_pairs ( const aabb* bounds,
+                                         unsigned int count,
+                                         std::vector<body_pair>& pairs )
+{
+    pairs.clear ( );
+    m_begun.clear ( );
+    m_ended.clear ( );
+
+    sync ( bounds, count );
+
+    // only proxies that were reinserted can have new overlaps
+    m_candidates.clear ( );
+
+    for ( unsigned int i = 0; i < m_moved.size ( ); ++i ) {
+        int proxy = m_moved [ i ];
+
+        m_tree.query ( m_tree.fat_bounds ( proxy ),
+                       [ this, proxy ] ( int other ) {
+                           // both moved, the lower proxy reports it
+                           if ( other == proxy ||
+                                ( ( m_flags [ other ] & flag_moved ) && other < proxy ) ) {
+                               return true;
+                           }
+
+                           m_candidates.push_back ( pair_key ( proxy, other ) );
+                           return true;
+                       } );
+    }
+
+    std::sort ( m_candidates.begin ( ), m_candidates.end ( ) );
+
+    // merge the old pairs with the candidates, old pairs with a moved
+    // proxy that are not candidates any more have ended
+    m_next.clear ( );
+
+    unsigned int old_i = 0;
+    unsigned int new_i = 0;
+
+    while ( old_i < m_pairs.size ( ) || new_i < m_candidates.size ( ) ) {
+        if ( new_i == m_candidates.size ( ) ||
+             ( old_i < m_pairs.size ( ) && m_pairs [ old_i ] < m_candidates [ new_i ] ) ) {
+            unsigned long long key = m_pairs [ old_i++ ];
+            int a = key_first ( key );
+            int b = key_second ( key );
+
+            if ( ( m_flags [ a ] | m_flags [ b ] ) & flag_moved ) {
+                m_ended.push_back ( make_pair ( m_tree.user_data ( a ), m_tree.user_data ( b ) ) );
+            } else {
+                m_next.push_back ( key );
+            }
+        } else if ( old_i == m_pairs.size ( ) || m_candidates [ new_i ] < m_pairs [ old_i ] ) {
+            unsigned long long key = m_candidates [ new_i++ ];
+
+            m_begun.push_back ( make_pair ( m_tree.user_data ( key_first ( key ) ),
+                                            m_tree.user_data ( key_second ( key ) ) ) );
+            m_next.push_back ( key );
+        } else {
+            m_next.push_back ( m_pairs [ old_i++ ] );
+            new_i++;
+        }
+    }
+
+    m_pairs.swap ( m_next );
+
+    for ( unsigned int i = 0; i < m_moved.size ( ); ++i ) {
+        m_flags [ m_moved [ i ] ] &= static_cast<unsigned char> ( ~flag_moved );
+    }
+
+    m_moved.clear ( );
+
+    // fat bounds overlapping is not enough for the narrow phase
+    for ( unsigned int i = 0; i < m_pairs.size ( ); ++i ) {
+        unsigned int a = m_tree.user_data ( key_first ( m_pairs [ i ] ) );
+        unsigned int b = m_tree.user_data ( key_second ( m_pairs [ i ] ) );
+
+        if ( bounds [ a ].overlaps ( bounds [ b ] ) ) {
+            pairs.push_back ( make_pair ( a, b ) );
+        }
+    }
+}
+
+void aabb_tree_broad_phase::remove ( unsigned int index, unsigned int last )
+{
+    if ( index >= m_proxies.size ( ) ) {
+        return;
+    }
+
+    int proxy = m_proxies [ index ];
+
+    if ( proxy != k_null_proxy ) {
+        m_tree.remove ( proxy );
+
+        // a removed proxy can not stay on the moved list
+        if ( m_flags [ proxy ] & flag_moved ) {
+            m_moved.erase ( std::find ( m_moved.begin ( ), m_moved.end ( ), proxy ) );
+        }
+
+        m_flags [ proxy ] = flag_removed;
+        m_removed.push_back ( proxy );
+    }
+
+    // the last body may not have been synced yet, then its
+    // proxy comes in with the next sync
+    if ( last < m_proxies.size ( ) ) {
+        if ( index != last ) {
+            m_proxies [ index ] = m_proxies [ last ];
+
+            if ( m_proxies [ index ] != k_null_proxy ) {
+                m_tree.set_user_data ( m_proxies [ index ], index );
+            }
+        }
+
+        m_proxies.pop_back ( );
+    } else {
+        m_proxies [ index ] = k_null_proxy;
+    }
+}
+
+void aabb_tree_broad_phase::swap ( unsigned int a, unsigned int b )
+{
+    unsigned int needed = std::max ( a, b ) + 1;
+
+    if ( m_proxies.size ( ) < needed ) {
+        m_proxies.resize ( needed, k_null_proxy );
+    }
+
+    std::swap ( m_proxies [ a ], m_proxies [ b ] );
+
+    if ( m_proxies [ a ] != k_null_proxy ) {
+        m_tree.set_user_data ( m_proxies [ a ], a );
+    }
+
+    if ( m_proxies [ b ] != k_null_proxy ) {
+        m_tree.set_user_data ( m_proxies [ b ], b );
+    }
+}
+
+void aabb_tree_broad_phase::clear ( )
+{
+    m_tree.clear ( );
+    m_proxies.clear ( );
+    m_moved.clear ( );
+    m_removed.clear ( );
+    m_flags.clear ( );
+    m_pairs.clear ( );
+}
+
+void aabb_tree_broad_phase::query ( const aabb* bounds,
+                                    unsigned int count,
+                                    const aabb& box,
+                                    std::vector<unsigned int>& out )
+{
+    sync ( bounds, count );
+
+    m_tree.query ( box,
+                   [ this, bounds, &box, &out ] ( int proxy ) {
+                       unsigned int index = m_tree.user_data ( proxy );
+
+                       if ( bounds [ index ].overlaps ( box ) ) {
+                           out.push_back ( index );
+                       }
+
+                       return true;
+                   } );
+}
+
+void aabb_tree_broad_phase::ray_cast ( const aabb* bounds,
+                                       unsigned int count,
+                                       const vec2& from,
+                                       const vec2& to,
+                                       const ray_callback& callback )
+{
+    sync ( bounds, count );
+
+    m_tree.ray_cast ( from, to,
+                      [ this, &callback ] ( int proxy, float max_fraction ) {
+                          return callback ( m_tree.user_data ( proxy ), max_fraction );
+                      } );
+}
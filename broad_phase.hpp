@@ -0,0 +1,188 @@
+#ifndef BROAD_PHASE
+#define BROAD_PHASE
+
+#include <functional>
+#include <vector>
+
+#include "aabb.hpp"
+#include "dynamic_aabb_tree.hpp"
+
+class thread_pool;
+
+enum broad_phase_kind {
+    broad_phase_grid,
+    broad_phase_sweep,
+    broad_phase_tree,
+    k_num_broad_phase_kinds
+};
+
+// finds the pairs of bodies whose bounds overlap so the narrow phase
+// only runs on candidates instead of every pair
+class broad_phase {
+public:
+    // called with a body and the fraction the ray is clipped to so far,
+    // returns the new fraction to clip to, 0 ends the cast
+    typedef std::function<float ( unsigned int index, float max_fraction )> ray_callback;
+
+    broad_phase ( ) : m_pool { nullptr } { }
+    virtual ~broad_phase ( ) { }
+
+    // bounds are indexed by dense body index, pairs is cleared first
+    virtual void find_pairs ( const aabb* bounds,
+                              unsigned int count,
+                              std::vector<body_pair>& pairs ) = 0;
+
+    // the body at index was destroyed and the last body moved into its slot
+    virtual void remove ( unsigned int index, unsigned int last );
+    virtual void clear ( );
+
+    // the bodies at a and b traded dense indices
+    virtual void swap ( unsigned int a, unsigned int b );
+
+    // bodies whose bounds overlap box, appended to out
+    virtual void query ( const aabb* bounds,
+                         unsigned int count,
+                         const aabb& box,
+                         std::vector<unsigned int>& out );
+
+    // bodies whose bounds the segment from -> to passes through
+    virtual void ray_cast ( const aabb* bounds,
+                            unsigned int count,
+                            const vec2& from,
+                            const vec2& to,
+                            const ray_callback& callback );
+
+    // pairs that started or stopped overlapping in the last find_pairs,
+    // only filled by broad phases that keep pairs between steps
+    const std::vector<body_pair>& begun_pairs ( ) const { return m_begun; }
+    const std::vector<body_pair>& ended_pairs ( ) const { return m_ended; }
+
+    // broad phases that can split their work use the pool when set
+    void set_thread_pool ( thread_pool* pool ) { m_pool = pool; }
+
+protected:
+
+    std::vector<body_pair> m_begun;
+    std::vector<body_pair> m_ended;
+
+    thread_pool* m_pool;
+};
+
+// uniform grid hashed into a flat table, rebuilt every call. a body is
+// entered into every cell its bounds touch and a pair is only reported
+// from the cell holding the min corner of the two bounds' intersection,
+// so nothing is reported twice. with a thread pool the buckets are
+// tested in parallel chunks and the chunk results joined in order.
+class spatial_hash_grid : public broad_phase {
+public:
+    explicit spatial_hash_grid ( float cell_size = 0.25f );
+
+    void find_pairs ( const aabb* bounds,
+                      unsigned int count,
+                      std::vector<body_pair>& pairs ) override;
+
+    void set_cell_size ( float cell_size );
+    float cell_size ( ) const { return m_cell_size; }
+
+private:
+
+    struct entry {
+        unsigned int body;
+        int cell_x;
+        int cell_y;
+    };
+
+    inline int cell ( float v ) const;
+    inline unsigned int hash ( int x, int y ) const;
+
+    // report the pairs sharing a cell in buckets [ first, last )
+    void test_buckets ( const aabb* bounds,
+                        unsigned int first,
+                        unsigned int last,
+                        std::vector<body_pair>& pairs ) const;
+
+    float m_cell_size;
+    float m_inv_cell_size;
+
+    unsigned int m_table_mask;
+
+    std::vector<unsigned int> m_bucket_start;
+    std::vector<entry> m_entries;
+
+    std::vector<std::vector<body_pair>> m_chunk_pairs;
+};
+
+// sweep and prune along x. the sorted order is kept between calls and
+// fixed up with an insertion sort, which is close to linear when bodies
+// only move a little per step.
+class sweep_and_prune : public broad_phase {
+public:
+    sweep_and_prune ( );
+
+    void find_pairs ( const aabb* bounds,
+                      unsigned int count,
+                      std::vector<body_pair>& pairs ) override;
+
+private:
+
+    std::vector<unsigned int> m_order;
+};
+
+// dynamic aabb tree with one fat proxy per body. only proxies whose tight
+// bounds left their fat bounds are reinserted and queried for new
+// overlaps, the rest of the pairs carry over from the last step.
+class aabb_tree_broad_phase : public broad_phase {
+public:
+    explicit aabb_tree_broad_phase ( float margin = 0.02f );
+
+    void find_pairs ( const aabb* bounds,
+                      unsigned int count,
+                      std::vector<body_pair>& pairs ) override;
+
+    void remove ( unsigned int index, unsigned int last ) override;
+    void clear ( ) override;
+    void swap ( unsigned int a, unsigned int b ) override;
+
+    void query ( const aabb* bounds,
+                 unsigned int count,
+                 const aabb& box,
+                 std::vector<unsigned int>& out ) override;
+
+    void ray_cast ( const aabb* bounds,
+                    unsigned int count,
+                    const vec2& from,
+                    const vec2& to,
+                    const ray_callback& callback ) override;
+
+    const dynamic_aabb_tree& tree ( ) const { return m_tree; }
+
+private:
+
+    enum proxy_flag {
+        flag_moved = 1,
+        flag_removed = 2
+    };
+
+    // bring the proxies in line with the current bounds
+    void sync ( const aabb* bounds, unsigned int count );
+    void flush_removed ( );
+
+    void set_flag ( int proxy, unsigned char flag );
+
+    dynamic_aabb_tree m_tree;
+
+    // proxy of every body by dense index, null for bodies that were
+    // swapped in before their first sync
+    std::vector<int> m_proxies;
+
+    std::vector<int> m_moved;
+    std::vector<int> m_removed;
+    std::vector<unsigned char> m_flags;
+
+    // overlapping fat proxies, sorted, low proxy in the high bits
+    std::vector<unsigned long long> m_pairs;
+    std::vector<unsigned long long> m_candidates;
+    std::vector<unsigned long long> m_next;
+};
+
+#endif
@@ -0,0 +1,736 @@
+#include "contact_solver.hpp"
+
+#include <algorithm>
+
+#include "profiler.hpp"
+#include "quad_world.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+    // largest condition number of the two point mass matrix the
+    // block solver is trusted with
+    const float k_max_condition = 1000.0f;
+
+    // candidate pairs per narrow phase task
+    const unsigned int k_pair_grain = 256;
+
+    const unsigned int k_no_island = ~0u;
+
+    struct body_velocities {
+        float* vx;
+        float* vy;
+        float* w;
+        const float* inv_mass;
+        const float* inv_inertia;
+    };
+
+    body_velocities gather ( quad_world& world )
+    {
+        body_velocities v;
+
+        v.vx = world.data ( quad_world::s_velocity_x );
+        v.vy = world.data ( quad_world::s_velocity_y );
+        v.w = world.data ( quad_world::s_angular_velocity );
+        v.inv_mass = world.data ( quad_world::s_inv_mass );
+        v.inv_inertia = world.data ( quad_world::s_inv_inertia );
+
+        return v;
+    }
+
+    joint_bodies gather_joints ( quad_world& world )
+    {
+        joint_bodies v;
+
+        v.vx = world.data ( quad_world::s_velocity_x );
+        v.vy = world.data ( quad_world::s_velocity_y );
+        v.w = world.data ( quad_world::s_angular_velocity );
+        v.inv_mass = world.data ( quad_world::s_inv_mass );
+        v.inv_inertia = world.data ( quad_world::s_inv_inertia );
+        v.center_x = world.data ( quad_world::s_center_x );
+        v.center_y = world.data ( quad_world::s_center_y );
+        v.rotation = world.data ( quad_world::s_rotation );
+
+        return v;
+    }
+
+    inline float cross ( const vec2& a, const vec2& b )
+    {
+        return a.x ( ) * b.y ( ) - a.y ( ) * b.x ( );
+    }
+
+    // velocity of the point r away from the center of body i
+    inline vec2 point_velocity ( const body_velocities& v, unsigned int i, const vec2& r )
+    {
+        return vec2 { v.vx [ i ] - v.w [ i ] * r.y ( ),
+                      v.vy [ i ] + v.w [ i ] * r.x ( ) };
+    }
+
+    inline void apply ( const body_velocities& v,
+                        unsigned int a,
+                        unsigned int b,
+                        const vec2& r_a,
+                        const vec2& r_b,
+                        const vec2& impulse )
+    {
+        // static bodies are shared between islands solved on different
+        // threads, so never write to them even though the change is zero
+        if ( v.inv_mass [ a ] > 0.0f ) {
+            v.vx [ a ] -= impulse.x ( ) * v.inv_mass [ a ];
+            v.vy [ a ] -= impulse.y ( ) * v.inv_mass [ a ];
+            v.w [ a ] -= cross ( r_a, impulse ) * v.inv_inertia [ a ];
+        }
+
+        if ( v.inv_mass [ b ] > 0.0f ) {
+            v.vx [ b ] += impulse.x ( ) * v.inv_mass [ b ];
+            v.vy [ b ] += impulse.y ( ) * v.inv_mass [ b ];
+            v.w [ b ] += cross ( r_b, impulse ) * v.inv_inertia [ b ];
+        }
+    }
+
+    bool by_key ( const contact_constraint& lhs, const contact_constraint& rhs )
+    {
+        return lhs.key < rhs.key;
+    }
+
+    // solves both normal impulses of a two point manifold at once as a
+    // linear complementarity problem, trying each of the four cases of
+    // which points are touching. solving them one after the other leaves
+    // an uneven split between the points that shows up as rotation.
+    void solve_block ( const body_velocities& v, contact_constraint& c )
+    {
+        contact_constraint::point& cp1 = c.points [ 0 ];
+        contact_constraint::point& cp2 = c.points [ 1 ];
+
+        float a1 = cp1.normal_impulse;
+        float a2 = cp2.normal_impulse;
+
+        vec2 dv1 = point_velocity ( v, c.b, cp1.r_b ) - point_velocity ( v, c.a, cp1.r_a );
+        vec2 dv2 = point_velocity ( v, c.b, cp2.r_b ) - point_velocity ( v, c.a, cp2.r_a );
+
+        // b = vn - bias - K * a
+        float b1 = dv1.dot ( c.normal ) - cp1.bias - ( c.k11 * a1 + c.k12 * a2 );
+        float b2 = dv2.dot ( c.normal ) - cp2.bias - ( c.k12 * a1 + c.k22 * a2 );
+
+        float x1 = 0.0f;
+        float x2 = 0.0f;
+
+        for ( ;; ) {
+            // both points pushing
+            x1 = -( c.inv_k11 * b1 + c.inv_k12 * b2 );
+            x2 = -( c.inv_k12 * b1 + c.inv_k22 * b2 );
+
+            if ( x1 >= 0.0f && x2 >= 0.0f ) {
+                break;
+            }
+
+            // only the first
+            x1 = -cp1.normal_mass * b1;
+            x2 = 0.0f;
+
+            if ( x1 >= 0.0f && c.k12 * x1 + b2 >= 0.0f ) {
+                break;
+            }
+
+            // only the second
+            x1 = 0.0f;
+            x2 = -cp2.normal_mass * b2;
+
+            if ( x2 >= 0.0f && c.k12 * x2 + b1 >= 0.0f ) {
+                break;
+            }
+
+            // neither, both separating
+            x1 = 0.0f;
+            x2 = 0.0f;
+
+            if ( b1 >= 0.0f && b2 >= 0.0f ) {
+                break;
+            }
+
+            // no solution, keep the old impulses
+            return;
+        }
+
+        apply ( v, c.a, c.b, cp1.r_a, cp1.r_b, c.normal * ( x1 - a1 ) );
+        apply ( v, c.a, c.b, cp2.r_a, cp2.r_b, c.normal * ( x2 - a2 ) );
+
+        cp1.normal_impulse = x1;
+        cp2.normal_impulse = x2;
+    }
+
+}
+
+contact_solver::contact_solver ( ) :
+    m_candidates { nullptr },
+    m_parent { nullptr },
+    m_root_island { nullptr },
+    m_body_island { nullptr },
+    m_contact_island { nullptr },
+    m_joint_island { nullptr },
+    m_cursor { nullptr }
+{
+
+}
+
+void contact_solver::reserve ( unsigned int contacts )
+{
+    m_contacts.reserve ( contacts );
+    m_previous.reserve ( contacts );
+}
+
+void contact_solver::restore ( const contact_constraint* contacts, unsigned int count )
+{
+    m_contacts.assign ( contacts, contacts + count );
+    m_previous.clear ( );
+
+    // no islands until the next collide
+    m_island_start.assign ( 1, 0 );
+    m_island_body_start.assign ( 1, 0 );
+    m_island_joint_start.assign ( 1, 0 );
+    m_island_contacts.clear ( );
+    m_island_bodies.clear ( );
+    m_island_joints.clear ( );
+    m_island_awake.clear ( );
+    m_awake_islands.clear ( );
+}
+
+void contact_solver::collide ( quad_world& world,
+                               const std::vector<body_pair>& pairs )
+{
+    // joints know their bodies' dense indices and which pairs
+    // they keep from colliding before the narrow phase runs
+    world.joints ( ).update ( world );
+
+    find_contacts ( world, pairs );
+    build_islands ( world );
+}
+
+void contact_solver::solve ( quad_world& world, float dt )
+{
+    PROFILE_SCOPE ( "solve" );
+
+    if ( ( m_contacts.empty ( ) && world.joints ( ).empty ( ) ) || dt <= 0.0f ) {
+        return;
+    }
+
+    thread_pool& pool = world.pool ( );
+
+    unsigned int count = static_cast<unsigned int> ( m_awake_islands.size ( ) );
+
+    // islands differ a lot in size, hand them out a few at a time
+    unsigned int grain = std::max ( 1u, count / ( pool.size ( ) * 8 ) );
+
+    pool.parallel_for ( count, grain, [ this, &world, dt ] ( unsigned int first, unsigned int last ) {
+        PROFILE_SCOPE ( "solve_islands" );
+
+        for ( unsigned int n = first; n < last; ++n ) {
+            unsigned int island = m_awake_islands [ n ];
+
+            prepare ( world, island, dt );
+
+            if ( m_settings.warm_starting ) {
+                warm_start ( world, island );
+            }
+
+            for ( unsigned int i = 0; i < m_settings.velocity_iterations; ++i ) {
+                iterate ( world, island, dt );
+            }
+        }
+    } );
+}
+
+void contact_solver::remap ( const quad_world& world )
+{
+    for ( unsigned int i = 0; i < m_contacts.size ( ); ++i ) {
+        contact_constraint& c = m_contacts [ i ];
+
+        c.a = world.slot_index ( static_cast<unsigned int> ( c.key >> 32 ) );
+        c.b = world.slot_index ( static_cast<unsigned int> ( c.key & 0xffffffffu ) );
+    }
+}
+
+const contact_constraint* contact_solver::find_previous ( unsigned long long key ) const
+{
+    contact_constraint probe;
+    probe.key = key;
+
+    std::vector<contact_constraint>::const_iterator it =
+        std::lower_bound ( m_previous.begin ( ), m_previous.end ( ), probe, by_key );
+
+    if ( it == m_previous.end ( ) || it->key != key ) {
+        return nullptr;
+    }
+
+    return &*it;
+}
+
+void contact_solver::find_contacts ( quad_world& world,
+                                     const std::vector<body_pair>& pairs )
+{
+    PROFILE_SCOPE ( "narrow_phase" );
+
+    m_previous.swap ( m_contacts );
+    m_contacts.clear ( );
+
+    // narrow phase every pair in parallel, then gather the hits
+    unsigned int count = static_cast<unsigned int> ( pairs.size ( ) );
+
+    m_candidates = world.scratch ( ).allocate<contact_constraint> ( count );
+
+    world.pool ( ).parallel_for ( count, k_pair_grain, [ this, &world, &pairs ] ( unsigned int first, unsigned int last ) {
+        PROFILE_SCOPE ( "collide_pairs" );
+
+        for ( unsigned int i = first; i < last; ++i ) {
+            if ( !collide ( world, pairs [ i ], m_candidates [ i ] ) ) {
+                m_candidates [ i ].count = 0;
+            }
+        }
+    } );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        if ( m_candidates [ i ].count > 0 ) {
+            m_contacts.push_back ( m_candidates [ i ] );
+        }
+    }
+
+    std::sort ( m_contacts.begin ( ), m_contacts.end ( ), by_key );
+
+#ifdef RIGID_BODY_PROFILE
+    unsigned int points = 0;
+
+    for ( const contact_constraint& c : m_contacts ) {
+        points += c.count;
+    }
+
+    PROFILE_COUNT ( counter_pairs_tested, count );
+    PROFILE_COUNT ( counter_contacts, m_contacts.size ( ) );
+    PROFILE_COUNT ( counter_contact_points, points );
+#endif
+}
+
+bool contact_solver::collide ( const quad_world& world,
+                               body_pair pair,
+                               contact_constraint& c ) const
+{
+    const float* inv_mass = world.data ( quad_world::s_inv_mass );
+
+    unsigned int a = pair.a;
+    unsigned int b = pair.b;
+
+    // two static bodies never need a contact
+    if ( inv_mass [ a ] == 0.0f && inv_mass [ b ] == 0.0f ) {
+        return false;
+    }
+
+    // order by slot so the manifold and its feature ids come out
+    // the same way every step
+    unsigned int slot_a = world.handle_at ( a ).slot;
+    unsigned int slot_b = world.handle_at ( b ).slot;
+
+    if ( world.joints ( ).filtered ( slot_a, slot_b ) ) {
+        return false;
+    }
+
+    if ( slot_b < slot_a ) {
+        std::swap ( a, b );
+        std::swap ( slot_a, slot_b );
+    }
+
+    unsigned long long key = ( static_cast<unsigned long long> ( slot_a ) << 32 ) | slot_b;
+
+    const contact_constraint* previous = find_previous ( key );
+
+    // neither body moved since it fell asleep, the old contact still holds
+    if ( a >= world.awake_count ( ) && b >= world.awake_count ( ) ) {
+        if ( !previous ) {
+            return false;
+        }
+
+        c = *previous;
+        c.a = a;
+        c.b = b;
+
+        return true;
+    }
+
+    contact_manifold manifold;
+
+    PROFILE_COUNT ( counter_shape_tests, 1 );
+
+    if ( !world.collision ( a, b, manifold ) ) {
+        return false;
+    }
+
+    c.a = a;
+    c.b = b;
+    c.key = key;
+    c.normal = manifold.normal;
+    c.count = manifold.count;
+
+    for ( unsigned int p = 0; p < manifold.count; ++p ) {
+        contact_constraint::point& cp = c.points [ p ];
+
+        cp.id = manifold.points [ p ].id;
+        cp.separation = manifold.points [ p ].separation;
+        cp.normal_impulse = 0.0f;
+        cp.tangent_impulse = 0.0f;
+        cp.fresh = true;
+
+        // same features touching as last step, carry the impulses over
+        if ( previous ) {
+            for ( unsigned int q = 0; q < previous->count; ++q ) {
+                if ( previous->points [ q ].id == cp.id ) {
+                    cp.normal_impulse = previous->points [ q ].normal_impulse;
+                    cp.tangent_impulse = previous->points [ q ].tangent_impulse;
+                    cp.fresh = false;
+                    break;
+                }
+            }
+        }
+
+        const vec2& point = manifold.points [ p ].point;
+
+        cp.r_a.set ( point.x ( ) - world.data ( quad_world::s_center_x ) [ a ],
+                     point.y ( ) - world.data ( quad_world::s_center_y ) [ a ] );
+        cp.r_b.set ( point.x ( ) - world.data ( quad_world::s_center_x ) [ b ],
+                     point.y ( ) - world.data ( quad_world::s_center_y ) [ b ] );
+    }
+
+    return true;
+}
+
+unsigned int contact_solver::find_root ( unsigned int body )
+{
+    while ( m_parent [ body ] != body ) {
+        // path halving
+        m_parent [ body ] = m_parent [ m_parent [ body ] ];
+        body = m_parent [ body ];
+    }
+
+    return body;
+}
+
+void contact_solver::build_islands ( quad_world& world )
+{
+    PROFILE_SCOPE ( "build_islands" );
+
+    const float* inv_mass = world.data ( quad_world::s_inv_mass );
+    const joint_constraint* joints = world.joints ( ).data ( );
+
+    unsigned int bodies = world.size ( );
+    unsigned int count = static_cast<unsigned int> ( m_contacts.size ( ) );
+    unsigned int joint_count = world.joints ( ).size ( );
+
+    step_arena& scratch = world.scratch ( );
+
+    m_parent = scratch.allocate<unsigned int> ( bodies );
+
+    for ( unsigned int i = 0; i < bodies; ++i ) {
+        m_parent [ i ] = i;
+    }
+
+    // static bodies do not carry anything between the bodies on them
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const contact_constraint& c = m_contacts [ i ];
+
+        if ( inv_mass [ c.a ] > 0.0f && inv_mass [ c.b ] > 0.0f ) {
+            unite ( c.a, c.b );
+        }
+    }
+
+    for ( unsigned int i = 0; i < joint_count; ++i ) {
+        const joint_constraint& j = joints [ i ];
+
+        if ( inv_mass [ j.a ] > 0.0f && inv_mass [ j.b ] > 0.0f ) {
+            unite ( j.a, j.b );
+        }
+    }
+
+    // number the islands in contact then joint order so the grouping
+    // is stable
+    m_root_island = scratch.allocate<unsigned int> ( bodies );
+    m_body_island = scratch.allocate<unsigned int> ( bodies );
+    m_contact_island = scratch.allocate<unsigned int> ( count );
+    m_joint_island = scratch.allocate<unsigned int> ( joint_count );
+
+    std::fill ( m_root_island, m_root_island + bodies, k_no_island );
+    std::fill ( m_body_island, m_body_island + bodies, k_no_island );
+
+    m_island_start.assign ( 1, 0 );
+    m_island_body_start.assign ( 1, 0 );
+    m_island_joint_start.assign ( 1, 0 );
+    m_island_awake.clear ( );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const contact_constraint& c = m_contacts [ i ];
+
+        unsigned int island = find_island ( world, c.a, c.b );
+
+        m_contact_island [ i ] = island;
+        m_island_start [ island + 1 ]++;
+    }
+
+    for ( unsigned int i = 0; i < joint_count; ++i ) {
+        const joint_constraint& j = joints [ i ];
+
+        // nothing to solve between two static bodies
+        if ( inv_mass [ j.a ] == 0.0f && inv_mass [ j.b ] == 0.0f ) {
+            m_joint_island [ i ] = k_no_island;
+            continue;
+        }
+
+        unsigned int island = find_island ( world, j.a, j.b );
+
+        m_joint_island [ i ] = island;
+        m_island_joint_start [ island + 1 ]++;
+    }
+
+    for ( unsigned int i = 1; i < m_island_start.size ( ); ++i ) {
+        m_island_start [ i ] += m_island_start [ i - 1 ];
+        m_island_body_start [ i ] += m_island_body_start [ i - 1 ];
+        m_island_joint_start [ i ] += m_island_joint_start [ i - 1 ];
+    }
+
+    // counting sort of the contacts by island, keeping key order inside
+    m_island_contacts.resize ( count );
+    m_cursor = scratch.allocate<unsigned int> ( m_island_awake.size ( ) );
+
+    std::copy ( m_island_start.begin ( ), m_island_start.end ( ) - 1, m_cursor );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        m_island_contacts [ m_cursor [ m_contact_island [ i ] ]++ ] = i;
+    }
+
+    // and of the joints, in joint order
+    m_island_joints.resize ( m_island_joint_start.back ( ) );
+    std::copy ( m_island_joint_start.begin ( ), m_island_joint_start.end ( ) - 1, m_cursor );
+
+    for ( unsigned int i = 0; i < joint_count; ++i ) {
+        if ( m_joint_island [ i ] != k_no_island ) {
+            m_island_joints [ m_cursor [ m_joint_island [ i ] ]++ ] = i;
+        }
+    }
+
+    // and of the bodies, in dense order
+    m_island_bodies.resize ( m_island_body_start.back ( ) );
+    std::copy ( m_island_body_start.begin ( ), m_island_body_start.end ( ) - 1, m_cursor );
+
+    for ( unsigned int i = 0; i < bodies; ++i ) {
+        if ( m_body_island [ i ] != k_no_island ) {
+            m_island_bodies [ m_cursor [ m_body_island [ i ] ]++ ] = i;
+        }
+    }
+
+    m_awake_islands.clear ( );
+
+    for ( unsigned int i = 0; i < m_island_awake.size ( ); ++i ) {
+        if ( m_island_awake [ i ] ) {
+            m_awake_islands.push_back ( i );
+        }
+    }
+
+    PROFILE_COUNT ( counter_islands, m_island_awake.size ( ) );
+}
+
+void contact_solver::unite ( unsigned int a, unsigned int b )
+{
+    unsigned int root_a = find_root ( a );
+    unsigned int root_b = find_root ( b );
+
+    if ( root_a != root_b ) {
+        m_parent [ std::max ( root_a, root_b ) ] = std::min ( root_a, root_b );
+    }
+}
+
+unsigned int contact_solver::find_island ( const quad_world& world, unsigned int a, unsigned int b )
+{
+    const float* inv_mass = world.data ( quad_world::s_inv_mass );
+
+    unsigned int root = find_root ( inv_mass [ a ] > 0.0f ? a : b );
+    unsigned int island = m_root_island [ root ];
+
+    if ( island == k_no_island ) {
+        island = static_cast<unsigned int> ( m_island_awake.size ( ) );
+        m_root_island [ root ] = island;
+        m_island_start.push_back ( 0 );
+        m_island_body_start.push_back ( 0 );
+        m_island_joint_start.push_back ( 0 );
+        m_island_awake.push_back ( 0 );
+    }
+
+    unsigned int ends [ 2 ] = { a, b };
+
+    for ( unsigned int e = 0; e < 2; ++e ) {
+        unsigned int body = ends [ e ];
+
+        if ( inv_mass [ body ] > 0.0f && m_body_island [ body ] == k_no_island ) {
+            m_body_island [ body ] = island;
+            m_island_body_start [ island + 1 ]++;
+
+            if ( body < world.awake_count ( ) ) {
+                m_island_awake [ island ] = 1;
+            }
+        }
+    }
+
+    return island;
+}
+
+void contact_solver::prepare ( quad_world& world, unsigned int island, float dt )
+{
+    world.joints ( ).prepare ( gather_joints ( world ), island_joints ( island ), island_joint_count ( island ),
+                               dt, m_settings.baumgarte, m_settings.warm_starting );
+
+    body_velocities v = gather ( world );
+
+    float inv_dt = 1.0f / dt;
+
+    const unsigned int* contacts = island_contacts ( island );
+    unsigned int count = island_size ( island );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        contact_constraint& c = m_contacts [ contacts [ i ] ];
+
+        vec2 tangent { c.normal.y ( ), -c.normal.x ( ) };
+
+        float im_a = v.inv_mass [ c.a ];
+        float im_b = v.inv_mass [ c.b ];
+        float ii_a = v.inv_inertia [ c.a ];
+        float ii_b = v.inv_inertia [ c.b ];
+
+        for ( unsigned int p = 0; p < c.count; ++p ) {
+            contact_constraint::point& cp = c.points [ p ];
+
+            float rn_a = cross ( cp.r_a, c.normal );
+            float rn_b = cross ( cp.r_b, c.normal );
+            float k_normal = im_a + im_b + ii_a * rn_a * rn_a + ii_b * rn_b * rn_b;
+
+            float rt_a = cross ( cp.r_a, tangent );
+            float rt_b = cross ( cp.r_b, tangent );
+            float k_tangent = im_a + im_b + ii_a * rt_a * rt_a + ii_b * rt_b * rt_b;
+
+            cp.normal_mass = k_normal > 0.0f ? 1.0f / k_normal : 0.0f;
+            cp.tangent_mass = k_tangent > 0.0f ? 1.0f / k_tangent : 0.0f;
+
+            if ( p == 0 ) {
+                c.k11 = k_normal;
+            } else {
+                c.k22 = k_normal;
+            }
+
+            // push out the penetration past the slop
+            cp.bias = -m_settings.baumgarte * inv_dt * std::min ( 0.0f, cp.separation + m_settings.slop );
+
+            // bounce when a contact starts approaching fast enough. the
+            // velocity is rebuilt from the force every step, so a resting
+            // contact would otherwise bounce over and over
+            vec2 dv = point_velocity ( v, c.b, cp.r_b ) - point_velocity ( v, c.a, cp.r_a );
+            float vn = dv.dot ( c.normal );
+
+            if ( cp.fresh && vn < -m_settings.restitution_threshold ) {
+                cp.bias += -m_settings.restitution * vn;
+            }
+        }
+
+        // the block solver needs an invertible, well conditioned K
+        c.block = false;
+
+        if ( c.count == 2 ) {
+            const contact_constraint::point& cp1 = c.points [ 0 ];
+            const contact_constraint::point& cp2 = c.points [ 1 ];
+
+            c.k12 = im_a + im_b +
+                    ii_a * cross ( cp1.r_a, c.normal ) * cross ( cp2.r_a, c.normal ) +
+                    ii_b * cross ( cp1.r_b, c.normal ) * cross ( cp2.r_b, c.normal );
+
+            float det = c.k11 * c.k22 - c.k12 * c.k12;
+
+            if ( c.k11 * c.k11 < k_max_condition * det ) {
+                float inv_det = 1.0f / det;
+
+                c.inv_k11 = c.k22 * inv_det;
+                c.inv_k22 = c.k11 * inv_det;
+                c.inv_k12 = -c.k12 * inv_det;
+                c.block = true;
+            }
+        }
+    }
+}
+
+void contact_solver::warm_start ( quad_world& world, unsigned int island )
+{
+    world.joints ( ).warm_start ( gather_joints ( world ), island_joints ( island ), island_joint_count ( island ) );
+
+    body_velocities v = gather ( world );
+
+    const unsigned int* contacts = island_contacts ( island );
+    unsigned int count = island_size ( island );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const contact_constraint& c = m_contacts [ contacts [ i ] ];
+
+        vec2 tangent { c.normal.y ( ), -c.normal.x ( ) };
+
+        for ( unsigned int p = 0; p < c.count; ++p ) {
+            const contact_constraint::point& cp = c.points [ p ];
+
+            vec2 impulse = c.normal * cp.normal_impulse + tangent * cp.tangent_impulse;
+
+            apply ( v, c.a, c.b, cp.r_a, cp.r_b, impulse );
+        }
+    }
+}
+
+void contact_solver::iterate ( quad_world& world, unsigned int island, float dt )
+{
+    // joints first, the contacts get the last word on penetration
+    world.joints ( ).iterate ( gather_joints ( world ), island_joints ( island ), island_joint_count ( island ), dt );
+
+    body_velocities v = gather ( world );
+
+    const unsigned int* contacts = island_contacts ( island );
+    unsigned int count = island_size ( island );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        contact_constraint& c = m_contacts [ contacts [ i ] ];
+
+        vec2 tangent { c.normal.y ( ), -c.normal.x ( ) };
+
+        // friction first, bounded by the current normal impulse
+        for ( unsigned int p = 0; p < c.count; ++p ) {
+            contact_constraint::point& cp = c.points [ p ];
+
+            vec2 dv = point_velocity ( v, c.b, cp.r_b ) - point_velocity ( v, c.a, cp.r_a );
+
+            float max_friction = m_settings.friction * cp.normal_impulse;
+            float lambda = -cp.tangent_mass * dv.dot ( tangent );
+            float total = std::max ( -max_friction, std::min ( cp.tangent_impulse + lambda, max_friction ) );
+
+            lambda = total - cp.tangent_impulse;
+            cp.tangent_impulse = total;
+
+            apply ( v, c.a, c.b, cp.r_a, cp.r_b, tangent * lambda );
+        }
+
+        // then the non penetration constraint, clamped as a total
+        if ( c.block ) {
+            solve_block ( v, c );
+            continue;
+        }
+
+        for ( unsigned int p = 0; p < c.count; ++p ) {
+            contact_constraint::point& cp = c.points [ p ];
+
+            vec2 dv = point_velocity ( v, c.b, cp.r_b ) - point_velocity ( v, c.a, cp.r_a );
+
+            float lambda = cp.normal_mass * ( -dv.dot ( c.normal ) + cp.bias );
+            float total = std::max ( cp.normal_impulse + lambda, 0.0f );
+
+            lambda = total - cp.normal_impulse;
+            cp.normal_impulse = total;
+
+            apply ( v, c.a, c.b, cp.r_a, cp.r_b, c.normal * lambda );
+        }
+    }
+}
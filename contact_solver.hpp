@@ -0,0 +1,186 @@
+#ifndef CONTACT_SOLVER
+#define CONTACT_SOLVER
+
+#include <vector>
+
+#include "aabb.hpp"
+#include "box_collision.hpp"
+#include "joint.hpp"
+
+class quad_world;
+
+struct solver_settings {
+    // more iterations converge stacks further at the cost of frame time
+    unsigned int velocity_iterations;
+
+    bool warm_starting;
+
+    float friction;
+    float restitution;
+
+    // approach speed below which contacts do not bounce
+    float restitution_threshold;
+
+    // fraction of the penetration past the slop pushed out per step
+    float baumgarte;
+    float slop;
+
+    solver_settings ( ) :
+        velocity_iterations { 8 },
+        warm_starting { true },
+        friction { 0.4f },
+        restitution { 0.1f },
+        restitution_threshold { 0.5f },
+        baumgarte { 0.2f },
+        slop { 0.005f }
+    {}
+};
+
+struct contact_constraint {
+    struct point {
+        // anchors relative to each body's center
+        vec2 r_a;
+        vec2 r_b;
+
+        float separation;
+
+        // accumulated over the iterations and kept for warm starting
+        float normal_impulse;
+        float tangent_impulse;
+
+        float normal_mass;
+        float tangent_mass;
+        float bias;
+
+        unsigned int id;
+
+        // no matching point last step
+        bool fresh;
+    };
+
+    // dense indices, a is the body with the lower slot
+    unsigned int a;
+    unsigned int b;
+
+    // slots of a and b, stable between steps
+    unsigned long long key;
+
+    vec2 normal;
+
+    unsigned int count;
+    point points [ 2 ];
+
+    // mass matrix of the two normal constraints and its inverse, used
+    // to solve both points together when block is set
+    bool block;
+    float k11, k12, k22;
+    float inv_k11, inv_k12, inv_k22;
+};
+
+// sequential impulse solver over the contact manifolds of the candidate
+// pairs. impulses are clamped as accumulated totals, friction is limited
+// by the normal impulse, and the totals are matched to last step's
+// contacts by body slots and feature id to warm start the next solve.
+// the two normal impulses of a manifold are solved together as a block.
+// the world's joints are solved in the same passes, ahead of the
+// contacts, and the bodies they join share an island with them.
+// contacts are split into islands of bodies touching through dynamic
+// bodies, islands share no moving body so they are solved in parallel.
+// islands whose bodies are all asleep are skipped and keep their
+// contacts from the step they fell asleep.
+class contact_solver {
+public:
+    contact_solver ( );
+
+    // run the narrow phase on pairs and group the contacts into islands
+    void collide ( quad_world& world,
+                   const std::vector<body_pair>& pairs );
+
+    // solve the awake islands from the last collide, writing the
+    // corrected velocities back into the world
+    void solve ( quad_world& world, float dt );
+
+    const std::vector<contact_constraint>& contacts ( ) const { return m_contacts; }
+
+    // room for this many contacts before the contact buffers grow
+    void reserve ( unsigned int contacts );
+
+    // start over from saved contacts, they warm start the next solve
+    void restore ( const contact_constraint* contacts, unsigned int count );
+
+    // islands from the last solve, each a run of indices into contacts,
+    // a run of indices into the world's joints and a run of the
+    // dynamic bodies in it
+    unsigned int island_count ( ) const { return static_cast<unsigned int> ( m_island_start.size ( ) ) - 1; }
+    const unsigned int* island_contacts ( unsigned int island ) const { return m_island_contacts.data ( ) + m_island_start [ island ]; }
+    unsigned int island_size ( unsigned int island ) const { return m_island_start [ island + 1 ] - m_island_start [ island ]; }
+    const unsigned int* island_joints ( unsigned int island ) const { return m_island_joints.data ( ) + m_island_joint_start [ island ]; }
+    unsigned int island_joint_count ( unsigned int island ) const { return m_island_joint_start [ island + 1 ] - m_island_joint_start [ island ]; }
+    const unsigned int* island_bodies ( unsigned int island ) const { return m_island_bodies.data ( ) + m_island_body_start [ island ]; }
+    unsigned int island_body_count ( unsigned int island ) const { return m_island_body_start [ island + 1 ] - m_island_body_start [ island ]; }
+
+    // an island was solved if any of its bodies was awake
+    bool island_awake ( unsigned int island ) const { return m_island_awake [ island ] != 0; }
+
+    // bodies changed dense index since the solve, look a and b up
+    // again from the slots in the keys. island bodies are not remapped
+    void remap ( const quad_world& world );
+
+    solver_settings& settings ( ) { return m_settings; }
+    const solver_settings& settings ( ) const { return m_settings; }
+
+private:
+
+    void find_contacts ( quad_world& world,
+                         const std::vector<body_pair>& pairs );
+    bool collide ( const quad_world& world,
+                   body_pair pair,
+                   contact_constraint& c ) const;
+    void build_islands ( quad_world& world );
+
+    // the passes run over the joints and contacts of a single island
+    void prepare ( quad_world& world, unsigned int island, float dt );
+    void warm_start ( quad_world& world, unsigned int island );
+    void iterate ( quad_world& world, unsigned int island, float dt );
+
+    const contact_constraint* find_previous ( unsigned long long key ) const;
+    unsigned int find_root ( unsigned int body );
+    void unite ( unsigned int a, unsigned int b );
+
+    // island of the dynamic end of a constraint, made if it has none,
+    // with the dynamic ends added to its bodies
+    unsigned int find_island ( const quad_world& world, unsigned int a, unsigned int b );
+
+    solver_settings m_settings;
+
+    // sorted by key
+    std::vector<contact_constraint> m_contacts;
+    std::vector<contact_constraint> m_previous;
+
+    // per step scratch from the world's arena, valid until the next step
+
+    // one per candidate pair, count is 0 for pairs not touching
+    contact_constraint* m_candidates;
+
+    // union find over dense body indices
+    unsigned int* m_parent;
+    unsigned int* m_root_island;
+    unsigned int* m_body_island;
+    unsigned int* m_contact_island;
+    unsigned int* m_joint_island;
+    unsigned int* m_cursor;
+
+    // contacts, joints and bodies grouped by island, the starts have
+    // a trailing end
+    std::vector<unsigned int> m_island_start;
+    std::vector<unsigned int> m_island_contacts;
+    std::vector<unsigned int> m_island_joint_start;
+    std::vector<unsigned int> m_island_joints;
+    std::vector<unsigned int> m_island_body_start;
+    std::vector<unsigned int> m_island_bodies;
+
+    std::vector<unsigned char> m_island_awake;
+    std::vector<unsigned int> m_awake_islands;
+};
+
+#endif
@@ -0,0 +1,278 @@
+#include "dynamic_aabb_tree.hpp"
+
+#include <algorithm>
+
+dynamic_aabb_tree::dynamic_aabb_tree ( float margin ) :
+    m_root { k_null_node },
+    m_free_list { k_null_node },
+    m_margin { margin }
+{
+
+}
+
+int dynamic_aabb_tree::allocate_node ( )
+{
+    if ( m_free_list == k_null_node ) {
+        m_nodes.push_back ( node { } );
+        m_free_list = static_cast<int> ( m_nodes.size ( ) ) - 1;
+        m_nodes [ m_free_list ].parent = k_null_node;
+    }
+
+    int n = m_free_list;
+    m_free_list = m_nodes [ n ].parent;
+
+    m_nodes [ n ].parent = k_null_node;
+    m_nodes [ n ].child1 = k_null_node;
+    m_nodes [ n ].child2 = k_null_node;
+    m_nodes [ n ].height = 0;
+    m_nodes [ n ].user_data = 0;
+
+    return n;
+}
+
+void dynamic_aabb_tree::free_node ( int n )
+{
+    m_nodes [ n ].parent = m_free_list;
+    m_nodes [ n ].height = -1;
+    m_free_list = n;
+}
+
+int dynamic_aabb_tree::insert ( const aabb& bounds, unsigned int user_data )
+{
+    int proxy = allocate_node ( );
+
+    m_nodes [ proxy ].bounds.min = bounds.min - vec2 { m_margin, m_margin };
+    m_nodes [ proxy ].bounds.max = bounds.max + vec2 { m_margin, m_margin };
+    m_nodes [ proxy ].user_data = user_data;
+
+    insert_leaf ( proxy );
+
+    return proxy;
+}
+
+void dynamic_aabb_tree::remove ( int proxy )
+{
+    remove_leaf ( proxy );
+    free_node ( proxy );
+}
+
+bool dynamic_aabb_tree::move ( int proxy, const aabb& bounds )
+{
+    if ( m_nodes [ proxy ].bounds.contains ( bounds ) ) {
+        return false;
+    }
+
+    remove_leaf ( proxy );
+
+    m_nodes [ proxy ].bounds.min = bounds.min - vec2 { m_margin, m_margin };
+    m_nodes [ proxy ].bounds.max = bounds.max + vec2 { m_margin, m_margin };
+
+    insert_leaf ( proxy );
+
+    return true;
+}
+
+void dynamic_aabb_tree::clear ( )
+{
+    m_nodes.clear ( );
+    m_root = k_null_node;
+    m_free_list = k_null_node;
+}
+
+int dynamic_aabb_tree::height ( ) const
+{
+    return m_root == k_null_node ? 0 : m_nodes [ m_root ].height;
+}
+
+void dynamic_aabb_tree::insert_leaf ( int leaf )
+{
+    if ( m_root == k_null_node ) {
+        m_root = leaf;
+        m_nodes [ m_root ].parent = k_null_node;
+        return;
+    }
+
+    // walk down picking the cheapest sibling by the perimeter heuristic
+    aabb leaf_bounds = m_nodes [ leaf ].bounds;
+    int index = m_root;
+
+    while ( !m_nodes [ index ].leaf ( ) ) {
+        int child1 = m_nodes [ index ].child1;
+        int child2 = m_nodes [ index ].child2;
+
+        float area = m_nodes [ index ].bounds.perimeter ( );
+        float combined_area = aabb_util::combine ( m_nodes [ index ].bounds, leaf_bounds ).perimeter ( );
+
+        // cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined_area;
+
+        // minimum cost of pushing the leaf further down
+        float inheritance_cost = 2.0f * ( combined_area - area );
+
+        float cost1 = aabb_util::combine ( leaf_bounds, m_nodes [ child1 ].bounds ).perimeter ( ) + inheritance_cost;
+        float cost2 = aabb_util::combine ( leaf_bounds, m_nodes [ child2 ].bounds ).perimeter ( ) + inheritance_cost;
+
+        if ( !m_nodes [ child1 ].leaf ( ) ) {
+            cost1 -= m_nodes [ child1 ].bounds.perimeter ( );
+        }
+
+        if ( !m_nodes [ child2 ].leaf ( ) ) {
+            cost2 -= m_nodes [ child2 ].bounds.perimeter ( );
+        }
+
+        if ( cost < cost1 && cost < cost2 ) {
+            break;
+        }
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+
+    // new parent for the sibling and the leaf
+    int old_parent = m_nodes [ sibling ].parent;
+    int new_parent = allocate_node ( );
+
+    m_nodes [ new_parent ].parent = old_parent;
+    m_nodes [ new_parent ].bounds = aabb_util::combine ( leaf_bounds, m_nodes [ sibling ].bounds );
+    m_nodes [ new_parent ].height = m_nodes [ sibling ].height + 1;
+    m_nodes [ new_parent ].child1 = sibling;
+    m_nodes [ new_parent ].child2 = leaf;
+
+    m_nodes [ sibling ].parent = new_parent;
+    m_nodes [ leaf ].parent = new_parent;
+
+    if ( old_parent != k_null_node ) {
+        if ( m_nodes [ old_parent ].child1 == sibling ) {
+            m_nodes [ old_parent ].child1 = new_parent;
+        } else {
+            m_nodes [ old_parent ].child2 = new_parent;
+        }
+    } else {
+        m_root = new_parent;
+    }
+
+    // fix up heights and bounds on the way back up
+    index = m_nodes [ leaf ].parent;
+
+    while ( index != k_null_node ) {
+        index = balance ( index );
+
+        int child1 = m_nodes [ index ].child1;
+        int child2 = m_nodes [ index ].child2;
+
+        m_nodes [ index ].height = 1 + std::max ( m_nodes [ child1 ].height, m_nodes [ child2 ].height );
+        m_nodes [ index ].bounds = aabb_util::combine ( m_nodes [ child1 ].bounds, m_nodes [ child2 ].bounds );
+
+        index = m_nodes [ index ].parent;
+    }
+}
+
+void dynamic_aabb_tree::remove_leaf ( int leaf )
+{
+    if ( leaf == m_root ) {
+        m_root = k_null_node;
+        return;
+    }
+
+    int parent = m_nodes [ leaf ].parent;
+    int grand_parent = m_nodes [ parent ].parent;
+    int sibling = m_nodes [ parent ].child1 == leaf ? m_nodes [ parent ].child2 : m_nodes [ parent ].child1;
+
+    if ( grand_parent == k_null_node ) {
+        m_root = sibling;
+        m_nodes [ sibling ].parent = k_null_node;
+        free_node ( parent );
+        return;
+    }
+
+    // the sibling takes the place of the parent
+    if ( m_nodes [ grand_parent ].child1 == parent ) {
+        m_nodes [ grand_parent ].child1 = sibling;
+    } else {
+        m_nodes [ grand_parent ].child2 = sibling;
+    }
+
+    m_nodes [ sibling ].parent = grand_parent;
+    free_node ( parent );
+
+    int index = grand_parent;
+
+    while ( index != k_null_node ) {
+        index = balance ( index );
+
+        int child1 = m_nodes [ index ].child1;
+        int child2 = m_nodes [ index ].child2;
+
+        m_nodes [ index ].bounds = aabb_util::combine ( m_nodes [ child1 ].bounds, m_nodes [ child2 ].bounds );
+        m_nodes [ index ].height = 1 + std::max ( m_nodes [ child1 ].height, m_nodes [ child2 ].height );
+
+        index = m_nodes [ index ].parent;
+    }
+}
+
+// rotate a up if one of its subtrees is more than one level taller,
+// returns the index of the node now in a's place
+int dynamic_aabb_tree::balance ( int a )
+{
+    node& na = m_nodes [ a ];
+
+    if ( na.leaf ( ) || na.height < 2 ) {
+        return a;
+    }
+
+    int b = na.child1;
+    int c = na.child2;
+
+    int diff = m_nodes [ c ].height - m_nodes [ b ].height;
+
+    // rotate c up, or b up, the two cases mirror each other
+    if ( diff > 1 || diff < -1 ) {
+        int up = diff > 1 ? c : b;
+        int other = diff > 1 ? b : c;
+
+        int f = m_nodes [ up ].child1;
+        int g = m_nodes [ up ].child2;
+
+        // swap a and up
+        m_nodes [ up ].child1 = a;
+        m_nodes [ up ].parent = na.parent;
+        na.parent = up;
+
+        if ( m_nodes [ up ].parent != k_null_node ) {
+            node& p = m_nodes [ m_nodes [ up ].parent ];
+
+            if ( p.child1 == a ) {
+                p.child1 = up;
+            } else {
+                p.child2 = up;
+            }
+        } else {
+            m_root = up;
+        }
+
+        // the taller grandchild stays under up, the shorter goes to a
+        int keep = m_nodes [ f ].height > m_nodes [ g ].height ? f : g;
+        int give = keep == f ? g : f;
+
+        m_nodes [ up ].child2 = keep;
+
+        if ( diff > 1 ) {
+            na.child2 = give;
+        } else {
+            na.child1 = give;
+        }
+
+        m_nodes [ give ].parent = a;
+
+        na.bounds = aabb_util::combine ( m_nodes [ other ].bounds, m_nodes [ give ].bounds );
+        m_nodes [ up ].bounds = aabb_util::combine ( na.bounds, m_nodes [ keep ].bounds );
+
+        na.height = 1 + std::max ( m_nodes [ other ].height, m_nodes [ give ].height );
+        m_nodes [ up ].height = 1 + std::max ( na.height, m_nodes [ keep ].height );
+
+        return up;
+    }
+
+    return a;
+}
@@ -0,0 +1,206 @@
+#ifndef DYNAMIC_AABB_TREE
+#define DYNAMIC_AABB_TREE
+
+#include <vector>
+
+#include "aabb.hpp"
+
+// bounding volume hierarchy over fat aabbs. every leaf stores the bounds
+// it was given grown by a margin, so a leaf only has to be reinserted
+// once its tight bounds leave the fat ones. the tree is kept balanced
+// with rotations on the way back up from an insert or remove.
+class dynamic_aabb_tree {
+public:
+    static const int k_null_node = -1;
+
+    explicit dynamic_aabb_tree ( float margin = 0.02f );
+
+    int insert ( const aabb& bounds, unsigned int user_data );
+    void remove ( int proxy );
+
+    // returns true if the proxy had to be reinserted
+    bool move ( int proxy, const aabb& bounds );
+
+    void clear ( );
+
+    const aabb& fat_bounds ( int proxy ) const { return m_nodes [ proxy ].bounds; }
+    unsigned int user_data ( int proxy ) const { return m_nodes [ proxy ].user_data; }
+    void set_user_data ( int proxy, unsigned int user_data ) { m_nodes [ proxy ].user_data = user_data; }
+
+    int height ( ) const;
+    float margin ( ) const { return m_margin; }
+
+    // callback ( int proxy ) for every leaf overlapping bounds,
+    // return false to stop the query
+    template < typename F >
+    void query ( const aabb& bounds, F callback ) const;
+
+    // callback ( int proxy, float max_fraction ) for every leaf the
+    // segment from -> to passes through. it returns the fraction to clip
+    // the segment to, 0 stops the cast, max_fraction carries on unclipped
+    template < typename F >
+    void ray_cast ( const vec2& from, const vec2& to, F callback ) const;
+
+private:
+
+    struct node {
+        aabb bounds;
+
+        // parent while in the tree, next free node while on the free list
+        int parent;
+        int child1;
+        int child2;
+
+        // leaves are height 0, free nodes -1
+        int height;
+
+        unsigned int user_data;
+
+        bool leaf ( ) const { return child1 == k_null_node; }
+    };
+
+    // deep enough for any balanced tree that fits in memory
+    static const int k_stack_size = 256;
+
+    int allocate_node ( );
+    void free_node ( int n );
+
+    void insert_leaf ( int leaf );
+    void remove_leaf ( int leaf );
+
+    int balance ( int a );
+
+    std::vector<node> m_nodes;
+
+    int m_root;
+    int m_free_list;
+
+    float m_margin;
+};
+
+namespace aabb_util {
+
+    inline aabb combine ( const aabb& a, const aabb& b )
+    {
+        aabb c;
+        c.min.set ( a.min.x ( ) < b.min.x ( ) ? a.min.x ( ) : b.min.x ( ),
+                    a.min.y ( ) < b.min.y ( ) ? a.min.y ( ) : b.min.y ( ) );
+        c.max.set ( a.max.x ( ) > b.max.x ( ) ? a.max.x ( ) : b.max.x ( ),
+                    a.max.y ( ) > b.max.y ( ) ? a.max.y ( ) : b.max.y ( ) );
+        return c;
+    }
+
+    // slab test, clips [ 0, max_fraction ] to where the segment is inside
+    inline bool segment_overlaps ( const aabb& box,
+                                   const vec2& from,
+                                   const vec2& delta,
+                                   float max_fraction )
+    {
+        float t_min = 0.0f;
+        float t_max = max_fraction;
+
+        float origin [ 2 ] = { from.x ( ), from.y ( ) };
+        float dir [ 2 ] = { delta.x ( ), delta.y ( ) };
+        float lo [ 2 ] = { box.min.x ( ), box.min.y ( ) };
+        float hi [ 2 ] = { box.max.x ( ), box.max.y ( ) };
+
+        for ( unsigned int axis = 0; axis < 2; ++axis ) {
+            if ( dir [ axis ] == 0.0f ) {
+                if ( origin [ axis ] < lo [ axis ] || origin [ axis ] > hi [ axis ] ) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            float inv = 1.0f / dir [ axis ];
+            float t1 = ( lo [ axis ] - origin [ axis ] ) * inv;
+            float t2 = ( hi [ axis ] - origin [ axis ] ) * inv;
+
+            if ( t1 > t2 ) {
+                float tmp = t1;
+                t1 = t2;
+                t2 = tmp;
+            }
+
+            t_min = t1 > t_min ? t1 : t_min;
+            t_max = t2 < t_max ? t2 : t_max;
+
+            if ( t_min > t_max ) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+}
+
+template < typename F >
+void dynamic_aabb_tree::query ( const aabb& bounds, F callback ) const
+{
+    int stack [ k_stack_size ];
+    int top = 0;
+
+    if ( m_root != k_null_node ) {
+        stack [ top++ ] = m_root;
+    }
+
+    while ( top > 0 ) {
+        int n = stack [ --top ];
+        const node& current = m_nodes [ n ];
+
+        if ( !current.bounds.overlaps ( bounds ) ) {
+            continue;
+        }
+
+        if ( current.leaf ( ) ) {
+            if ( !callback ( n ) ) {
+                return;
+            }
+        } else {
+            stack [ top++ ] = current.child1;
+            stack [ top++ ] = current.child2;
+        }
+    }
+}
+
+template < typename F >
+void dynamic_aabb_tree::ray_cast ( const vec2& from, const vec2& to, F callback ) const
+{
+    vec2 delta = to - from;
+    float max_fraction = 1.0f;
+
+    int stack [ k_stack_size ];
+    int top = 0;
+
+    if ( m_root != k_null_node ) {
+        stack [ top++ ] = m_root;
+    }
+
+    while ( top > 0 ) {
+        int n = stack [ --top ];
+        const node& current = m_nodes [ n ];
+
+        if ( !aabb_util::segment_overlaps ( current.bounds, from, delta, max_fraction ) ) {
+            continue;
+        }
+
+        if ( current.leaf ( ) ) {
+            float fraction = callback ( n, max_fraction );
+
+            if ( fraction == 0.0f ) {
+                return;
+            }
+
+            if ( fraction < max_fraction ) {
+                max_fraction = fraction;
+            }
+        } else {
+            stack [ top++ ] = current.child1;
+            stack [ top++ ] = current.child2;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef FAST_MATH
+#define FAST_MATH
+
+// polynomial sin / cos shared by the scalar and simd integrator paths.
+// the evaluation order matches the vector kernels op for op so every
+// path produces the same bits for the same input. good to ~1e-7 for
+// the angle range the simulation sees, the quadrant reduction breaks
+// down past |x| ~ 1e9.
+//
+// only +, -, * and comparisons are used, so unlike libm the results
+// are the same on every platform as long as the compiler does not
+// fuse or reorder them, which is what the deterministic build checks.
+
+#include <cfloat>
+
+#ifdef RIGID_BODY_DETERMINISTIC
+#ifdef __FAST_MATH__
+#error "a deterministic build cannot use -ffast-math"
+#endif
+#if FLT_EVAL_METHOD != 0
+#error "a deterministic build needs floats evaluated as floats, use sse math"
+#endif
+#endif
+
+namespace fast_math {
+
+    const float k_four_over_pi = 1.27323954473516f;
+
+    // pi / 4 split in three parts for an exact-ish range reduction
+    const float k_dp1 = 0.78515625f;
+    const float k_dp2 = 2.4187564849853515625e-4f;
+    const float k_dp3 = 3.77489497744594108e-8f;
+
+    const float k_cos_p0 = 2.443315711809948e-5f;
+    const float k_cos_p1 = -1.388731625493765e-3f;
+    const float k_cos_p2 = 4.166664568298827e-2f;
+
+    const float k_sin_p0 = -1.9515295891e-4f;
+    const float k_sin_p1 = 8.3321608736e-3f;
+    const float k_sin_p2 = -1.6666654611e-1f;
+
+    inline void sincos ( float x, float& s, float& c )
+    {
+        bool negative = x < 0.0f;
+        float ax = negative ? -x : x;
+
+        // find the octant, rounded up to an even number
+        int j = static_cast<int> ( ax * k_four_over_pi );
+        j = ( j + 1 ) & ~1;
+        float y = static_cast<float> ( j );
+
+        // the quadrant picks which polynomial gives sin and their signs
+        bool swap = ( j & 2 ) != 0;
+        bool sin_flip = ( ( j & 4 ) != 0 ) != negative;
+        bool cos_flip = ( ( ~( j - 2 ) ) & 4 ) != 0;
+
+        ax = ( ( ax - y * k_dp1 ) - y * k_dp2 ) - y * k_dp3;
+
+        float z = ax * ax;
+
+        float pc = k_cos_p0;
+        pc = pc * z + k_cos_p1;
+        pc = pc * z + k_cos_p2;
+        pc = pc * z;
+        pc = pc * z;
+        pc = pc - z * 0.5f;
+        pc = pc + 1.0f;
+
+        float ps = k_sin_p0;
+        ps = ps * z + k_sin_p1;
+        ps = ps * z + k_sin_p2;
+        ps = ps * z;
+        ps = ps * ax;
+        ps = ps + ax;
+
+        s = swap ? pc : ps;
+        c = swap ? ps : pc;
+
+        if ( sin_flip ) {
+            s = -s;
+        }
+
+        if ( cos_flip ) {
+            c = -c;
+        }
+    }
+
+}
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef FIXED_POINT
+#define FIXED_POINT
+
+#include <cstdint>
+#include <limits>
+
+// signed fixed point number with fraction_bits of its 32 bits after the
+// binary point, q16.16 by default. every operation is integer only, so
+// results are the same on every platform and compiler, and cheap on
+// cores without a fast float unit. sums wrap on overflow, products
+// and quotients are widened to 64 bits and truncated back. dividing
+// by zero saturates instead of trapping.
+//
+// converting from float and back is explicit so mixing the two in
+// generic code never happens by accident, write T ( 0.5f ).
+template < int fraction_bits >
+class fixed_point {
+public:
+    static_assert ( fraction_bits > 0 && fraction_bits < 31, "fraction bits must leave room for the sign" );
+
+    static const int k_fraction_bits = fraction_bits;
+    static const std::int32_t k_one = std::int32_t { 1 } << fraction_bits;
+
+    fixed_point ( ) : m_raw { 0 } {}
+
+    explicit fixed_point ( int v ) : m_raw { static_cast<std::int32_t> ( static_cast<std::uint32_t> ( v ) << fraction_bits ) } {}
+    explicit fixed_point ( float v ) : m_raw { round ( static_cast<double> ( v ) ) } {}
+    explicit fixed_point ( double v ) : m_raw { round ( v ) } {}
+
+    static fixed_point from_raw ( std::int32_t raw )
+    {
+        fixed_point f;
+        f.m_raw = raw;
+
+        return f;
+    }
+
+    std::int32_t raw ( ) const { return m_raw; }
+
+    explicit operator float ( ) const { return static_cast<float> ( m_raw ) / k_one; }
+    explicit operator double ( ) const { return static_cast<double> ( m_raw ) / k_one; }
+
+    // operators
+    fixed_point operator- ( ) const { return from_raw ( wrap ( 0u - static_cast<std::uint32_t> ( m_raw ) ) ); }
+
+    fixed_point operator+ ( fixed_point v ) const { return from_raw ( wrap ( static_cast<std::uint32_t> ( m_raw ) + static_cast<std::uint32_t> ( v.m_raw ) ) ); }
+    fixed_point operator- ( fixed_point v ) const { return from_raw ( wrap ( static_cast<std::uint32_t> ( m_raw ) - static_cast<std::uint32_t> ( v.m_raw ) ) ); }
+
+    fixed_point operator* ( fixed_point v ) const
+    {
+        return from_raw ( static_cast<std::int32_t> ( ( static_cast<std::int64_t> ( m_raw ) * v.m_raw ) >> fraction_bits ) );
+    }
+
+    fixed_point operator/ ( fixed_point v ) const
+    {
+        if ( v.m_raw == 0 ) {
+            return m_raw < 0 ? std::numeric_limits<fixed_point>::lowest ( ) : std::numeric_limits<fixed_point>::max ( );
+        }
+
+        return from_raw ( static_cast<std::int32_t> ( static_cast<std::int64_t> ( m_raw ) * k_one / v.m_raw ) );
+    }
+
+    fixed_point& operator+= ( fixed_point v ) { return *this = *this + v; }
+    fixed_point& operator-= ( fixed_point v ) { return *this = *this - v; }
+    fixed_point& operator*= ( fixed_point v ) { return *this = *this * v; }
+    fixed_point& operator/= ( fixed_point v ) { return *this = *this / v; }
+
+    bool operator== ( fixed_point v ) const { return m_raw == v.m_raw; }
+    bool operator!= ( fixed_point v ) const { return m_raw != v.m_raw; }
+    bool operator< ( fixed_point v ) const { return m_raw < v.m_raw; }
+    bool operator<= ( fixed_point v ) const { return m_raw <= v.m_raw; }
+    bool operator> ( fixed_point v ) const { return m_raw > v.m_raw; }
+    bool operator>= ( fixed_point v ) const { return m_raw >= v.m_raw; }
+
+private:
+
+    // nearest, ties away from zero, out of range values saturate
+    static std::int32_t round ( double v )
+    {
+        double scaled = v * k_one;
+
+        if ( !( scaled < 2147483647.0 ) ) {
+            return std::numeric_limits<std::int32_t>::max ( );
+        }
+
+        if ( !( scaled > -2147483648.0 ) ) {
+            return std::numeric_limits<std::int32_t>::min ( );
+        }
+
+        return static_cast<std::int32_t> ( scaled < 0.0 ? scaled - 0.5 : scaled + 0.5 );
+    }
+
+    static std::int32_t wrap ( std::uint32_t v ) { return static_cast<std::int32_t> ( v ); }
+
+    std::int32_t m_raw;
+};
+
+typedef fixed_point<16> q16_16;
+
+namespace std {
+
+    template < int fraction_bits >
+    class numeric_limits<fixed_point<fraction_bits>> {
+    public:
+        static const bool is_specialized = true;
+        static const bool is_signed = true;
+        static const bool is_integer = false;
+        static const bool is_exact = true;
+
+        static fixed_point<fraction_bits> min ( ) { return fixed_point<fraction_bits>::from_raw ( 1 ); }
+        static fixed_point<fraction_bits> max ( ) { return fixed_point<fraction_bits>::from_raw ( numeric_limits<int32_t>::max ( ) ); }
+        static fixed_point<fraction_bits> lowest ( ) { return fixed_point<fraction_bits>::from_raw ( numeric_limits<int32_t>::min ( ) ); }
+        static fixed_point<fraction_bits> epsilon ( ) { return fixed_point<fraction_bits>::from_raw ( 1 ); }
+    };
+
+}
+
+// square root by the bit at a time integer method, rounded down to
+// the last bit in at most 24 iterations for q16.16. negative values
+// give zero
+template < int fraction_bits >
+inline fixed_point<fraction_bits> sqrt ( fixed_point<fraction_bits> v )
+{
+    if ( v.raw ( ) <= 0 ) {
+        return fixed_point<fraction_bits> { };
+    }
+
+    // sqrt ( raw / one ) * one == sqrt ( raw * one )
+    std::uint64_t n = static_cast<std::uint64_t> ( v.raw ( ) ) << fraction_bits;
+    std::uint64_t root = 0;
+    std::uint64_t bit = std::uint64_t { 1 } << 62;
+
+    while ( bit > n ) {
+        bit >>= 2;
+    }
+
+    while ( bit != 0 ) {
+        if ( n >= root + bit ) {
+            n -= root + bit;
+            root = ( root >> 1 ) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+
+        bit >>= 2;
+    }
+
+    return fixed_point<fraction_bits>::from_raw ( static_cast<std::int32_t> ( root ) );
+}
+
+template < int fraction_bits >
+inline fixed_point<fraction_bits> fabs ( fixed_point<fraction_bits> v )
+{
+    return v.raw ( ) < 0 ? -v : v;
+}
+
+namespace fast_math {
+
+    // integer only sin / cos. the angle is reduced to a quarter turn
+    // and both taylor series are run in q2.30 so the result is good
+    // to the last bit of most formats
+    template < int fraction_bits >
+    inline void sincos ( fixed_point<fraction_bits> x, fixed_point<fraction_bits>& s, fixed_point<fraction_bits>& c )
+    {
+        static_assert ( fraction_bits < 30, "sincos works in 30 fraction bits" );
+
+        const int k_bits = 30;
+        const std::int64_t k_one = std::int64_t { 1 } << k_bits;
+        const std::int64_t k_half_pi = 1686629713;
+
+        // 1 / 3!, 1 / 5!, 1 / 7! and 1 / 2!, 1 / 4!, 1 / 6!, 1 / 8!
+        const std::int64_t k_sin_3 = 178956971;
+        const std::int64_t k_sin_5 = 8947849;
+        const std::int64_t k_sin_7 = 213044;
+        const std::int64_t k_cos_2 = 536870912;
+        const std::int64_t k_cos_4 = 44739243;
+        const std::int64_t k_cos_6 = 1491308;
+        const std::int64_t k_cos_8 = 26630;
+
+        std::int64_t a = static_cast<std::int64_t> ( x.raw ( ) ) * ( std::int64_t { 1 } << ( k_bits - fraction_bits ) );
+
+        // nearest quarter turn, leaves r in [ -pi / 4, pi / 4 ]
+        std::int64_t quarter = a >= 0 ? ( a + k_half_pi / 2 ) / k_half_pi : -( ( -a + k_half_pi / 2 ) / k_half_pi );
+        std::int64_t r = a - quarter * k_half_pi;
+        std::int64_t z = ( r * r ) >> k_bits;
+
+        std::int64_t ps = k_sin_5 - ( ( z * k_sin_7 ) >> k_bits );
+        ps = k_sin_3 - ( ( z * ps ) >> k_bits );
+        ps = k_one - ( ( z * ps ) >> k_bits );
+        ps = ( r * ps ) >> k_bits;
+
+        std::int64_t pc = k_cos_6 - ( ( z * k_cos_8 ) >> k_bits );
+        pc = k_cos_4 - ( ( z * pc ) >> k_bits );
+        pc = k_cos_2 - ( ( z * pc ) >> k_bits );
+        pc = k_one - ( ( z * pc ) >> k_bits );
+
+        // the quadrant swaps and flips them
+        std::int64_t sin_r = ps;
+        std::int64_t cos_r = pc;
+
+        switch ( quarter & 3 ) {
+            case 1: sin_r = pc; cos_r = -ps; break;
+            case 2: sin_r = -ps; cos_r = -pc; break;
+            case 3: sin_r = -pc; cos_r = ps; break;
+            default: break;
+        }
+
+        const int shift = k_bits - fraction_bits;
+        const std::int64_t round = std::int64_t { 1 } << ( shift - 1 );
+
+        s = fixed_point<fraction_bits>::from_raw ( static_cast<std::int32_t> ( ( sin_r + round ) >> shift ) );
+        c = fixed_point<fraction_bits>::from_raw ( static_cast<std::int32_t> ( ( cos_r + round ) >> shift ) );
+    }
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "profiler.hpp"
+#include "quad_world.hpp"
+#include "scene.hpp"
+#include "scene_file.hpp"
+
+using namespace std::chrono;
+
+// steps a scene as fast as it will go with no window, for machines
+// without a display. usage:
+//
+//     rigid_quads_headless [ scene ] [ bodies ] [ steps ] [ threads ] [ trace ] [ save ] [ compile ]
+//
+// scenes are stack, pyramid, rain, chain, pile and shapes, or the path of a
+// snapshot to carry on from or of a scene file, text or compiled, see
+// scene_file.hpp. bodies is ignored for a path. built with
+// PROFILE=1 it also prints the counters of the last step and, given
+// a trace path, writes every step out as chrome trace json. given a
+// save path the world is written there as a snapshot after the run.
+// given a compile path a scene file is written there compiled, run
+// with no steps to only compile it
+
+namespace {
+
+    const float k_dt = 1.0f / 60.0f;
+    const float k_friction = 0.1f;
+
+}
+
+int main ( int argc, char** argv )
+{
+    std::string name = argc > 1 ? argv [ 1 ] : "stack";
+    unsigned int bodies = argc > 2 ? static_cast<unsigned int> ( std::atoi ( argv [ 2 ] ) ) : 1000;
+    unsigned int steps = argc > 3 ? static_cast<unsigned int> ( std::atoi ( argv [ 3 ] ) ) : 600;
+    unsigned int threads = argc > 4 ? static_cast<unsigned int> ( std::atoi ( argv [ 4 ] ) ) : 0;
+    std::string trace = argc > 5 ? argv [ 5 ] : "";
+    std::string save = argc > 6 ? argv [ 6 ] : "";
+    std::string compile = argc > 7 ? argv [ 7 ] : "";
+
+    quad_world world;
+
+    world.set_threads ( threads );
+    world.set_gravity ( vec2 { 0.0f, -9.8f } );
+
+    scene_kind kind = scene_stack;
+    bool from_file = !scene::parse ( name, kind );
+
+    // a file has no scene to apply forces, an empty one stands in
+    scene s { kind, from_file ? 0 : bodies };
+    scene_file file;
+
+    auto build_start = high_resolution_clock::now ( );
+
+    if ( !from_file ) {
+        s.build ( world );
+    } else if ( !world.load ( name ) ) {
+        if ( !file.read ( name ) ) {
+            std::cerr << "unknown scene " << name << ", expected stack, pyramid, rain, chain, pile, shapes, "
+                      << "a snapshot or a scene file (" << file.error ( ) << ")" << std::endl;
+            return 1;
+        }
+
+        file.build ( world );
+
+        if ( !compile.empty ( ) && !file.write ( compile ) ) {
+            std::cerr << file.error ( ) << std::endl;
+            return 1;
+        }
+    }
+
+    auto build_end = high_resolution_clock::now ( );
+
+    double build_ms = static_cast<double> ( duration_cast<microseconds> ( build_end - build_start ).count ( ) ) / 1000.0;
+
+    std::cout << name << ": built " << world.size ( ) << " bodies in " << build_ms << " ms" << std::endl;
+
+    profiler& prof = profiler::instance ( );
+
+    if ( !trace.empty ( ) ) {
+        prof.start_trace ( );
+    }
+
+    auto start = high_resolution_clock::now ( );
+
+    for ( unsigned int i = 0; i < steps; ++i ) {
+        world.step ( k_dt, k_friction );
+
+        PROFILE_END_FRAME ( );
+    }
+
+    auto end = high_resolution_clock::now ( );
+
+    double ms = static_cast<double> ( duration_cast<microseconds> ( end - start ).count ( ) ) / 1000.0;
+
+    std::cout << name << ": " << world.size ( ) << " bodies, "
+              << steps << " steps on " << world.threads ( ) << " threads in "
+              << ms << " ms (" << ( steps ? ms / steps : 0.0 ) << " ms per step), "
+              << world.awake_count ( ) << " awake, "
+              << world.contacts ( ).size ( ) << " contacts, checksum "
+              << std::hex << world.checksum ( ) << std::dec << std::endl;
+
+#ifdef RIGID_BODY_PROFILE
+    const frame_stats& last = prof.last_frame ( );
+
+    for ( const profile_scope_stats& scope : last.scopes ) {
+        std::cout << "    " << scope.name << ": " << scope.ms << " ms over " << scope.calls << " calls" << std::endl;
+    }
+
+    for ( unsigned int i = 0; i < k_num_counters; ++i ) {
+        std::cout << "    " << profiler::counter_name ( static_cast<profile_counter> ( i ) ) << ": "
+                  << last.counters [ i ] << std::endl;
+    }
+#endif
+
+    if ( !save.empty ( ) && !world.save ( save ) ) {
+        std::cerr << "could not write " << save << std::endl;
+        return 1;
+    }
+
+    if ( !trace.empty ( ) ) {
+        prof.stop_trace ( );
+
+        if ( !prof.write_trace ( trace ) ) {
+            std::cerr << "could not write " << trace << std::endl;
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,589 @@
+#include "joint.hpp"
+
+#include <algorithm>
+
+#include "fast_math.hpp"
+#include "quad_world.hpp"
+
+namespace {
+
+    // below this the distance joint has no direction to push along
+    const float k_min_length = 1e-6f;
+
+    inline float cross ( const vec2& a, const vec2& b )
+    {
+        return a.x ( ) * b.y ( ) - a.y ( ) * b.x ( );
+    }
+
+    inline vec2 rotate ( const vec2& v, float s, float c )
+    {
+        return vec2 { v.x ( ) * c - v.y ( ) * s,
+                      v.x ( ) * s + v.y ( ) * c };
+    }
+
+    // velocity of the point r away from the center of body i
+    inline vec2 point_velocity ( const joint_bodies& v, unsigned int i, const vec2& r )
+    {
+        return vec2 { v.vx [ i ] - v.w [ i ] * r.y ( ),
+                      v.vy [ i ] + v.w [ i ] * r.x ( ) };
+    }
+
+    inline float inverse ( float k )
+    {
+        return k > 0.0f ? 1.0f / k : 0.0f;
+    }
+
+    // a linear impulse and the angular impulses it makes about each
+    // body. static bodies are shared between islands solved on
+    // different threads, so they are never written to
+    inline void apply ( const joint_bodies& v,
+                        unsigned int a,
+                        unsigned int b,
+                        const vec2& impulse,
+                        float angular_a,
+                        float angular_b )
+    {
+        if ( v.inv_mass [ a ] > 0.0f ) {
+            v.vx [ a ] -= impulse.x ( ) * v.inv_mass [ a ];
+            v.vy [ a ] -= impulse.y ( ) * v.inv_mass [ a ];
+            v.w [ a ] -= angular_a * v.inv_inertia [ a ];
+        }
+
+        if ( v.inv_mass [ b ] > 0.0f ) {
+            v.vx [ b ] += impulse.x ( ) * v.inv_mass [ b ];
+            v.vy [ b ] += impulse.y ( ) * v.inv_mass [ b ];
+            v.w [ b ] += angular_b * v.inv_inertia [ b ];
+        }
+    }
+
+    inline void apply_angular ( const joint_bodies& v, unsigned int a, unsigned int b, float impulse )
+    {
+        if ( v.inv_mass [ a ] > 0.0f ) {
+            v.w [ a ] -= impulse * v.inv_inertia [ a ];
+        }
+
+        if ( v.inv_mass [ b ] > 0.0f ) {
+            v.w [ b ] += impulse * v.inv_inertia [ b ];
+        }
+    }
+
+    inline void apply_point ( const joint_bodies& v, const joint_constraint& j, const vec2& impulse )
+    {
+        apply ( v, j.a, j.b, impulse, cross ( j.r_a, impulse ), cross ( j.r_b, impulse ) );
+    }
+
+    // keeps the anchors together with the 2x2 point mass matrix
+    void solve_point ( const joint_bodies& v, joint_constraint& j )
+    {
+        vec2 dv = point_velocity ( v, j.b, j.r_b ) - point_velocity ( v, j.a, j.r_a ) + j.linear_bias;
+
+        vec2 impulse { -( j.inv_k11 * dv.x ( ) + j.inv_k12 * dv.y ( ) ),
+                       -( j.inv_k12 * dv.x ( ) + j.inv_k22 * dv.y ( ) ) };
+
+        j.linear_impulse += impulse;
+
+        apply_point ( v, j, impulse );
+    }
+
+    // keeps the relative angle, or drives it at a speed when bias is
+    // minus the speed
+    float solve_angle ( const joint_bodies& v, const joint_constraint& j, float bias )
+    {
+        return -j.angular_mass * ( v.w [ j.b ] - v.w [ j.a ] + bias );
+    }
+
+    unsigned long long pair_key ( unsigned int slot_a, unsigned int slot_b )
+    {
+        if ( slot_b < slot_a ) {
+            std::swap ( slot_a, slot_b );
+        }
+
+        return ( static_cast<unsigned long long> ( slot_a ) << 32 ) | slot_b;
+    }
+
+}
+
+joint_def joint_def::distance ( const vec2& anchor_a, const vec2& anchor_b, float length )
+{
+    joint_def def;
+
+    def.kind = joint_distance;
+    def.anchor_a = anchor_a;
+    def.anchor_b = anchor_b;
+    def.length = length;
+
+    return def;
+}
+
+joint_def joint_def::rope ( const vec2& anchor_a, const vec2& anchor_b, float length )
+{
+    joint_def def = distance ( anchor_a, anchor_b, length );
+    def.kind = joint_rope;
+
+    return def;
+}
+
+joint_def joint_def::revolute ( const vec2& anchor )
+{
+    joint_def def;
+
+    def.kind = joint_revolute;
+    def.anchor_a = anchor;
+    def.anchor_b = anchor;
+
+    return def;
+}
+
+joint_def joint_def::weld ( const vec2& anchor )
+{
+    joint_def def = revolute ( anchor );
+    def.kind = joint_weld;
+
+    return def;
+}
+
+joint_def joint_def::prismatic ( const vec2& anchor, const vec2& axis )
+{
+    joint_def def = revolute ( anchor );
+    def.kind = joint_prismatic;
+    def.axis = axis;
+
+    return def;
+}
+
+joint_def joint_def::motor_to ( const vec2& linear_offset, float angular_offset, float max_force, float max_torque )
+{
+    joint_def def;
+
+    def.kind = joint_motor;
+    def.linear_offset = linear_offset;
+    def.angular_offset = angular_offset;
+    def.max_force = max_force;
+    def.max_torque = max_torque;
+
+    return def;
+}
+
+joint_set::joint_set ( ) :
+    m_filter_dirty { false }
+{
+
+}
+
+joint_handle joint_set::add ( const joint_constraint& joint )
+{
+    unsigned int s;
+
+    if ( !m_free_slots.empty ( ) ) {
+        s = m_free_slots.back ( );
+        m_free_slots.pop_back ( );
+    } else {
+        s = static_cast<unsigned int> ( m_slots.size ( ) );
+        m_slots.push_back ( slot { 0, 0 } );
+    }
+
+    m_slots [ s ].index = size ( );
+
+    m_joints.push_back ( joint );
+    m_joints.back ( ).slot = s;
+
+    m_filter_dirty = true;
+
+    return joint_handle { s, m_slots [ s ].generation };
+}
+
+void joint_set::remove ( joint_handle h )
+{
+    if ( !alive ( h ) ) {
+        return;
+    }
+
+    // swap the last joint into the hole
+    unsigned int index = m_slots [ h.slot ].index;
+
+    m_joints [ index ] = m_joints.back ( );
+    m_slots [ m_joints [ index ].slot ].index = index;
+    m_joints.pop_back ( );
+
+    m_slots [ h.slot ].generation++;
+    m_free_slots.push_back ( h.slot );
+
+    m_filter_dirty = true;
+}
+
+bool joint_set::alive ( joint_handle h ) const
+{
+    return h.slot < m_slots.size ( ) &&
+           m_slots [ h.slot ].generation == h.generation &&
+           m_slots [ h.slot ].index < size ( ) &&
+           m_joints [ m_slots [ h.slot ].index ].slot == h.slot;
+}
+
+void joint_set::remove_attached ( unsigned int slot )
+{
+    // backwards so the joints swapped in have been looked at
+    for ( unsigned int i = size ( ); i-- > 0; ) {
+        const joint_constraint& j = m_joints [ i ];
+
+        if ( j.slot_a == slot || j.slot_b == slot ) {
+            remove ( joint_handle { j.slot, m_slots [ j.slot ].generation } );
+        }
+    }
+}
+
+void joint_set::clear ( )
+{
+    // keep the slots around so outstanding handles stay invalid
+    for ( const joint_constraint& j : m_joints ) {
+        m_slots [ j.slot ].generation++;
+        m_free_slots.push_back ( j.slot );
+    }
+
+    m_joints.clear ( );
+    m_filter.clear ( );
+    m_filter_dirty = false;
+}
+
+void joint_set::reserve ( unsigned int count )
+{
+    m_joints.reserve ( count );
+    m_slots.reserve ( count );
+    m_filter.reserve ( count );
+}
+
+void joint_set::update ( const quad_world& world )
+{
+    for ( joint_constraint& j : m_joints ) {
+        j.a = world.slot_index ( j.slot_a );
+        j.b = world.slot_index ( j.slot_b );
+    }
+
+    if ( !m_filter_dirty ) {
+        return;
+    }
+
+    m_filter.clear ( );
+
+    for ( const joint_constraint& j : m_joints ) {
+        if ( !j.collide_connected ) {
+            m_filter.push_back ( pair_key ( j.slot_a, j.slot_b ) );
+        }
+    }
+
+    std::sort ( m_filter.begin ( ), m_filter.end ( ) );
+    m_filter.erase ( std::unique ( m_filter.begin ( ), m_filter.end ( ) ), m_filter.end ( ) );
+
+    m_filter_dirty = false;
+}
+
+bool joint_set::filtered ( unsigned int slot_a, unsigned int slot_b ) const
+{
+    return !m_filter.empty ( ) &&
+           std::binary_search ( m_filter.begin ( ), m_filter.end ( ), pair_key ( slot_a, slot_b ) );
+}
+
+void joint_set::prepare ( const joint_bodies& v, const unsigned int* joints, unsigned int count,
+                          float dt, float baumgarte, bool warm_starting )
+{
+    float inv_dt = 1.0f / dt;
+    float beta = baumgarte * inv_dt;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        joint_constraint& j = m_joints [ joints [ i ] ];
+
+        unsigned int a = j.a;
+        unsigned int b = j.b;
+
+        float im_a = v.inv_mass [ a ];
+        float im_b = v.inv_mass [ b ];
+        float ii_a = v.inv_inertia [ a ];
+        float ii_b = v.inv_inertia [ b ];
+
+        float sin_a, cos_a, sin_b, cos_b;
+
+        fast_math::sincos ( v.rotation [ a ], sin_a, cos_a );
+        fast_math::sincos ( v.rotation [ b ], sin_b, cos_b );
+
+        j.r_a = rotate ( j.local_a, sin_a, cos_a );
+        j.r_b = rotate ( j.local_b, sin_b, cos_b );
+
+        // from anchor a to anchor b
+        vec2 d { ( v.center_x [ b ] + j.r_b.x ( ) ) - ( v.center_x [ a ] + j.r_a.x ( ) ),
+                 ( v.center_y [ b ] + j.r_b.y ( ) ) - ( v.center_y [ a ] + j.r_a.y ( ) ) };
+
+        float angle = v.rotation [ b ] - v.rotation [ a ] - j.reference_angle;
+
+        j.angular_mass = inverse ( ii_a + ii_b );
+
+        if ( !warm_starting ) {
+            j.linear_impulse = vec2 { };
+            j.impulse = 0.0f;
+            j.angular_impulse = 0.0f;
+            j.motor_impulse = 0.0f;
+        }
+
+        switch ( j.kind ) {
+            case joint_distance:
+            case joint_rope: {
+                float length = d.mag ( );
+
+                j.axis = length > k_min_length ? d * ( 1.0f / length ) : vec2 { };
+                j.axial_a = cross ( j.r_a, j.axis );
+                j.axial_b = cross ( j.r_b, j.axis );
+                j.axial_mass = inverse ( im_a + im_b + ii_a * j.axial_a * j.axial_a + ii_b * j.axial_b * j.axial_b );
+
+                float error = length - j.length;
+
+                // a slack rope may close the gap in one step but no more
+                if ( j.kind == joint_rope && error < 0.0f ) {
+                    j.bias = error * inv_dt;
+                } else {
+                    j.bias = beta * error;
+                }
+
+                break;
+            }
+
+            case joint_revolute:
+            case joint_weld: {
+                float k11 = im_a + im_b + ii_a * j.r_a.y ( ) * j.r_a.y ( ) + ii_b * j.r_b.y ( ) * j.r_b.y ( );
+                float k12 = -ii_a * j.r_a.x ( ) * j.r_a.y ( ) - ii_b * j.r_b.x ( ) * j.r_b.y ( );
+                float k22 = im_a + im_b + ii_a * j.r_a.x ( ) * j.r_a.x ( ) + ii_b * j.r_b.x ( ) * j.r_b.x ( );
+
+                float det = k11 * k22 - k12 * k12;
+                float inv_det = det != 0.0f ? 1.0f / det : 0.0f;
+
+                j.inv_k11 = k22 * inv_det;
+                j.inv_k12 = -k12 * inv_det;
+                j.inv_k22 = k11 * inv_det;
+
+                j.linear_bias = d * beta;
+                j.angular_bias = beta * angle;
+
+                if ( j.kind == joint_revolute && !j.motor ) {
+                    j.motor_impulse = 0.0f;
+                }
+
+                break;
+            }
+
+            case joint_prismatic: {
+                j.axis = rotate ( j.local_axis, sin_a, cos_a );
+                j.perp = vec2 { -j.axis.y ( ), j.axis.x ( ) };
+
+                // a's lever arm reaches all the way to anchor b
+                vec2 arm = d + j.r_a;
+
+                j.axial_a = cross ( arm, j.axis );
+                j.axial_b = cross ( j.r_b, j.axis );
+                j.perp_a = cross ( arm, j.perp );
+                j.perp_b = cross ( j.r_b, j.perp );
+
+                j.axial_mass = inverse ( im_a + im_b + ii_a * j.axial_a * j.axial_a + ii_b * j.axial_b * j.axial_b );
+                j.linear_mass = inverse ( im_a + im_b + ii_a * j.perp_a * j.perp_a + ii_b * j.perp_b * j.perp_b );
+
+                j.bias = beta * j.perp.dot ( d );
+                j.angular_bias = beta * angle;
+
+                if ( !j.motor ) {
+                    j.motor_impulse = 0.0f;
+                }
+
+                break;
+            }
+
+            case joint_motor: {
+                // pulls centers, not anchors
+                j.r_a = vec2 { };
+                j.r_b = vec2 { };
+
+                vec2 offset = rotate ( j.linear_offset, sin_a, cos_a );
+                vec2 error { v.center_x [ b ] - v.center_x [ a ] - offset.x ( ),
+                             v.center_y [ b ] - v.center_y [ a ] - offset.y ( ) };
+
+                j.linear_mass = inverse ( im_a + im_b );
+                j.linear_bias = error * ( j.correction * inv_dt );
+                j.angular_bias = ( v.rotation [ b ] - v.rotation [ a ] - j.angular_offset ) * ( j.correction * inv_dt );
+
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+void joint_set::warm_start ( const joint_bodies& v, const unsigned int* joints, unsigned int count ) const
+{
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const joint_constraint& j = m_joints [ joints [ i ] ];
+
+        switch ( j.kind ) {
+            case joint_distance:
+            case joint_rope:
+                apply ( v, j.a, j.b, j.axis * j.impulse, j.axial_a * j.impulse, j.axial_b * j.impulse );
+                break;
+
+            case joint_revolute:
+            case joint_weld:
+                apply_point ( v, j, j.linear_impulse );
+                apply_angular ( v, j.a, j.b, j.angular_impulse + j.motor_impulse );
+                break;
+
+            case joint_prismatic:
+                apply ( v, j.a, j.b,
+                        j.perp * j.impulse + j.axis * j.motor_impulse,
+                        j.perp_a * j.impulse + j.axial_a * j.motor_impulse,
+                        j.perp_b * j.impulse + j.axial_b * j.motor_impulse );
+                apply_angular ( v, j.a, j.b, j.angular_impulse );
+                break;
+
+            case joint_motor:
+                apply ( v, j.a, j.b, j.linear_impulse, 0.0f, 0.0f );
+                apply_angular ( v, j.a, j.b, j.angular_impulse );
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+void joint_set::iterate ( const joint_bodies& v, const unsigned int* joints, unsigned int count, float dt )
+{
+    for ( unsigned int i = 0; i < count; ++i ) {
+        joint_constraint& j = m_joints [ joints [ i ] ];
+
+        switch ( j.kind ) {
+            case joint_distance:
+            case joint_rope: {
+                vec2 dv = point_velocity ( v, j.b, j.r_b ) - point_velocity ( v, j.a, j.r_a );
+
+                float lambda = -j.axial_mass * ( dv.dot ( j.axis ) + j.bias );
+
+                // a rope only pulls
+                if ( j.kind == joint_rope ) {
+                    float total = std::min ( j.impulse + lambda, 0.0f );
+
+                    lambda = total - j.impulse;
+                }
+
+                j.impulse += lambda;
+
+                apply ( v, j.a, j.b, j.axis * lambda, j.axial_a * lambda, j.axial_b * lambda );
+                break;
+            }
+
+            case joint_revolute: {
+                // the motor first so the point constraint has the last word
+                if ( j.motor ) {
+                    float max_impulse = j.max_motor_force * dt;
+                    float lambda = solve_angle ( v, j, -j.motor_speed );
+                    float total = std::max ( -max_impulse, std::min ( j.motor_impulse + lambda, max_impulse ) );
+
+                    lambda = total - j.motor_impulse;
+                    j.motor_impulse = total;
+
+                    apply_angular ( v, j.a, j.b, lambda );
+                }
+
+                solve_point ( v, j );
+                break;
+            }
+
+            case joint_weld: {
+                float lambda = solve_angle ( v, j, j.angular_bias );
+
+                j.angular_impulse += lambda;
+                apply_angular ( v, j.a, j.b, lambda );
+
+                solve_point ( v, j );
+                break;
+            }
+
+            case joint_prismatic: {
+                if ( j.motor ) {
+                    float speed = j.axis.dot ( vec2 { v.vx [ j.b ] - v.vx [ j.a ], v.vy [ j.b ] - v.vy [ j.a ] } ) +
+                                  j.axial_b * v.w [ j.b ] - j.axial_a * v.w [ j.a ];
+
+                    float max_impulse = j.max_motor_force * dt;
+                    float lambda = j.axial_mass * ( j.motor_speed - speed );
+                    float total = std::max ( -max_impulse, std::min ( j.motor_impulse + lambda, max_impulse ) );
+
+                    lambda = total - j.motor_impulse;
+                    j.motor_impulse = total;
+
+                    apply ( v, j.a, j.b, j.axis * lambda, j.axial_a * lambda, j.axial_b * lambda );
+                }
+
+                float angular = solve_angle ( v, j, j.angular_bias );
+
+                j.angular_impulse += angular;
+                apply_angular ( v, j.a, j.b, angular );
+
+                float speed = j.perp.dot ( vec2 { v.vx [ j.b ] - v.vx [ j.a ], v.vy [ j.b ] - v.vy [ j.a ] } ) +
+                              j.perp_b * v.w [ j.b ] - j.perp_a * v.w [ j.a ];
+
+                float lambda = -j.linear_mass * ( speed + j.bias );
+
+                j.impulse += lambda;
+                apply ( v, j.a, j.b, j.perp * lambda, j.perp_a * lambda, j.perp_b * lambda );
+                break;
+            }
+
+            case joint_motor: {
+                float max_torque = j.max_torque * dt;
+                float lambda = solve_angle ( v, j, j.angular_bias );
+                float total = std::max ( -max_torque, std::min ( j.angular_impulse + lambda, max_torque ) );
+
+                lambda = total - j.angular_impulse;
+                j.angular_impulse = total;
+
+                apply_angular ( v, j.a, j.b, lambda );
+
+                // the linear impulse is bounded as a whole, not per axis
+                vec2 dv { v.vx [ j.b ] - v.vx [ j.a ] + j.linear_bias.x ( ),
+                          v.vy [ j.b ] - v.vy [ j.a ] + j.linear_bias.y ( ) };
+
+                vec2 previous = j.linear_impulse;
+                vec2 impulse = previous - dv * j.linear_mass;
+
+                float max_force = j.max_force * dt;
+                float length = impulse.mag ( );
+
+                if ( length > max_force ) {
+                    impulse *= max_force / length;
+                }
+
+                j.linear_impulse = impulse;
+
+                apply ( v, j.a, j.b, impulse - previous, 0.0f, 0.0f );
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+void joint_set::restore ( const joint_constraint* joints, unsigned int count,
+                          const unsigned int* slots, unsigned int slot_count,
+                          const unsigned int* free_slots, unsigned int free_slot_count )
+{
+    static_assert ( sizeof ( slot ) == 2 * sizeof ( unsigned int ), "slots are handed out as index, generation pairs" );
+
+    m_joints.assign ( joints, joints + count );
+
+    m_slots.resize ( slot_count );
+
+    for ( unsigned int i = 0; i < slot_count; ++i ) {
+        m_slots [ i ].index = slots [ i * 2 ];
+        m_slots [ i ].generation = slots [ i * 2 + 1 ];
+    }
+
+    m_free_slots.assign ( free_slots, free_slots + free_slot_count );
+
+    m_filter_dirty = true;
+}
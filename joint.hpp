@@ -0,0 +1,233 @@
+#ifndef JOINT
+#define JOINT
+
+#include <vector>
+
+#include "vector2.hpp"
+
+class quad_world;
+
+enum joint_kind {
+    // keeps the anchors a fixed length apart
+    joint_distance,
+
+    // keeps the anchors at most a length apart, slack otherwise
+    joint_rope,
+
+    // pins the anchors together, the bodies turn freely about them
+    joint_revolute,
+
+    // pins the anchors together and locks the relative angle
+    joint_weld,
+
+    // lets b slide along an axis fixed in a, the relative angle is locked
+    joint_prismatic,
+
+    // drives b towards an offset and angle relative to a with bounded
+    // force and torque
+    joint_motor,
+
+    k_num_joint_kinds
+};
+
+// what to build, anchors and the axis are in world space at the time
+// of quad_world::create_joint and are fixed to the bodies from then on
+struct joint_def {
+    joint_kind kind;
+
+    vec2 anchor_a;
+    vec2 anchor_b;
+    vec2 axis;
+
+    // distance and rope, less than zero takes the current distance
+    float length;
+
+    // revolute and prismatic can be driven at a speed, in radians or
+    // metres per second, with at most max_motor_force newtons, or
+    // newton metres for revolute
+    bool motor;
+    float motor_speed;
+    float max_motor_force;
+
+    // motor joint target, b's center relative to a's in a's frame and
+    // b's angle relative to a's, approached by correction a step
+    vec2 linear_offset;
+    float angular_offset;
+    float max_force;
+    float max_torque;
+    float correction;
+
+    // contacts between the two bodies are skipped unless this is set
+    bool collide_connected;
+
+    joint_def ( ) :
+        kind { joint_revolute },
+        length { -1.0f },
+        motor { false },
+        motor_speed { 0.0f },
+        max_motor_force { 0.0f },
+        angular_offset { 0.0f },
+        max_force { 1.0f },
+        max_torque { 1.0f },
+        correction { 0.3f },
+        collide_connected { false }
+    {}
+
+    static joint_def distance ( const vec2& anchor_a, const vec2& anchor_b, float length = -1.0f );
+    static joint_def rope ( const vec2& anchor_a, const vec2& anchor_b, float length );
+    static joint_def revolute ( const vec2& anchor );
+    static joint_def weld ( const vec2& anchor );
+    static joint_def prismatic ( const vec2& anchor, const vec2& axis );
+    static joint_def motor_to ( const vec2& linear_offset, float angular_offset, float max_force, float max_torque );
+};
+
+struct joint_handle {
+    unsigned int slot;
+    unsigned int generation;
+};
+
+// a joint as the solver keeps it. plain data so whole arrays of them
+// can be copied into and out of snapshots
+struct joint_constraint {
+    joint_kind kind;
+
+    // handle slot of this joint and of the two bodies
+    unsigned int slot;
+    unsigned int slot_a;
+    unsigned int slot_b;
+
+    // dense indices of the bodies, refreshed every step
+    unsigned int a;
+    unsigned int b;
+
+    // anchors relative to each body's center in its own frame, the
+    // axis in a's frame
+    vec2 local_a;
+    vec2 local_b;
+    vec2 local_axis;
+
+    // b's angle minus a's when the joint was made
+    float reference_angle;
+    float length;
+
+    bool motor;
+    float motor_speed;
+    float max_motor_force;
+
+    vec2 linear_offset;
+    float angular_offset;
+    float max_force;
+    float max_torque;
+    float correction;
+
+    bool collide_connected;
+
+    // anchors rotated into world space and the world axis, from prepare
+    vec2 r_a;
+    vec2 r_b;
+    vec2 axis;
+    vec2 perp;
+
+    // lever arms of the axis and its perpendicular
+    float axial_a, axial_b;
+    float perp_a, perp_b;
+
+    // inverse of the 2x2 point mass matrix and the 1d masses
+    float inv_k11, inv_k12, inv_k22;
+    float linear_mass;
+    float angular_mass;
+    float axial_mass;
+
+    vec2 linear_bias;
+    float bias;
+    float angular_bias;
+
+    // accumulated over the iterations and kept for warm starting
+    vec2 linear_impulse;
+    float impulse;
+    float angular_impulse;
+    float motor_impulse;
+};
+
+// the streams the joint passes read and write, by dense body index
+struct joint_bodies {
+    float* vx;
+    float* vy;
+    float* w;
+    const float* inv_mass;
+    const float* inv_inertia;
+    const float* center_x;
+    const float* center_y;
+    const float* rotation;
+};
+
+// every joint in a world, packed in one array and addressed through
+// stable handles the same way as bodies. the solver runs them per
+// island next to the contacts, the passes take a run of joint indices.
+class joint_set {
+public:
+    joint_set ( );
+
+    joint_handle add ( const joint_constraint& joint );
+    void remove ( joint_handle h );
+    bool alive ( joint_handle h ) const;
+
+    // remove every joint on the body in slot
+    void remove_attached ( unsigned int slot );
+
+    void clear ( );
+    void reserve ( unsigned int count );
+
+    unsigned int size ( ) const { return static_cast<unsigned int> ( m_joints.size ( ) ); }
+    bool empty ( ) const { return m_joints.empty ( ); }
+
+    joint_constraint& get ( joint_handle h ) { return m_joints [ m_slots [ h.slot ].index ]; }
+    const joint_constraint& get ( joint_handle h ) const { return m_joints [ m_slots [ h.slot ].index ]; }
+
+    joint_constraint* data ( ) { return m_joints.data ( ); }
+    const joint_constraint* data ( ) const { return m_joints.data ( ); }
+
+    // look up the bodies' dense indices and, if joints came or went,
+    // which body pairs have contacts turned off. call before the
+    // narrow phase every step
+    void update ( const quad_world& world );
+
+    // true if a joint between the bodies in these slots turns their
+    // contacts off, as of the last update
+    bool filtered ( unsigned int slot_a, unsigned int slot_b ) const;
+
+    // the passes over the count joints whose indices are in joints,
+    // run in this order like the contact passes
+    void prepare ( const joint_bodies& v, const unsigned int* joints, unsigned int count,
+                   float dt, float baumgarte, bool warm_starting );
+    void warm_start ( const joint_bodies& v, const unsigned int* joints, unsigned int count ) const;
+    void iterate ( const joint_bodies& v, const unsigned int* joints, unsigned int count, float dt );
+
+    // handle slots as index, generation pairs and the free list, for
+    // snapshots. restore takes them back along with the joints
+    const unsigned int* slots ( ) const { return reinterpret_cast<const unsigned int*> ( m_slots.data ( ) ); }
+    unsigned int slot_count ( ) const { return static_cast<unsigned int> ( m_slots.size ( ) ); }
+    const unsigned int* free_slots ( ) const { return m_free_slots.data ( ); }
+    unsigned int free_slot_count ( ) const { return static_cast<unsigned int> ( m_free_slots.size ( ) ); }
+
+    void restore ( const joint_constraint* joints, unsigned int count,
+                   const unsigned int* slots, unsigned int slot_count,
+                   const unsigned int* free_slots, unsigned int free_slot_count );
+
+private:
+
+    struct slot {
+        unsigned int index;
+        unsigned int generation;
+    };
+
+    std::vector<joint_constraint> m_joints;
+    std::vector<slot> m_slots;
+    std::vector<unsigned int> m_free_slots;
+
+    // sorted body slot pairs of joints that turn contacts off
+    std::vector<unsigned long long> m_filter;
+    bool m_filter_dirty;
+};
+
+#endif
@@ -6,17 +6,23 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_opengl.h>
 
-#include "rigid_quad_2d.hpp"
+#include "profiler.hpp"
+#include "quad_renderer.hpp"
+#include "quad_world.hpp"
+#include "recorder.hpp"
+#include "region_streamer.hpp"
+#include "scene_file.hpp"
 
 using namespace std::chrono;
 
-void draw_quad ( const rigid_quad_2d& quad );
+void draw_outline ( const vec2* points, unsigned int count );
 
 class app {
 public:
 	app ( const std::string& window_title,
 		  int window_width,
-	      int winddow_height );
+	      int winddow_height,
+	      const std::string& scene_path = "" );
 	~app ( );
 
 	void run ( );
@@ -24,8 +30,12 @@ public:
 private:
 
 	void update ( float dt );
+	void apply_controls ( );
 	void render ( );
 
+	void toggle_recording ( );
+	void toggle_playback ( );
+
 	SDL_Window* m_window;
 	SDL_GLContext m_gl_context;
 
@@ -36,33 +46,81 @@ private:
 
     bool m_collided;
 
-	rigid_quad_2d m_player;
-	rigid_quad_2d m_attach;
+    quad_world m_world;
+
+	quad_world::handle m_player;
+	quad_world::handle m_attach;
+
+    quad_world::handle m_obj;
 
-    rigid_quad_2d m_obj;
+    // the attachment hangs off the player's corner on a rope
+    joint_handle m_tether;
 
     vec2 m_collided_point;
     vec2 m_collided_normal;
+
+    // r records every step to disk, p plays the recording back
+    recorder m_recorder;
+    replayer m_replayer;
+    bool m_playing;
+
+    // every body in one instanced draw, immediate mode if the context
+    // is too old for it
+    quad_renderer m_renderer;
+
+    // only the regions around the player are simulated, the rest of
+    // a large scene is frozen or paged out to disk
+    region_streamer m_streamer;
 };
 
+namespace {
+
+    const char* const k_recording_path = "rigid_quads.rec";
+
+}
+
 app::app ( const std::string& window_title,
 		   int window_width,
-	       int window_height ) :
+	       int window_height,
+	       const std::string& scene_path ) :
 	m_left_key_down { false },
 	m_right_key_down { false },
 	m_forward_key_down { false },
 	m_backward_key_down { false },
     m_collided { false },
-	m_player { vec2 { 0.0f, 0.0f },
-		       0.15f, 0.2f,
-		       0.2f, 0.0f },
-    m_attach { vec2 { 0.15f, 0.2f },
-	           0.05f, 0.1f,
-	           0.07f, 0.0f },
-    m_obj { vec2{ -0.3f, -0.3f },
-            0.2f, 0.3f,
-            0.3f, 0.0f }
+	m_player ( m_world.create ( vec2 { 0.0f, 0.0f },
+		                        0.15f, 0.2f,
+		                        0.2f, 0.0f ) ),
+    m_attach ( m_world.create ( vec2 { 0.15f, 0.2f },
+	                            0.05f, 0.1f,
+	                            0.07f, 0.0f ) ),
+    m_obj ( m_world.create ( vec2{ -0.3f, -0.3f },
+                             0.2f, 0.3f,
+                             0.3f, 0.0f ) ),
+    m_playing { false },
+    m_streamer { m_world }
 {
+    joint_def tether = joint_def::rope ( m_world.get ( m_player ).corner ( 0 ),
+                                         m_world.get ( m_attach ).corner ( 0 ),
+                                         0.15f );
+    tether.collide_connected = true;
+
+    m_tether = m_world.create_joint ( m_player, m_attach, tether );
+
+    // the player can be pushed fast enough to pass through the others
+    m_world.set_bullet ( m_player, true );
+
+    // anything else comes from a scene file, around the player
+    if ( !scene_path.empty ( ) ) {
+        scene_file file;
+
+        if ( !file.read ( scene_path ) ) {
+            throw std::runtime_error ( "could not load " + scene_path + ": " + file.error ( ) );
+        }
+
+        file.build ( m_world );
+    }
+
 	if ( SDL_Init ( SDL_INIT_EVERYTHING ) ) {
 		throw std::runtime_error ( std::string( "SDL_Init() failed: " ) + SDL_GetError() );
 	}
@@ -93,10 +151,15 @@ app::app ( const std::string& window_title,
     // set the viewport
     glViewport ( 0, 0, window_width, window_height );
     glOrtho ( -1.0, 1.0, -1.0, 1.0, -1.0, 1.0 );
+
+    if ( !m_renderer.init ( ) ) {
+        std::cout << "opengl 4.4 not available, drawing in immediate mode" << std::endl;
+    }
 }
 
 app::~app ( )
 {
+    m_renderer.shutdown ( );
     SDL_DestroyWindow ( m_window );
 	SDL_Quit ( );
 }
@@ -147,6 +210,12 @@ void app::run ( )
                 	case SDLK_d:
                 		m_right_key_down = true;
                 		break;
+                	case SDLK_r:
+                		toggle_recording ( );
+                		break;
+                	case SDLK_p:
+                		toggle_playback ( );
+                		break;
                 	default:
                 	    break;
                 }
@@ -173,16 +242,75 @@ void app::run ( )
         // update
         update ( dt );
 
+        // the renderer copies the bodies out on its own thread while
+        // this one clears and draws the rest
+        m_renderer.fill ( m_world );
+
         // render: clear buffers, render, swap buffers
         glClear ( GL_COLOR_BUFFER_BIT );
         render ( );
         SDL_GL_SwapWindow ( m_window );
+
+        PROFILE_END_FRAME ( );
     }
 }
 
 void app::update ( float dt )
 {
-    rigid_quad_2d::collision_results res;
+    PROFILE_SCOPE ( "update" );
+
+    float friction = 0.1f;
+
+    // physics runs at the world's fixed rate, controls are applied
+    // before every step so they act the same at any frame rate
+    unsigned int steps = m_world.accumulate ( dt );
+
+    // recordings address bodies by slot, so the world's bodies stay
+    // put while one is being made or played
+    if ( steps > 0 && !m_playing && !m_recorder.recording ( ) ) {
+        m_streamer.clear_points ( );
+        m_streamer.add_point ( m_world.get ( m_player ).center ( ) );
+
+        if ( !m_streamer.update ( ) ) {
+            std::cerr << "could not page a region to " << m_streamer.settings ( ).directory << std::endl;
+        }
+    }
+
+    for ( unsigned int i = 0; i < steps; ++i ) {
+        // play back without simulating until the recording runs out
+        if ( m_playing ) {
+            if ( m_replayer.next ( ) ) {
+                m_replayer.apply ( m_world );
+                continue;
+            }
+
+            m_playing = false;
+        }
+
+        apply_controls ( );
+        m_world.step ( m_world.fixed_step ( ), friction );
+        m_recorder.record ( m_world );
+    }
+
+    // show the first contact the solver found
+    const std::vector<contact_constraint>& contacts = m_world.contacts ( );
+
+    if( !contacts.empty ( ) ) {
+        const contact_constraint& c = contacts [ 0 ];
+        vec2 center = m_world.get ( m_world.handle_at ( c.a ) ).center ( );
+
+        m_collided = true;
+        m_collided_point = center + c.points [ 0 ].r_a;
+        m_collided_normal = c.normal;
+    }
+    else{
+        m_collided = false;
+    }
+}
+
+void app::apply_controls ( )
+{
+    quad_world::quad_ref player = m_world.get ( m_player );
 
 	vec2 force;
 
@@ -202,68 +330,58 @@ void app::update ( float dt )
 		force += vec2 { 0.0f, -1.0f };
 	}
 
-    m_player.push ( force );
-
-    vec2 rope = m_player.corner ( 0 ) - m_attach.corner ( 0 );
-
-    if( rope.mag () > 0.15f ) {
-        vec2 rope_negation = rope;
-        rope_negation.normalize ();
-        rope_negation *= 0.1f;
-        rope -= rope_negation;
+    player.push ( force );
+    m_recorder.input ( m_world, m_player, force );
+}
 
-        m_attach.pull ( -rope, m_attach.corner ( 0 ) );
-        m_player.push ( -rope, m_player.corner ( 0 ) );
+void app::toggle_recording ( )
+{
+    if ( m_recorder.recording ( ) ) {
+        m_recorder.close ( );
+        std::cout << "recorded " << m_recorder.frames ( ) << " steps, "
+                  << m_recorder.dropped ( ) << " dropped, "
+                  << m_recorder.bytes_written ( ) << " bytes" << std::endl;
+    } else if ( !m_playing && !m_recorder.open ( k_recording_path ) ) {
+        std::cerr << "could not record to " << k_recording_path << std::endl;
     }
+}
 
-    float friction = 0.1f;
+void app::toggle_playback ( )
+{
+    if ( m_playing ) {
+        m_playing = false;
+    } else if ( !m_recorder.recording ( ) ) {
+        m_playing = m_replayer.open ( k_recording_path );
+    }
+}
 
-    m_player.update ( dt, friction );
-    m_attach.update ( dt, friction );
-    m_obj.update ( dt, friction );
+void app::render ( )
+{
+	PROFILE_SCOPE ( "render" );
 
-    rigid_quad_2d::collision ( m_player, m_attach, res );
+    quad_world::quad_ref player = m_world.get ( m_player );
+    quad_world::quad_ref attach = m_world.get ( m_attach );
 
-    if( res.collided ) {
-        m_collided = true;
-        m_collided_point = res.point;
-        m_collided_normal = res.normal;
+    vec2 player_corners [ rigid_quad_2d::k_num_corners ];
+    vec2 attach_corners [ rigid_quad_2d::k_num_corners ];
 
-        // vec2 pp = res.point - m_player.center ( );
-        // vec2 ap = res.point - m_attach.center ( );
+    player.interpolated_corners ( player_corners );
+    attach.interpolated_corners ( attach_corners );
 
-        // float j_num = ( pp - ap ).dot ( res.normal ) * -( 1.0f + 0.5f );
-        // float j_denum = res.normal.dot ( res.normal * ( m_player.inv_mass() + m_attach.inv_mass() ) );
-        
-        // float j = j_num / j_denum;
+    // the view follows the player
+    vec2 eye = player.interpolated_center ( );
 
-        // m_player.impulse ( j, res.normal );
-        // m_attach.impulse ( j, -res.normal );
-    }
-    else{
-        m_collided = false;
-    }
-}
+    glMatrixMode ( GL_MODELVIEW );
+    glLoadIdentity ( );
+    glOrtho ( -1.0, 1.0, -1.0, 1.0, -1.0, 1.0 );
+    glTranslatef ( -eye.x ( ), -eye.y ( ), 0.0f );
 
-void app::render ( )
-{
 	glBegin ( GL_LINES );
 
-    if( m_collided ){
-        glColor3f ( 0.0f, 1.0f, 1.0f );
-    }
-    else{
-        glColor3f ( 1.0f, 1.0f, 1.0f );
-    }
-
-	draw_quad ( m_player );
-    draw_quad ( m_attach );
-    draw_quad ( m_obj );
-
 	glColor3f ( 1.0f, 0.0f, 0.0f );
 
-    glVertex3f ( m_player.corner ( 0 ).x(), m_player.corner ( 0 ).y(), 0.0f );
-	glVertex3f ( m_attach.corner ( 0 ).x(), m_attach.corner ( 0 ).y(), 0.0f );
+    glVertex3f ( player_corners [ 0 ].x(), player_corners [ 0 ].y(), 0.0f );
+	glVertex3f ( attach_corners [ 0 ].x(), attach_corners [ 0 ].y(), 0.0f );
 
     if ( m_collided ) {
         glVertex3f ( m_collided_point.x() - 0.1f, m_collided_point.y(), 0.0f );
@@ -280,28 +398,44 @@ void app::render ( )
                      0.0f );
     }
 
+    // the bodies, cyan while anything is touching
+    float red = m_collided ? 0.0f : 1.0f;
+
+    if ( m_renderer.available ( ) ) {
+        glEnd ( );
+
+        m_renderer.draw ( red, 1.0f, 1.0f );
+        return;
+    }
+
+    glColor3f ( red, 1.0f, 1.0f );
+
+    for ( unsigned int i = 0; i < m_world.size ( ); ++i ) {
+        vec2 outline [ quad_world::k_max_outline ];
+
+        draw_outline ( outline, m_world.interpolated_outline ( i, outline ) );
+    }
+
 	glEnd ( );
 }
 
-void draw_quad ( const rigid_quad_2d& quad )
+void draw_outline ( const vec2* points, unsigned int count )
 {
-	for ( unsigned int i = 0; i < rigid_quad_2d::k_num_corners; ++i ) {
-		unsigned int next = ( i + 1 ) % rigid_quad_2d::k_num_corners;
+	for ( unsigned int i = 0; i < count; ++i ) {
+		unsigned int next = ( i + 1 ) % count;
 
-		glVertex3f ( quad.corner(i).x(), quad.corner(i).y(), 0.0f );
-		glVertex3f ( quad.corner(next).x(), quad.corner(next).y(), 0.0f );
+		glVertex3f ( points[i].x(), points[i].y(), 0.0f );
+		glVertex3f ( points[next].x(), points[next].y(), 0.0f );
 	}
 }
 
 int main ( int argc, char** argv ) {
 
-	// do something unuseful with these
-	for ( int i = 0; i < argc; i++ ) {
-		argv++;
-	}
+	// a scene file to load, see scene_file.hpp
+	std::string scene_path = argc > 1 ? argv [ 1 ] : "";
 
 	try {
-		app a { "rigid_body_2d", 1024, 768 };
+		app a { "rigid_body_2d", 1024, 768, scene_path };
 		a.run ();
 	} catch ( const std::runtime_error& e ) {
 		std::cerr << e.what ( ) << std::endl;
@@ -0,0 +1,196 @@
+#include "profiler.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+    const char* const k_counter_names [ k_num_counters ] = {
+        "pairs_tested",
+        "contacts",
+        "contact_points",
+        "shape_tests",
+        "islands",
+        "sleeping_bodies",
+        "bullets"
+    };
+
+    std::atomic<unsigned int> g_next_thread { 0 };
+
+}
+
+double frame_stats::scope_ms ( const char* name ) const
+{
+    for ( const profile_scope_stats& s : scopes ) {
+        if ( s.name == name || std::strcmp ( s.name, name ) == 0 ) {
+            return s.ms;
+        }
+    }
+
+    return 0.0;
+}
+
+profiler& profiler::instance ( )
+{
+    static profiler p;
+    return p;
+}
+
+profiler::profiler ( ) :
+    m_epoch { clock::now ( ) },
+    m_frame_start { m_epoch },
+    m_current { },
+    m_last { },
+    m_tracing { false },
+    m_max_events { 0 }
+{
+    for ( unsigned int i = 0; i < k_num_counters; ++i ) {
+        m_counters [ i ] = 0;
+    }
+}
+
+void profiler::record ( const char* name,
+                        clock::time_point start,
+                        clock::time_point end )
+{
+    double ms = std::chrono::duration<double, std::milli> ( end - start ).count ( );
+
+    std::lock_guard<std::mutex> lock ( m_mutex );
+
+    // a handful of scopes per frame, a linear search beats a map
+    profile_scope_stats* stats = nullptr;
+
+    for ( profile_scope_stats& s : m_current.scopes ) {
+        if ( s.name == name ) {
+            stats = &s;
+            break;
+        }
+    }
+
+    if ( !stats ) {
+        m_current.scopes.push_back ( profile_scope_stats { name, 0.0, 0 } );
+        stats = &m_current.scopes.back ( );
+    }
+
+    stats->ms += ms;
+    stats->calls++;
+
+    if ( m_tracing.load ( std::memory_order_relaxed ) && m_events.size ( ) < m_max_events ) {
+        double start_us = to_us ( start );
+        m_events.push_back ( trace_event { name, thread_index ( ), start_us, to_us ( end ) - start_us } );
+    }
+}
+
+void profiler::end_frame ( )
+{
+    clock::time_point now = clock::now ( );
+
+    std::lock_guard<std::mutex> lock ( m_mutex );
+
+    for ( unsigned int i = 0; i < k_num_counters; ++i ) {
+        m_current.counters [ i ] = m_counters [ i ].exchange ( 0, std::memory_order_relaxed );
+    }
+
+    m_current.ms = std::chrono::duration<double, std::milli> ( now - m_frame_start ).count ( );
+
+    if ( m_tracing.load ( std::memory_order_relaxed ) && m_trace_counters.size ( ) < m_max_events ) {
+        trace_counters t;
+        t.time_us = to_us ( now );
+        std::memcpy ( t.counters, m_current.counters, sizeof ( t.counters ) );
+
+        m_trace_counters.push_back ( t );
+    }
+
+    unsigned long long frame = m_current.frame;
+
+    m_last.scopes.swap ( m_current.scopes );
+    m_last.frame = frame;
+    m_last.ms = m_current.ms;
+    std::memcpy ( m_last.counters, m_current.counters, sizeof ( m_last.counters ) );
+
+    // keep the names in the same order frame to frame
+    m_current.scopes = m_last.scopes;
+
+    for ( profile_scope_stats& s : m_current.scopes ) {
+        s.ms = 0.0;
+        s.calls = 0;
+    }
+
+    m_current.frame = frame + 1;
+    m_frame_start = now;
+}
+
+const char* profiler::counter_name ( profile_counter counter )
+{
+    return counter < k_num_counters ? k_counter_names [ counter ] : "unknown";
+}
+
+void profiler::start_trace ( unsigned int max_events )
+{
+    std::lock_guard<std::mutex> lock ( m_mutex );
+
+    m_events.clear ( );
+    m_trace_counters.clear ( );
+    m_max_events = max_events;
+    m_tracing = true;
+}
+
+void profiler::stop_trace ( )
+{
+    m_tracing = false;
+}
+
+bool profiler::write_trace ( const std::string& path ) const
+{
+    std::ofstream out { path };
+
+    if ( !out ) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock ( m_mutex );
+
+    // microsecond timestamps run past the default six digits
+    out << std::fixed;
+    out.precision ( 3 );
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    bool first = true;
+
+    for ( const trace_event& e : m_events ) {
+        out << ( first ? "" : ",\n" )
+            << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+            << ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us << "}";
+
+        first = false;
+    }
+
+    for ( const trace_counters& t : m_trace_counters ) {
+        out << ( first ? "" : ",\n" )
+            << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << t.time_us << ",\"args\":{";
+
+        for ( unsigned int i = 0; i < k_num_counters; ++i ) {
+            out << ( i ? "," : "" ) << "\"" << k_counter_names [ i ] << "\":" << t.counters [ i ];
+        }
+
+        out << "}}";
+
+        first = false;
+    }
+
+    out << "\n]}\n";
+
+    return static_cast<bool> ( out );
+}
+
+double profiler::to_us ( clock::time_point t ) const
+{
+    return std::chrono::duration<double, std::micro> ( t - m_epoch ).count ( );
+}
+
+unsigned int profiler::thread_index ( )
+{
+    static thread_local unsigned int index = g_next_thread++;
+    return index;
+}
@@ -0,0 +1,164 @@
+#ifndef PROFILER
+#define PROFILER
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// counters the engine bumps while it steps, read back per frame
+enum profile_counter {
+    counter_pairs_tested,       // broad phase pairs handed to the narrow phase
+    counter_contacts,           // pairs that ended up touching
+    counter_contact_points,     // manifold points over all contacts
+    counter_shape_tests,        // narrow phase shape tests that ran
+    counter_islands,            // contact islands built
+    counter_sleeping_bodies,    // dynamic bodies asleep at the end of the step
+    counter_bullets,            // bullets fast enough to be swept
+    k_num_counters
+};
+
+struct profile_scope_stats {
+    const char* name;
+    double ms;
+    unsigned int calls;
+};
+
+// everything recorded between two end_frame calls. scope times are
+// summed over threads, so a parallel phase can add up to more than
+// the frame took
+struct frame_stats {
+    unsigned long long frame;
+    double ms;
+
+    std::vector<profile_scope_stats> scopes;
+    unsigned long long counters [ k_num_counters ];
+
+    // zero for a scope that did not run this frame
+    double scope_ms ( const char* name ) const;
+};
+
+// collects scoped timings and counters from every thread and
+// optionally keeps each scope as a chrome trace event, load the
+// written file in chrome://tracing or perfetto. the engine only talks
+// to it through the PROFILE_ macros at the bottom, which compile to
+// nothing unless RIGID_BODY_PROFILE is defined.
+class profiler {
+public:
+    typedef std::chrono::steady_clock clock;
+
+    static profiler& instance ( );
+
+    profiler ( const profiler& ) = delete;
+    profiler& operator= ( const profiler& ) = delete;
+
+    // scope names must be string literals, they are kept by pointer
+    void record ( const char* name,
+                  clock::time_point start,
+                  clock::time_point end );
+
+    void count ( profile_counter counter, unsigned long long amount )
+    {
+        m_counters [ counter ].fetch_add ( amount, std::memory_order_relaxed );
+    }
+
+    void set ( profile_counter counter, unsigned long long value )
+    {
+        m_counters [ counter ].store ( value, std::memory_order_relaxed );
+    }
+
+    // close the current frame and start the next one
+    void end_frame ( );
+
+    const frame_stats& last_frame ( ) const { return m_last; }
+
+    static const char* counter_name ( profile_counter counter );
+
+    // keep up to max_events scopes as trace events from now on
+    void start_trace ( unsigned int max_events = 1000000 );
+    void stop_trace ( );
+    bool tracing ( ) const { return m_tracing.load ( std::memory_order_relaxed ); }
+
+    // returns false if the file could not be written
+    bool write_trace ( const std::string& path ) const;
+
+private:
+
+    profiler ( );
+
+    struct trace_event {
+        const char* name;
+        unsigned int thread;
+        double start_us;
+        double duration_us;
+    };
+
+    struct trace_counters {
+        double time_us;
+        unsigned long long counters [ k_num_counters ];
+    };
+
+    double to_us ( clock::time_point t ) const;
+
+    // small stable number for the calling thread, the trace's tid
+    static unsigned int thread_index ( );
+
+    clock::time_point m_epoch;
+    clock::time_point m_frame_start;
+
+    std::atomic<unsigned long long> m_counters [ k_num_counters ];
+
+    mutable std::mutex m_mutex;
+    frame_stats m_current;
+    frame_stats m_last;
+
+    std::atomic<bool> m_tracing;
+    unsigned int m_max_events;
+    std::vector<trace_event> m_events;
+    std::vector<trace_counters> m_trace_counters;
+};
+
+// times the rest of the enclosing block
+class profile_scope {
+public:
+    explicit profile_scope ( const char* name ) :
+        m_name { name },
+        m_start { profiler::clock::now ( ) }
+    {
+
+    }
+
+    ~profile_scope ( )
+    {
+        profiler::instance ( ).record ( m_name, m_start, profiler::clock::now ( ) );
+    }
+
+    profile_scope ( const profile_scope& ) = delete;
+    profile_scope& operator= ( const profile_scope& ) = delete;
+
+private:
+    const char* m_name;
+    profiler::clock::time_point m_start;
+};
+
+#ifdef RIGID_BODY_PROFILE
+
+#define PROFILE_JOIN2( a, b ) a##b
+#define PROFILE_JOIN( a, b ) PROFILE_JOIN2 ( a, b )
+
+#define PROFILE_SCOPE( name ) profile_scope PROFILE_JOIN ( profile_scope_, __LINE__ ) { name }
+#define PROFILE_COUNT( counter, amount ) profiler::instance ( ).count ( counter, amount )
+#define PROFILE_SET( counter, value ) profiler::instance ( ).set ( counter, value )
+#define PROFILE_END_FRAME( ) profiler::instance ( ).end_frame ( )
+
+#else
+
+#define PROFILE_SCOPE( name ) do { } while ( 0 )
+#define PROFILE_COUNT( counter, amount ) do { } while ( 0 )
+#define PROFILE_SET( counter, value ) do { } while ( 0 )
+#define PROFILE_END_FRAME( ) do { } while ( 0 )
+
+#endif
+
+#endif
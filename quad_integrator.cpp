@@ -0,0 +1,599 @@
+#include "quad_integrator.hpp"
+
+#include "fast_math.hpp"
+#include "quad_world.hpp"
+
+#if defined ( __x86_64__ ) || defined ( __i386__ )
+#define QUAD_INTEGRATOR_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    struct integrate_streams {
+        float* center_x;
+        float* center_y;
+        float* rotation;
+        float* velocity_x;
+        float* velocity_y;
+        float* angular_velocity;
+        float* force_x;
+        float* force_y;
+        float* torque;
+        const float* inv_mass;
+        const float* inv_inertia;
+    };
+
+    struct corner_streams {
+        const float* center_x;
+        const float* center_y;
+        const float* rotation;
+        const float* previous_x;
+        const float* previous_y;
+        const float* previous_rotation;
+        const float* half_width;
+        const float* half_height;
+        float* sin_rotation;
+        float* cos_rotation;
+        float* corner_x [ rigid_quad_2d::k_num_corners ];
+        float* corner_y [ rigid_quad_2d::k_num_corners ];
+    };
+
+    // corner signs in the same winding as rigid_quad_2d
+    const float k_sign_x [ rigid_quad_2d::k_num_corners ] = { -1.0f, 1.0f, 1.0f, -1.0f };
+    const float k_sign_y [ rigid_quad_2d::k_num_corners ] = { -1.0f, -1.0f, 1.0f, 1.0f };
+
+    integrate_streams gather_integrate ( quad_world& world )
+    {
+        integrate_streams s;
+
+        s.center_x = world.data ( quad_world::s_center_x );
+        s.center_y = world.data ( quad_world::s_center_y );
+        s.rotation = world.data ( quad_world::s_rotation );
+        s.velocity_x = world.data ( quad_world::s_velocity_x );
+        s.velocity_y = world.data ( quad_world::s_velocity_y );
+        s.angular_velocity = world.data ( quad_world::s_angular_velocity );
+        s.force_x = world.data ( quad_world::s_force_x );
+        s.force_y = world.data ( quad_world::s_force_y );
+        s.torque = world.data ( quad_world::s_torque );
+        s.inv_mass = world.data ( quad_world::s_inv_mass );
+        s.inv_inertia = world.data ( quad_world::s_inv_inertia );
+
+        return s;
+    }
+
+    corner_streams gather_corners ( quad_world& world )
+    {
+        corner_streams s;
+
+        s.center_x = world.data ( quad_world::s_center_x );
+        s.center_y = world.data ( quad_world::s_center_y );
+        s.rotation = world.data ( quad_world::s_rotation );
+        s.previous_x = world.data ( quad_world::s_previous_x );
+        s.previous_y = world.data ( quad_world::s_previous_y );
+        s.previous_rotation = world.data ( quad_world::s_previous_rotation );
+        s.half_width = world.data ( quad_world::s_half_width );
+        s.half_height = world.data ( quad_world::s_half_height );
+        s.sin_rotation = world.data ( quad_world::s_sin_rotation );
+        s.cos_rotation = world.data ( quad_world::s_cos_rotation );
+
+        for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+            s.corner_x [ c ] = world.corner_x ( c );
+            s.corner_y [ c ] = world.corner_y ( c );
+        }
+
+        return s;
+    }
+
+    void integrate_scalar ( const integrate_streams& s,
+                            unsigned int first,
+                            unsigned int last,
+                            float dt,
+                            float friction )
+    {
+        for ( unsigned int i = first; i < last; ++i ) {
+            // F = ma, a = dv/dt, v = dc/dt, c = c0 + F / m * dt ^ 2
+            s.center_x [ i ] += s.velocity_x [ i ] * dt;
+            s.center_y [ i ] += s.velocity_y [ i ] * dt;
+            s.velocity_x [ i ] = ( s.force_x [ i ] * s.inv_mass [ i ] ) * dt;
+            s.velocity_y [ i ] = ( s.force_y [ i ] * s.inv_mass [ i ] ) * dt;
+
+            // T = wI, w = do/dt, o = dr/dt, r = r0 + T / I * dt ^ 2
+            s.rotation [ i ] += s.angular_velocity [ i ] * dt;
+            s.angular_velocity [ i ] = ( s.torque [ i ] * s.inv_inertia [ i ] ) * dt;
+
+            // reduce forces due to friction
+            s.force_x [ i ] -= ( s.force_x [ i ] * friction );
+            s.force_y [ i ] -= ( s.force_y [ i ] * friction );
+            s.torque [ i ] -= ( s.torque [ i ] * friction );
+        }
+    }
+
+    // rotate the local corners of body i and offset them by the center
+    inline void pose_scalar ( const corner_streams& s, unsigned int i )
+    {
+        float sin_rot = s.sin_rotation [ i ];
+        float cos_rot = s.cos_rotation [ i ];
+
+        for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+            float local_x = s.half_width [ i ] * k_sign_x [ c ];
+            float local_y = s.half_height [ i ] * k_sign_y [ c ];
+
+            s.corner_x [ c ][ i ] = ( local_x * cos_rot - local_y * sin_rot ) + s.center_x [ i ];
+            s.corner_y [ c ][ i ] = ( local_y * cos_rot + local_x * sin_rot ) + s.center_y [ i ];
+        }
+    }
+
+    void corners_scalar ( const corner_streams& s,
+                          unsigned int first,
+                          unsigned int last )
+    {
+        for ( unsigned int i = first; i < last; ++i ) {
+            fast_math::sincos ( s.rotation [ i ], s.sin_rotation [ i ], s.cos_rotation [ i ] );
+            pose_scalar ( s, i );
+        }
+    }
+
+    void moved_corners_scalar ( const corner_streams& s,
+                                unsigned int first,
+                                unsigned int last )
+    {
+        for ( unsigned int i = first; i < last; ++i ) {
+            bool turned = s.rotation [ i ] != s.previous_rotation [ i ];
+
+            if ( !turned && s.center_x [ i ] == s.previous_x [ i ] && s.center_y [ i ] == s.previous_y [ i ] ) {
+                continue;
+            }
+
+            if ( turned ) {
+                fast_math::sincos ( s.rotation [ i ], s.sin_rotation [ i ], s.cos_rotation [ i ] );
+            }
+
+            pose_scalar ( s, i );
+        }
+    }
+
+#ifdef QUAD_INTEGRATOR_X86
+
+    // 4 wide version of fast_math::sincos
+    inline void sincos_sse ( __m128 x, __m128& s, __m128& c )
+    {
+        const __m128 sign_mask = _mm_set1_ps ( -0.0f );
+        const __m128i two = _mm_set1_epi32 ( 2 );
+        const __m128i four = _mm_set1_epi32 ( 4 );
+
+        __m128 sign_sin = _mm_and_ps ( x, sign_mask );
+        x = _mm_andnot_ps ( sign_mask, x );
+
+        __m128i j = _mm_cvttps_epi32 ( _mm_mul_ps ( x, _mm_set1_ps ( fast_math::k_four_over_pi ) ) );
+        j = _mm_add_epi32 ( j, _mm_set1_epi32 ( 1 ) );
+        j = _mm_and_si128 ( j, _mm_set1_epi32 ( ~1 ) );
+        __m128 y = _mm_cvtepi32_ps ( j );
+
+        __m128 swap_sin = _mm_castsi128_ps ( _mm_slli_epi32 ( _mm_and_si128 ( j, four ), 29 ) );
+        __m128 sign_cos = _mm_castsi128_ps ( _mm_slli_epi32 ( _mm_andnot_si128 ( _mm_sub_epi32 ( j, two ), four ), 29 ) );
+        __m128 poly_mask = _mm_castsi128_ps ( _mm_cmpeq_epi32 ( _mm_and_si128 ( j, two ), _mm_setzero_si128 ( ) ) );
+
+        sign_sin = _mm_xor_ps ( sign_sin, swap_sin );
+
+        x = _mm_sub_ps ( x, _mm_mul_ps ( y, _mm_set1_ps ( fast_math::k_dp1 ) ) );
+        x = _mm_sub_ps ( x, _mm_mul_ps ( y, _mm_set1_ps ( fast_math::k_dp2 ) ) );
+        x = _mm_sub_ps ( x, _mm_mul_ps ( y, _mm_set1_ps ( fast_math::k_dp3 ) ) );
+
+        __m128 z = _mm_mul_ps ( x, x );
+
+        __m128 pc = _mm_set1_ps ( fast_math::k_cos_p0 );
+        pc = _mm_add_ps ( _mm_mul_ps ( pc, z ), _mm_set1_ps ( fast_math::k_cos_p1 ) );
+        pc = _mm_add_ps ( _mm_mul_ps ( pc, z ), _mm_set1_ps ( fast_math::k_cos_p2 ) );
+        pc = _mm_mul_ps ( pc, z );
+        pc = _mm_mul_ps ( pc, z );
+        pc = _mm_sub_ps ( pc, _mm_mul_ps ( z, _mm_set1_ps ( 0.5f ) ) );
+        pc = _mm_add_ps ( pc, _mm_set1_ps ( 1.0f ) );
+
+        __m128 ps = _mm_set1_ps ( fast_math::k_sin_p0 );
+        ps = _mm_add_ps ( _mm_mul_ps ( ps, z ), _mm_set1_ps ( fast_math::k_sin_p1 ) );
+        ps = _mm_add_ps ( _mm_mul_ps ( ps, z ), _mm_set1_ps ( fast_math::k_sin_p2 ) );
+        ps = _mm_mul_ps ( ps, z );
+        ps = _mm_mul_ps ( ps, x );
+        ps = _mm_add_ps ( ps, x );
+
+        __m128 sin_poly = _mm_or_ps ( _mm_and_ps ( poly_mask, ps ), _mm_andnot_ps ( poly_mask, pc ) );
+        __m128 cos_poly = _mm_or_ps ( _mm_and_ps ( poly_mask, pc ), _mm_andnot_ps ( poly_mask, ps ) );
+
+        s = _mm_xor_ps ( sin_poly, sign_sin );
+        c = _mm_xor_ps ( cos_poly, sign_cos );
+    }
+
+    void integrate_sse ( const integrate_streams& s,
+                         unsigned int first,
+                         unsigned int last,
+                         float dt,
+                         float friction )
+    {
+        const __m128 vdt = _mm_set1_ps ( dt );
+        const __m128 vfriction = _mm_set1_ps ( friction );
+
+        unsigned int i = first;
+
+        for ( ; i + 4 <= last; i += 4 ) {
+            __m128 vx = _mm_loadu_ps ( s.velocity_x + i );
+            __m128 vy = _mm_loadu_ps ( s.velocity_y + i );
+            __m128 w = _mm_loadu_ps ( s.angular_velocity + i );
+            __m128 fx = _mm_loadu_ps ( s.force_x + i );
+            __m128 fy = _mm_loadu_ps ( s.force_y + i );
+            __m128 t = _mm_loadu_ps ( s.torque + i );
+            __m128 im = _mm_loadu_ps ( s.inv_mass + i );
+            __m128 ii = _mm_loadu_ps ( s.inv_inertia + i );
+
+            _mm_storeu_ps ( s.center_x + i, _mm_add_ps ( _mm_loadu_ps ( s.center_x + i ), _mm_mul_ps ( vx, vdt ) ) );
+            _mm_storeu_ps ( s.center_y + i, _mm_add_ps ( _mm_loadu_ps ( s.center_y + i ), _mm_mul_ps ( vy, vdt ) ) );
+            _mm_storeu_ps ( s.rotation + i, _mm_add_ps ( _mm_loadu_ps ( s.rotation + i ), _mm_mul_ps ( w, vdt ) ) );
+
+            _mm_storeu_ps ( s.velocity_x + i, _mm_mul_ps ( _mm_mul_ps ( fx, im ), vdt ) );
+            _mm_storeu_ps ( s.velocity_y + i, _mm_mul_ps ( _mm_mul_ps ( fy, im ), vdt ) );
+            _mm_storeu_ps ( s.angular_velocity + i, _mm_mul_ps ( _mm_mul_ps ( t, ii ), vdt ) );
+
+            _mm_storeu_ps ( s.force_x + i, _mm_sub_ps ( fx, _mm_mul_ps ( fx, vfriction ) ) );
+            _mm_storeu_ps ( s.force_y + i, _mm_sub_ps ( fy, _mm_mul_ps ( fy, vfriction ) ) );
+            _mm_storeu_ps ( s.torque + i, _mm_sub_ps ( t, _mm_mul_ps ( t, vfriction ) ) );
+        }
+
+        integrate_scalar ( s, i, last, dt, friction );
+    }
+
+    inline void pose_sse ( const corner_streams& s, unsigned int i, __m128 sin_rot, __m128 cos_rot )
+    {
+        __m128 cx = _mm_loadu_ps ( s.center_x + i );
+        __m128 cy = _mm_loadu_ps ( s.center_y + i );
+        __m128 hw = _mm_loadu_ps ( s.half_width + i );
+        __m128 hh = _mm_loadu_ps ( s.half_height + i );
+
+        for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+            __m128 local_x = _mm_mul_ps ( hw, _mm_set1_ps ( k_sign_x [ c ] ) );
+            __m128 local_y = _mm_mul_ps ( hh, _mm_set1_ps ( k_sign_y [ c ] ) );
+
+            __m128 rot_x = _mm_sub_ps ( _mm_mul_ps ( local_x, cos_rot ), _mm_mul_ps ( local_y, sin_rot ) );
+            __m128 rot_y = _mm_add_ps ( _mm_mul_ps ( local_y, cos_rot ), _mm_mul_ps ( local_x, sin_rot ) );
+
+            _mm_storeu_ps ( s.corner_x [ c ] + i, _mm_add_ps ( rot_x, cx ) );
+            _mm_storeu_ps ( s.corner_y [ c ] + i, _mm_add_ps ( rot_y, cy ) );
+        }
+    }
+
+    void corners_sse ( const corner_streams& s,
+                       unsigned int first,
+                       unsigned int last )
+    {
+        unsigned int i = first;
+
+        for ( ; i + 4 <= last; i += 4 ) {
+            __m128 sin_rot;
+            __m128 cos_rot;
+
+            sincos_sse ( _mm_loadu_ps ( s.rotation + i ), sin_rot, cos_rot );
+
+            _mm_storeu_ps ( s.sin_rotation + i, sin_rot );
+            _mm_storeu_ps ( s.cos_rotation + i, cos_rot );
+
+            pose_sse ( s, i, sin_rot, cos_rot );
+        }
+
+        corners_scalar ( s, i, last );
+    }
+
+    // four bodies at a time, all four are skipped or posed together.
+    // posing one that did not move gives the corners it already has
+    void moved_corners_sse ( const corner_streams& s,
+                             unsigned int first,
+                             unsigned int last )
+    {
+        unsigned int i = first;
+
+        for ( ; i + 4 <= last; i += 4 ) {
+            __m128 rotation = _mm_loadu_ps ( s.rotation + i );
+
+            int turned = _mm_movemask_ps ( _mm_cmpneq_ps ( rotation, _mm_loadu_ps ( s.previous_rotation + i ) ) );
+            int moved = turned |
+                        _mm_movemask_ps ( _mm_cmpneq_ps ( _mm_loadu_ps ( s.center_x + i ), _mm_loadu_ps ( s.previous_x + i ) ) ) |
+                        _mm_movemask_ps ( _mm_cmpneq_ps ( _mm_loadu_ps ( s.center_y + i ), _mm_loadu_ps ( s.previous_y + i ) ) );
+
+            if ( !moved ) {
+                continue;
+            }
+
+            __m128 sin_rot;
+            __m128 cos_rot;
+
+            if ( turned ) {
+                sincos_sse ( rotation, sin_rot, cos_rot );
+
+                _mm_storeu_ps ( s.sin_rotation + i, sin_rot );
+                _mm_storeu_ps ( s.cos_rotation + i, cos_rot );
+            } else {
+                sin_rot = _mm_loadu_ps ( s.sin_rotation + i );
+                cos_rot = _mm_loadu_ps ( s.cos_rotation + i );
+            }
+
+            pose_sse ( s, i, sin_rot, cos_rot );
+        }
+
+        moved_corners_scalar ( s, i, last );
+    }
+
+    // 8 wide version of fast_math::sincos
+    __attribute__ ( ( target ( "avx2" ) ) )
+    inline void sincos_avx2 ( __m256 x, __m256& s, __m256& c )
+    {
+        const __m256 sign_mask = _mm256_set1_ps ( -0.0f );
+        const __m256i two = _mm256_set1_epi32 ( 2 );
+        const __m256i four = _mm256_set1_epi32 ( 4 );
+
+        __m256 sign_sin = _mm256_and_ps ( x, sign_mask );
+        x = _mm256_andnot_ps ( sign_mask, x );
+
+        __m256i j = _mm256_cvttps_epi32 ( _mm256_mul_ps ( x, _mm256_set1_ps ( fast_math::k_four_over_pi ) ) );
+        j = _mm256_add_epi32 ( j, _mm256_set1_epi32 ( 1 ) );
+        j = _mm256_and_si256 ( j, _mm256_set1_epi32 ( ~1 ) );
+        __m256 y = _mm256_cvtepi32_ps ( j );
+
+        __m256 swap_sin = _mm256_castsi256_ps ( _mm256_slli_epi32 ( _mm256_and_si256 ( j, four ), 29 ) );
+        __m256 sign_cos = _mm256_castsi256_ps ( _mm256_slli_epi32 ( _mm256_andnot_si256 ( _mm256_sub_epi32 ( j, two ), four ), 29 ) );
+        __m256 poly_mask = _mm256_castsi256_ps ( _mm256_cmpeq_epi32 ( _mm256_and_si256 ( j, two ), _mm256_setzero_si256 ( ) ) );
+
+        sign_sin = _mm256_xor_ps ( sign_sin, swap_sin );
+
+        x = _mm256_sub_ps ( x, _mm256_mul_ps ( y, _mm256_set1_ps ( fast_math::k_dp1 ) ) );
+        x = _mm256_sub_ps ( x, _mm256_mul_ps ( y, _mm256_set1_ps ( fast_math::k_dp2 ) ) );
+        x = _mm256_sub_ps ( x, _mm256_mul_ps ( y, _mm256_set1_ps ( fast_math::k_dp3 ) ) );
+
+        __m256 z = _mm256_mul_ps ( x, x );
+
+        __m256 pc = _mm256_set1_ps ( fast_math::k_cos_p0 );
+        pc = _mm256_add_ps ( _mm256_mul_ps ( pc, z ), _mm256_set1_ps ( fast_math::k_cos_p1 ) );
+        pc = _mm256_add_ps ( _mm256_mul_ps ( pc, z ), _mm256_set1_ps ( fast_math::k_cos_p2 ) );
+        pc = _mm256_mul_ps ( pc, z );
+        pc = _mm256_mul_ps ( pc, z );
+        pc = _mm256_sub_ps ( pc, _mm256_mul_ps ( z, _mm256_set1_ps ( 0.5f ) ) );
+        pc = _mm256_add_ps ( pc, _mm256_set1_ps ( 1.0f ) );
+
+        __m256 ps = _mm256_set1_ps ( fast_math::k_sin_p0 );
+        ps = _mm256_add_ps ( _mm256_mul_ps ( ps, z ), _mm256_set1_ps ( fast_math::k_sin_p1 ) );
+        ps = _mm256_add_ps ( _mm256_mul_ps ( ps, z ), _mm256_set1_ps ( fast_math::k_sin_p2 ) );
+        ps = _mm256_mul_ps ( ps, z );
+        ps = _mm256_mul_ps ( ps, x );
+        ps = _mm256_add_ps ( ps, x );
+
+        __m256 sin_poly = _mm256_blendv_ps ( pc, ps, poly_mask );
+        __m256 cos_poly = _mm256_blendv_ps ( ps, pc, poly_mask );
+
+        s = _mm256_xor_ps ( sin_poly, sign_sin );
+        c = _mm256_xor_ps ( cos_poly, sign_cos );
+    }
+
+    __attribute__ ( ( target ( "avx2" ) ) )
+    void integrate_avx2 ( const integrate_streams& s,
+                          unsigned int first,
+                          unsigned int last,
+                          float dt,
+                          float friction )
+    {
+        const __m256 vdt = _mm256_set1_ps ( dt );
+        const __m256 vfriction = _mm256_set1_ps ( friction );
+
+        unsigned int i = first;
+
+        for ( ; i + 8 <= last; i += 8 ) {
+            __m256 vx = _mm256_loadu_ps ( s.velocity_x + i );
+            __m256 vy = _mm256_loadu_ps ( s.velocity_y + i );
+            __m256 w = _mm256_loadu_ps ( s.angular_velocity + i );
+            __m256 fx = _mm256_loadu_ps ( s.force_x + i );
+            __m256 fy = _mm256_loadu_ps ( s.force_y + i );
+            __m256 t = _mm256_loadu_ps ( s.torque + i );
+            __m256 im = _mm256_loadu_ps ( s.inv_mass + i );
+            __m256 ii = _mm256_loadu_ps ( s.inv_inertia + i );
+
+            _mm256_storeu_ps ( s.center_x + i, _mm256_add_ps ( _mm256_loadu_ps ( s.center_x + i ), _mm256_mul_ps ( vx, vdt ) ) );
+            _mm256_storeu_ps ( s.center_y + i, _mm256_add_ps ( _mm256_loadu_ps ( s.center_y + i ), _mm256_mul_ps ( vy, vdt ) ) );
+            _mm256_storeu_ps ( s.rotation + i, _mm256_add_ps ( _mm256_loadu_ps ( s.rotation + i ), _mm256_mul_ps ( w, vdt ) ) );
+
+            _mm256_storeu_ps ( s.velocity_x + i, _mm256_mul_ps ( _mm256_mul_ps ( fx, im ), vdt ) );
+            _mm256_storeu_ps ( s.velocity_y + i, _mm256_mul_ps ( _mm256_mul_ps ( fy, im ), vdt ) );
+            _mm256_storeu_ps ( s.angular_velocity + i, _mm256_mul_ps ( _mm256_mul_ps ( t, ii ), vdt ) );
+
+            _mm256_storeu_ps ( s.force_x + i, _mm256_sub_ps ( fx, _mm256_mul_ps ( fx, vfriction ) ) );
+            _mm256_storeu_ps ( s.force_y + i, _mm256_sub_ps ( fy, _mm256_mul_ps ( fy, vfriction ) ) );
+            _mm256_storeu_ps ( s.torque + i, _mm256_sub_ps ( t, _mm256_mul_ps ( t, vfriction ) ) );
+        }
+
+        integrate_sse ( s, i, last, dt, friction );
+    }
+
+    __attribute__ ( ( target ( "avx2" ) ) )
+    inline void pose_avx2 ( const corner_streams& s, unsigned int i, __m256 sin_rot, __m256 cos_rot )
+    {
+        __m256 cx = _mm256_loadu_ps ( s.center_x + i );
+        __m256 cy = _mm256_loadu_ps ( s.center_y + i );
+        __m256 hw = _mm256_loadu_ps ( s.half_width + i );
+        __m256 hh = _mm256_loadu_ps ( s.half_height + i );
+
+        for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+            __m256 local_x = _mm256_mul_ps ( hw, _mm256_set1_ps ( k_sign_x [ c ] ) );
+            __m256 local_y = _mm256_mul_ps ( hh, _mm256_set1_ps ( k_sign_y [ c ] ) );
+
+            __m256 rot_x = _mm256_sub_ps ( _mm256_mul_ps ( local_x, cos_rot ), _mm256_mul_ps ( local_y, sin_rot ) );
+            __m256 rot_y = _mm256_add_ps ( _mm256_mul_ps ( local_y, cos_rot ), _mm256_mul_ps ( local_x, sin_rot ) );
+
+            _mm256_storeu_ps ( s.corner_x [ c ] + i, _mm256_add_ps ( rot_x, cx ) );
+            _mm256_storeu_ps ( s.corner_y [ c ] + i, _mm256_add_ps ( rot_y, cy ) );
+        }
+    }
+
+    __attribute__ ( ( target ( "avx2" ) ) )
+    void corners_avx2 ( const corner_streams& s,
+                        unsigned int first,
+                        unsigned int last )
+    {
+        unsigned int i = first;
+
+        for ( ; i + 8 <= last; i += 8 ) {
+            __m256 sin_rot;
+            __m256 cos_rot;
+
+            sincos_avx2 ( _mm256_loadu_ps ( s.rotation + i ), sin_rot, cos_rot );
+
+            _mm256_storeu_ps ( s.sin_rotation + i, sin_rot );
+            _mm256_storeu_ps ( s.cos_rotation + i, cos_rot );
+
+            pose_avx2 ( s, i, sin_rot, cos_rot );
+        }
+
+        corners_sse ( s, i, last );
+    }
+
+    __attribute__ ( ( target ( "avx2" ) ) )
+    void moved_corners_avx2 ( const corner_streams& s,
+                              unsigned int first,
+                              unsigned int last )
+    {
+        unsigned int i = first;
+
+        for ( ; i + 8 <= last; i += 8 ) {
+            __m256 rotation = _mm256_loadu_ps ( s.rotation + i );
+
+            int turned = _mm256_movemask_ps ( _mm256_cmp_ps ( rotation, _mm256_loadu_ps ( s.previous_rotation + i ), _CMP_NEQ_UQ ) );
+            int moved = turned |
+                        _mm256_movemask_ps ( _mm256_cmp_ps ( _mm256_loadu_ps ( s.center_x + i ), _mm256_loadu_ps ( s.previous_x + i ), _CMP_NEQ_UQ ) ) |
+                        _mm256_movemask_ps ( _mm256_cmp_ps ( _mm256_loadu_ps ( s.center_y + i ), _mm256_loadu_ps ( s.previous_y + i ), _CMP_NEQ_UQ ) );
+
+            if ( !moved ) {
+                continue;
+            }
+
+            __m256 sin_rot;
+            __m256 cos_rot;
+
+            if ( turned ) {
+                sincos_avx2 ( rotation, sin_rot, cos_rot );
+
+                _mm256_storeu_ps ( s.sin_rotation + i, sin_rot );
+                _mm256_storeu_ps ( s.cos_rotation + i, cos_rot );
+            } else {
+                sin_rot = _mm256_loadu_ps ( s.sin_rotation + i );
+                cos_rot = _mm256_loadu_ps ( s.cos_rotation + i );
+            }
+
+            pose_avx2 ( s, i, sin_rot, cos_rot );
+        }
+
+        moved_corners_sse ( s, i, last );
+    }
+
+#endif
+
+}
+
+quad_integrator::quad_integrator ( ) :
+    m_level { supported_level ( ) }
+{
+
+}
+
+quad_integrator::quad_integrator ( simd_level level ) :
+    m_level { level }
+{
+    if ( m_level > supported_level ( ) ) {
+        m_level = supported_level ( );
+    }
+}
+
+void quad_integrator::integrate ( quad_world& world,
+                                  unsigned int first,
+                                  unsigned int last,
+                                  float dt,
+                                  float friction ) const
+{
+    integrate_streams s = gather_integrate ( world );
+
+    switch ( m_level ) {
+#ifdef QUAD_INTEGRATOR_X86
+        case simd_avx2:
+            integrate_avx2 ( s, first, last, dt, friction );
+            break;
+        case simd_sse:
+            integrate_sse ( s, first, last, dt, friction );
+            break;
+#endif
+        default:
+            integrate_scalar ( s, first, last, dt, friction );
+            break;
+    }
+}
+
+void quad_integrator::transform_corners ( quad_world& world,
+                                          unsigned int first,
+                                          unsigned int last ) const
+{
+    corner_streams s = gather_corners ( world );
+
+    switch ( m_level ) {
+#ifdef QUAD_INTEGRATOR_X86
+        case simd_avx2:
+            corners_avx2 ( s, first, last );
+            break;
+        case simd_sse:
+            corners_sse ( s, first, last );
+            break;
+#endif
+        default:
+            corners_scalar ( s, first, last );
+            break;
+    }
+}
+
+void quad_integrator::transform_moved_corners ( quad_world& world,
+                                                unsigned int first,
+                                                unsigned int last ) const
+{
+    corner_streams s = gather_corners ( world );
+
+    switch ( m_level ) {
+#ifdef QUAD_INTEGRATOR_X86
+        case simd_avx2:
+            moved_corners_avx2 ( s, first, last );
+            break;
+        case simd_sse:
+            moved_corners_sse ( s, first, last );
+            break;
+#endif
+        default:
+            moved_corners_scalar ( s, first, last );
+            break;
+    }
+}
+
+simd_level quad_integrator::supported_level ( )
+{
+#ifdef QUAD_INTEGRATOR_X86
+    if ( __builtin_cpu_supports ( "avx2" ) ) {
+        return simd_avx2;
+    }
+
+    if ( __builtin_cpu_supports ( "sse2" ) ) {
+        return simd_sse;
+    }
+#endif
+
+    return simd_scalar;
+}
+
+const char* quad_integrator::name ( simd_level level )
+{
+    switch ( level ) {
+        case simd_avx2:
+            return "avx2";
+        case simd_sse:
+            return "sse";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef QUAD_INTEGRATOR
+#define QUAD_INTEGRATOR
+
+class quad_world;
+
+enum simd_level {
+    simd_scalar,
+    simd_sse,
+    simd_avx2
+};
+
+// advances a range of bodies in a quad_world at once. the sse and avx2
+// paths process 4 and 8 bodies per iteration, the tail of the range
+// falls back to narrower paths. every path runs the same operations in
+// the same order so they agree bit for bit.
+class quad_integrator {
+public:
+    // picks the widest path the cpu supports
+    quad_integrator ( );
+
+    // asking for a path the cpu lacks drops down to one it has
+    explicit quad_integrator ( simd_level level );
+
+    // integrate position and rotation, derive the new velocities from
+    // the accumulated force and torque and decay those with friction
+    void integrate ( quad_world& world,
+                     unsigned int first,
+                     unsigned int last,
+                     float dt,
+                     float friction ) const;
+
+    // rotate the local corners of each body and offset by its center,
+    // keeping the sine and cosine of the rotation
+    void transform_corners ( quad_world& world,
+                             unsigned int first,
+                             unsigned int last ) const;
+
+    // the same for only the bodies that moved from their previous pose,
+    // the corners of the others are already posed there. a body that
+    // moved without turning reuses the kept sine and cosine
+    void transform_moved_corners ( quad_world& world,
+                                   unsigned int first,
+                                   unsigned int last ) const;
+
+    simd_level level ( ) const { return m_level; }
+
+    static simd_level supported_level ( );
+    static const char* name ( simd_level level );
+
+private:
+
+    simd_level m_level;
+};
+
+#endif
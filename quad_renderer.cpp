@@ -0,0 +1,575 @@
+#include "quad_renderer.hpp"
+
+#include <cstring>
+#include <iostream>
+
+#include <SDL2/SDL.h>
+
+namespace {
+
+    // the entry points past opengl 1.1, loaded once a context exists
+    struct gl_functions {
+        PFNGLCREATESHADERPROC create_shader;
+        PFNGLSHADERSOURCEPROC shader_source;
+        PFNGLCOMPILESHADERPROC compile_shader;
+        PFNGLGETSHADERIVPROC get_shader_iv;
+        PFNGLGETSHADERINFOLOGPROC get_shader_info_log;
+        PFNGLDELETESHADERPROC delete_shader;
+        PFNGLCREATEPROGRAMPROC create_program;
+        PFNGLATTACHSHADERPROC attach_shader;
+        PFNGLBINDATTRIBLOCATIONPROC bind_attrib_location;
+        PFNGLLINKPROGRAMPROC link_program;
+        PFNGLGETPROGRAMIVPROC get_program_iv;
+        PFNGLGETPROGRAMINFOLOGPROC get_program_info_log;
+        PFNGLDELETEPROGRAMPROC delete_program;
+        PFNGLUSEPROGRAMPROC use_program;
+        PFNGLGETUNIFORMLOCATIONPROC get_uniform_location;
+        PFNGLUNIFORM1FPROC uniform_1f;
+        PFNGLUNIFORM3FPROC uniform_3f;
+        PFNGLUNIFORM1IPROC uniform_1i;
+        PFNGLGENVERTEXARRAYSPROC gen_vertex_arrays;
+        PFNGLBINDVERTEXARRAYPROC bind_vertex_array;
+        PFNGLDELETEVERTEXARRAYSPROC delete_vertex_arrays;
+        PFNGLGENBUFFERSPROC gen_buffers;
+        PFNGLBINDBUFFERPROC bind_buffer;
+        PFNGLDELETEBUFFERSPROC delete_buffers;
+        PFNGLBUFFERDATAPROC buffer_data;
+        PFNGLTEXBUFFERPROC tex_buffer;
+        PFNGLACTIVETEXTUREPROC active_texture;
+        PFNGLBUFFERSTORAGEPROC buffer_storage;
+        PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+        PFNGLUNMAPBUFFERPROC unmap_buffer;
+        PFNGLVERTEXATTRIBPOINTERPROC vertex_attrib_pointer;
+        PFNGLENABLEVERTEXATTRIBARRAYPROC enable_vertex_attrib_array;
+        PFNGLVERTEXATTRIBDIVISORPROC vertex_attrib_divisor;
+        PFNGLDRAWARRAYSINSTANCEDBASEINSTANCEPROC draw_arrays_instanced_base_instance;
+        PFNGLFENCESYNCPROC fence_sync;
+        PFNGLCLIENTWAITSYNCPROC client_wait_sync;
+        PFNGLDELETESYNCPROC delete_sync;
+    };
+
+    gl_functions gl;
+
+    template<typename Function>
+    bool load ( Function& f, const char* name )
+    {
+        f = reinterpret_cast<Function> ( SDL_GL_GetProcAddress ( name ) );
+
+        return f != nullptr;
+    }
+
+    bool load_functions ( )
+    {
+        return load ( gl.create_shader, "glCreateShader" ) &&
+               load ( gl.shader_source, "glShaderSource" ) &&
+               load ( gl.compile_shader, "glCompileShader" ) &&
+               load ( gl.get_shader_iv, "glGetShaderiv" ) &&
+               load ( gl.get_shader_info_log, "glGetShaderInfoLog" ) &&
+               load ( gl.delete_shader, "glDeleteShader" ) &&
+               load ( gl.create_program, "glCreateProgram" ) &&
+               load ( gl.attach_shader, "glAttachShader" ) &&
+               load ( gl.bind_attrib_location, "glBindAttribLocation" ) &&
+               load ( gl.link_program, "glLinkProgram" ) &&
+               load ( gl.get_program_iv, "glGetProgramiv" ) &&
+               load ( gl.get_program_info_log, "glGetProgramInfoLog" ) &&
+               load ( gl.delete_program, "glDeleteProgram" ) &&
+               load ( gl.use_program, "glUseProgram" ) &&
+               load ( gl.get_uniform_location, "glGetUniformLocation" ) &&
+               load ( gl.uniform_1f, "glUniform1f" ) &&
+               load ( gl.uniform_3f, "glUniform3f" ) &&
+               load ( gl.uniform_1i, "glUniform1i" ) &&
+               load ( gl.gen_vertex_arrays, "glGenVertexArrays" ) &&
+               load ( gl.bind_vertex_array, "glBindVertexArray" ) &&
+               load ( gl.delete_vertex_arrays, "glDeleteVertexArrays" ) &&
+               load ( gl.gen_buffers, "glGenBuffers" ) &&
+               load ( gl.bind_buffer, "glBindBuffer" ) &&
+               load ( gl.delete_buffers, "glDeleteBuffers" ) &&
+               load ( gl.buffer_data, "glBufferData" ) &&
+               load ( gl.tex_buffer, "glTexBuffer" ) &&
+               load ( gl.active_texture, "glActiveTexture" ) &&
+               load ( gl.buffer_storage, "glBufferStorage" ) &&
+               load ( gl.map_buffer_range, "glMapBufferRange" ) &&
+               load ( gl.unmap_buffer, "glUnmapBuffer" ) &&
+               load ( gl.vertex_attrib_pointer, "glVertexAttribPointer" ) &&
+               load ( gl.enable_vertex_attrib_array, "glEnableVertexAttribArray" ) &&
+               load ( gl.vertex_attrib_divisor, "glVertexAttribDivisor" ) &&
+               load ( gl.draw_arrays_instanced_base_instance, "glDrawArraysInstancedBaseInstance" ) &&
+               load ( gl.fence_sync, "glFenceSync" ) &&
+               load ( gl.client_wait_sync, "glClientWaitSync" ) &&
+               load ( gl.delete_sync, "glDeleteSync" );
+    }
+
+    // the shader spells these out
+    static_assert ( shape_circle == 1 && shape_polygon == 2, "shape kinds as the shader numbers them" );
+    static_assert ( convex_polygon::k_max_vertices == 8, "texels per polygon in the shader" );
+    static_assert ( quad_renderer::k_outline_vertices == 16, "outline length in the shader" );
+
+    // outline vertex gl_VertexID of instance gl_InstanceID posed between
+    // the two steps, box corners in the same winding as quad_world's
+    // cached corners. compatibility so the app's fixed function
+    // projection still applies
+    const char* const k_vertex_shader =
+        "#version 150 compatibility\n"
+        "in float previous_x;\n"
+        "in float previous_y;\n"
+        "in float previous_rotation;\n"
+        "in float center_x;\n"
+        "in float center_y;\n"
+        "in float rotation;\n"
+        "in float half_width;\n"
+        "in float half_height;\n"
+        "in float shape;\n"
+        "in float polygon;\n"
+        "uniform float alpha;\n"
+        "uniform samplerBuffer polygons;\n"
+        "void main ( )\n"
+        "{\n"
+        "    vec2 center = mix ( vec2 ( previous_x, previous_y ), vec2 ( center_x, center_y ), alpha );\n"
+        "    float angle = mix ( previous_rotation, rotation, alpha );\n"
+        "    float s = sin ( angle );\n"
+        "    float c = cos ( angle );\n"
+        "    vec2 extent;\n"
+        "    if ( shape == 1.0 ) {\n"
+        "        float a = 6.28318531 * float ( gl_VertexID ) / 16.0;\n"
+        "        extent = half_width * vec2 ( cos ( a ), sin ( a ) );\n"
+        "    } else if ( shape == 2.0 ) {\n"
+        "        int first = int ( polygon ) * 8;\n"
+        "        int count = int ( texelFetch ( polygons, first ).z );\n"
+        "        extent = texelFetch ( polygons, first + gl_VertexID * count / 16 ).xy;\n"
+        "    } else {\n"
+        "        int corner = gl_VertexID / 4;\n"
+        "        vec2 side = vec2 ( corner == 1 || corner == 2 ? 1.0 : -1.0,\n"
+        "                           corner >= 2 ? 1.0 : -1.0 );\n"
+        "        extent = side * vec2 ( half_width, half_height );\n"
+        "    }\n"
+        "    vec2 p = center + vec2 ( extent.x * c - extent.y * s, extent.x * s + extent.y * c );\n"
+        "    gl_Position = gl_ModelViewProjectionMatrix * vec4 ( p, 0.0, 1.0 );\n"
+        "}\n";
+
+    const char* const k_fragment_shader =
+        "#version 150 compatibility\n"
+        "uniform vec3 color;\n"
+        "out vec4 frag_color;\n"
+        "void main ( )\n"
+        "{\n"
+        "    frag_color = vec4 ( color, 1.0 );\n"
+        "}\n";
+
+    // shader attribute names, by instance stream
+    const char* const k_attribute_names [ quad_renderer::k_num_instance_streams ] = {
+        "previous_x",
+        "previous_y",
+        "previous_rotation",
+        "center_x",
+        "center_y",
+        "rotation",
+        "half_width",
+        "half_height",
+        "shape",
+        "polygon"
+    };
+
+    // the world stream each instance stream is copied from
+    const quad_world::stream k_source_streams [ quad_renderer::k_num_instance_streams ] = {
+        quad_world::s_previous_x,
+        quad_world::s_previous_y,
+        quad_world::s_previous_rotation,
+        quad_world::s_center_x,
+        quad_world::s_center_y,
+        quad_world::s_rotation,
+        quad_world::s_half_width,
+        quad_world::s_half_height,
+        quad_world::s_shape,
+        quad_world::s_polygon
+    };
+
+    // room for this many bodies before the buffer first has to grow
+    const unsigned int k_initial_capacity = 1024;
+
+    GLuint compile ( GLenum type, const char* source )
+    {
+        GLuint shader = gl.create_shader ( type );
+
+        gl.shader_source ( shader, 1, &source, nullptr );
+        gl.compile_shader ( shader );
+
+        GLint compiled = GL_FALSE;
+        gl.get_shader_iv ( shader, GL_COMPILE_STATUS, &compiled );
+
+        if ( compiled != GL_TRUE ) {
+            char log [ 1024 ];
+            gl.get_shader_info_log ( shader, sizeof ( log ), nullptr, log );
+            std::cerr << "quad_renderer shader: " << log << std::endl;
+
+            gl.delete_shader ( shader );
+            return 0;
+        }
+
+        return shader;
+    }
+
+    // block until the gpu is done with whatever was fenced
+    void wait_fence ( GLsync& fence )
+    {
+        if ( !fence ) {
+            return;
+        }
+
+        const GLuint64 k_timeout = 1000000000;
+
+        while ( gl.client_wait_sync ( fence, GL_SYNC_FLUSH_COMMANDS_BIT, k_timeout ) == GL_TIMEOUT_EXPIRED ) {
+        }
+
+        gl.delete_sync ( fence );
+        fence = nullptr;
+    }
+
+}
+
+quad_renderer::quad_renderer ( ) :
+    m_program { 0 },
+    m_vertex_array { 0 },
+    m_buffer { 0 },
+    m_alpha_location { -1 },
+    m_color_location { -1 },
+    m_polygons_location { -1 },
+    m_polygon_buffer { 0 },
+    m_polygon_texture { 0 },
+    m_polygon_source { nullptr },
+    m_polygon_count { 0 },
+    m_mapped { nullptr },
+    m_capacity { 0 },
+    m_fences { },
+    m_region { 0 },
+    m_world { nullptr },
+    m_count { 0 },
+    m_alpha { 0.0f },
+    m_pending { false },
+    m_stop { false }
+{
+}
+
+quad_renderer::~quad_renderer ( )
+{
+    // the gl objects go with the context, only the thread is left
+    if ( m_filler.joinable ( ) ) {
+        {
+            std::lock_guard<std::mutex> lock { m_mutex };
+            m_stop = true;
+        }
+
+        m_start.notify_one ( );
+        m_filler.join ( );
+    }
+}
+
+bool quad_renderer::init ( )
+{
+    // persistent mapping is 4.4, base instance 4.2
+    GLint major = 0;
+    GLint minor = 0;
+
+    glGetIntegerv ( GL_MAJOR_VERSION, &major );
+    glGetIntegerv ( GL_MINOR_VERSION, &minor );
+
+    if ( major < 4 || ( major == 4 && minor < 4 ) || !load_functions ( ) ) {
+        return false;
+    }
+
+    GLuint vertex = compile ( GL_VERTEX_SHADER, k_vertex_shader );
+    GLuint fragment = compile ( GL_FRAGMENT_SHADER, k_fragment_shader );
+
+    if ( !vertex || !fragment ) {
+        gl.delete_shader ( vertex );
+        gl.delete_shader ( fragment );
+        return false;
+    }
+
+    GLuint program = gl.create_program ( );
+
+    gl.attach_shader ( program, vertex );
+    gl.attach_shader ( program, fragment );
+
+    for ( unsigned int s = 0; s < k_num_instance_streams; ++s ) {
+        gl.bind_attrib_location ( program, s, k_attribute_names [ s ] );
+    }
+
+    gl.link_program ( program );
+
+    gl.delete_shader ( vertex );
+    gl.delete_shader ( fragment );
+
+    GLint linked = GL_FALSE;
+    gl.get_program_iv ( program, GL_LINK_STATUS, &linked );
+
+    if ( linked != GL_TRUE ) {
+        char log [ 1024 ];
+        gl.get_program_info_log ( program, sizeof ( log ), nullptr, log );
+        std::cerr << "quad_renderer program: " << log << std::endl;
+
+        gl.delete_program ( program );
+        return false;
+    }
+
+    m_program = program;
+    m_alpha_location = gl.get_uniform_location ( m_program, "alpha" );
+    m_color_location = gl.get_uniform_location ( m_program, "color" );
+    m_polygons_location = gl.get_uniform_location ( m_program, "polygons" );
+
+    gl.gen_vertex_arrays ( 1, &m_vertex_array );
+    allocate ( k_initial_capacity );
+
+    if ( !m_mapped ) {
+        gl.delete_buffers ( 1, &m_buffer );
+        gl.delete_vertex_arrays ( 1, &m_vertex_array );
+        gl.delete_program ( m_program );
+
+        m_buffer = 0;
+        m_vertex_array = 0;
+        m_program = 0;
+        m_capacity = 0;
+        return false;
+    }
+
+    // no polygons until the first world has some
+    gl.gen_buffers ( 1, &m_polygon_buffer );
+    gl.bind_buffer ( GL_TEXTURE_BUFFER, m_polygon_buffer );
+    gl.buffer_data ( GL_TEXTURE_BUFFER, 4 * sizeof ( float ), nullptr, GL_STATIC_DRAW );
+    gl.bind_buffer ( GL_TEXTURE_BUFFER, 0 );
+
+    glGenTextures ( 1, &m_polygon_texture );
+    glBindTexture ( GL_TEXTURE_BUFFER, m_polygon_texture );
+    gl.tex_buffer ( GL_TEXTURE_BUFFER, GL_RGBA32F, m_polygon_buffer );
+    glBindTexture ( GL_TEXTURE_BUFFER, 0 );
+
+    m_polygon_source = nullptr;
+    m_polygon_count = 0;
+
+    m_stop = false;
+    m_filler = std::thread { &quad_renderer::fill_loop, this };
+
+    return true;
+}
+
+void quad_renderer::shutdown ( )
+{
+    if ( !available ( ) ) {
+        return;
+    }
+
+    wait ( );
+
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        m_stop = true;
+    }
+
+    m_start.notify_one ( );
+    m_filler.join ( );
+
+    for ( unsigned int r = 0; r < k_num_regions; ++r ) {
+        wait_fence ( m_fences [ r ] );
+    }
+
+    gl.bind_buffer ( GL_ARRAY_BUFFER, m_buffer );
+    gl.unmap_buffer ( GL_ARRAY_BUFFER );
+    gl.bind_buffer ( GL_ARRAY_BUFFER, 0 );
+
+    gl.delete_buffers ( 1, &m_buffer );
+    gl.delete_buffers ( 1, &m_polygon_buffer );
+    glDeleteTextures ( 1, &m_polygon_texture );
+    gl.delete_vertex_arrays ( 1, &m_vertex_array );
+    gl.delete_program ( m_program );
+
+    m_buffer = 0;
+    m_polygon_buffer = 0;
+    m_polygon_texture = 0;
+    m_vertex_array = 0;
+    m_program = 0;
+    m_mapped = nullptr;
+    m_capacity = 0;
+}
+
+void quad_renderer::allocate ( unsigned int count )
+{
+    // the gpu may still be reading any region of the old buffer
+    for ( unsigned int r = 0; r < k_num_regions; ++r ) {
+        wait_fence ( m_fences [ r ] );
+    }
+
+    if ( m_buffer ) {
+        gl.bind_buffer ( GL_ARRAY_BUFFER, m_buffer );
+        gl.unmap_buffer ( GL_ARRAY_BUFFER );
+        gl.delete_buffers ( 1, &m_buffer );
+    }
+
+    // each instance stream is one run of every region back to back,
+    // so one base instance of region * capacity selects a region in
+    // all of them
+    GLsizeiptr stream_size = static_cast<GLsizeiptr> ( sizeof ( float ) ) * count * k_num_regions;
+    GLsizeiptr size = stream_size * k_num_instance_streams;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    gl.gen_buffers ( 1, &m_buffer );
+    gl.bind_buffer ( GL_ARRAY_BUFFER, m_buffer );
+    gl.buffer_storage ( GL_ARRAY_BUFFER, size, nullptr, flags );
+
+    m_mapped = static_cast<float*> ( gl.map_buffer_range ( GL_ARRAY_BUFFER, 0, size, flags ) );
+    m_capacity = count;
+
+    gl.bind_vertex_array ( m_vertex_array );
+
+    for ( unsigned int s = 0; s < k_num_instance_streams; ++s ) {
+        const GLvoid* offset = reinterpret_cast<const GLvoid*> ( stream_size * s );
+
+        gl.vertex_attrib_pointer ( s, 1, GL_FLOAT, GL_FALSE, 0, offset );
+        gl.enable_vertex_attrib_array ( s );
+        gl.vertex_attrib_divisor ( s, 1 );
+    }
+
+    gl.bind_vertex_array ( 0 );
+    gl.bind_buffer ( GL_ARRAY_BUFFER, 0 );
+}
+
+void quad_renderer::fill ( const quad_world& world )
+{
+    if ( !available ( ) ) {
+        return;
+    }
+
+    wait ( );
+
+    unsigned int count = world.size ( );
+
+    if ( count > m_capacity ) {
+        allocate ( count > m_capacity * 2 ? count : m_capacity * 2 );
+    }
+
+    if ( world.polygon_count ( ) != m_polygon_count || world.polygons ( ) != m_polygon_source ) {
+        upload_polygons ( world );
+    }
+
+    m_region = ( m_region + 1 ) % k_num_regions;
+    wait_fence ( m_fences [ m_region ] );
+
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        m_world = &world;
+        m_count = count;
+        m_alpha = world.interpolation ( );
+        m_pending = true;
+    }
+
+    m_start.notify_one ( );
+}
+
+void quad_renderer::upload_polygons ( const quad_world& world )
+{
+    const unsigned int k_texel = 4;
+    const unsigned int k_stride = convex_polygon::k_max_vertices * k_texel;
+
+    m_polygon_source = world.polygons ( );
+    m_polygon_count = world.polygon_count ( );
+
+    if ( m_polygon_count == 0 ) {
+        return;
+    }
+
+    m_polygon_texels.assign ( m_polygon_count * k_stride, 0.0f );
+
+    for ( unsigned int p = 0; p < m_polygon_count; ++p ) {
+        const convex_polygon& polygon = m_polygon_source [ p ];
+        float* texels = m_polygon_texels.data ( ) + p * k_stride;
+
+        for ( unsigned int v = 0; v < polygon.count; ++v ) {
+            texels [ v * k_texel + 0 ] = polygon.vertices [ v ].x ( );
+            texels [ v * k_texel + 1 ] = polygon.vertices [ v ].y ( );
+            texels [ v * k_texel + 2 ] = static_cast<float> ( polygon.count );
+        }
+    }
+
+    // a draw may still read the old polygons, re-specifying the store
+    // leaves them to it
+    gl.bind_buffer ( GL_TEXTURE_BUFFER, m_polygon_buffer );
+    gl.buffer_data ( GL_TEXTURE_BUFFER,
+                     static_cast<GLsizeiptr> ( m_polygon_texels.size ( ) * sizeof ( float ) ),
+                     m_polygon_texels.data ( ),
+                     GL_STATIC_DRAW );
+    gl.bind_buffer ( GL_TEXTURE_BUFFER, 0 );
+}
+
+void quad_renderer::draw ( float r, float g, float b )
+{
+    if ( !available ( ) ) {
+        return;
+    }
+
+    wait ( );
+
+    if ( m_count == 0 ) {
+        return;
+    }
+
+    gl.use_program ( m_program );
+    gl.uniform_1f ( m_alpha_location, m_alpha );
+    gl.uniform_3f ( m_color_location, r, g, b );
+    gl.uniform_1i ( m_polygons_location, 0 );
+
+    gl.active_texture ( GL_TEXTURE0 );
+    glBindTexture ( GL_TEXTURE_BUFFER, m_polygon_texture );
+
+    gl.bind_vertex_array ( m_vertex_array );
+    gl.draw_arrays_instanced_base_instance ( GL_LINE_LOOP, 0, k_outline_vertices,
+                                             static_cast<GLsizei> ( m_count ),
+                                             m_region * m_capacity );
+    gl.bind_vertex_array ( 0 );
+
+    glBindTexture ( GL_TEXTURE_BUFFER, 0 );
+    gl.use_program ( 0 );
+
+    // the region is free again once the gpu is past this draw
+    m_fences [ m_region ] = gl.fence_sync ( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+void quad_renderer::wait ( )
+{
+    std::unique_lock<std::mutex> lock { m_mutex };
+    m_done.wait ( lock, [ this ] { return !m_pending; } );
+}
+
+void quad_renderer::fill_loop ( )
+{
+    for ( ;; ) {
+        {
+            std::unique_lock<std::mutex> lock { m_mutex };
+            m_start.wait ( lock, [ this ] { return m_stop || m_pending; } );
+
+            if ( m_stop ) {
+                return;
+            }
+        }
+
+        copy ( );
+
+        {
+            std::lock_guard<std::mutex> lock { m_mutex };
+            m_pending = false;
+        }
+
+        m_done.notify_one ( );
+    }
+}
+
+void quad_renderer::copy ( )
+{
+    // straight from the world's streams, the mapping is coherent so
+    // the writes are seen by the draw that follows
+    size_t stream_length = static_cast<size_t> ( m_capacity ) * k_num_regions;
+    size_t region_offset = static_cast<size_t> ( m_region ) * m_capacity;
+
+    for ( unsigned int s = 0; s < k_num_instance_streams; ++s ) {
+        std::memcpy ( m_mapped + stream_length * s + region_offset,
+                      m_world->data ( k_source_streams [ s ] ),
+                      sizeof ( float ) * m_count );
+    }
+}
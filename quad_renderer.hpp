@@ -0,0 +1,123 @@
+#ifndef QUAD_RENDERER
+#define QUAD_RENDERER
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL2/SDL_opengl.h>
+
+#include "quad_world.hpp"
+
+// draws every body in a world as a line loop of k_outline_vertices with
+// one instanced draw call. the instance buffer is mapped once,
+// persistently, and split in k_num_regions regions so the cpu fills one
+// while the gpu reads the others, a fence per region says when it is
+// free again. each region holds the pose streams the vertex shader
+// needs, copied as they are from the world: the previous and current
+// center and rotation and the half extents, the shape and the polygon.
+// the shader blends the poses by the world's interpolation and builds
+// the outline, the corners of a box repeated, points around a circle or
+// the vertices of a polygon, so nothing per body is computed on the
+// cpu. the world's polygons go to a texture buffer when more are added.
+//
+// the copy runs on a fill thread. fill hands it the world after the
+// step and returns, draw waits for it and issues the draw call, the
+// caller can clear and draw anything else in between. the world must
+// not be stepped or changed from fill until draw returns.
+//
+// needs opengl 4.4 for the persistent mapping, available is false on
+// older contexts and the caller should draw some other way.
+class quad_renderer {
+public:
+    quad_renderer ( );
+    ~quad_renderer ( );
+
+    quad_renderer ( const quad_renderer& ) = delete;
+    quad_renderer& operator= ( const quad_renderer& ) = delete;
+
+    // load the entry points and build the shader, the context has to
+    // be current. returns false if it cannot be used
+    bool init ( );
+
+    // free the gl objects, the context has to be current
+    void shutdown ( );
+
+    bool available ( ) const { return m_program != 0; }
+
+    // start copying every body of world to the next free region
+    void fill ( const quad_world& world );
+
+    // wait for the copy and draw what it wrote in one color
+    void draw ( float r, float g, float b );
+
+    // bodies the buffer has room for in each region, grows on fill
+    unsigned int capacity ( ) const { return m_capacity; }
+
+    // the poses copied for every body, in the order the shader reads them
+    enum instance_stream {
+        i_previous_x,
+        i_previous_y,
+        i_previous_rotation,
+        i_center_x,
+        i_center_y,
+        i_rotation,
+        i_half_width,
+        i_half_height,
+        i_shape,
+        i_polygon,
+        k_num_instance_streams
+    };
+
+    static const unsigned int k_num_regions = 3;
+    static const unsigned int k_outline_vertices = 16;
+
+private:
+
+    // (re)create the buffer with room for count bodies per region
+    void allocate ( unsigned int count );
+
+    // copy the world's polygons to the texture buffer
+    void upload_polygons ( const quad_world& world );
+
+    void fill_loop ( );
+    void copy ( );
+
+    // wait for the fill thread to finish the current region
+    void wait ( );
+
+    GLuint m_program;
+    GLuint m_vertex_array;
+    GLuint m_buffer;
+    GLint m_alpha_location;
+    GLint m_color_location;
+    GLint m_polygons_location;
+
+    // a polygon's vertices as x, y, count, 0 texels, k_max_vertices each
+    GLuint m_polygon_buffer;
+    GLuint m_polygon_texture;
+    std::vector<float> m_polygon_texels;
+    const convex_polygon* m_polygon_source;
+    unsigned int m_polygon_count;
+
+    float* m_mapped;
+    unsigned int m_capacity;
+
+    GLsync m_fences [ k_num_regions ];
+    unsigned int m_region;
+
+    // what the fill thread is copying and how much of it
+    const quad_world* m_world;
+    unsigned int m_count;
+    float m_alpha;
+
+    std::thread m_filler;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    bool m_pending;
+    bool m_stop;
+};
+
+#endif
@@ -0,0 +1,1589 @@
+#include "quad_world.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "fast_math.hpp"
+#include "profiler.hpp"
+
+namespace {
+
+    const float k_default_fixed_dt = 1.0f / 60.0f;
+    const unsigned int k_default_max_substeps = 8;
+
+    // a settled pile of boxes averages a little under two contacts a body
+    const unsigned int k_contacts_per_body = 2;
+
+    // bodies per parallel chunk, a multiple of the widest simd path
+    const unsigned int k_body_grain = 1024;
+
+    // bullets are stopped overlapping what they hit by this fraction of
+    // the contact slop, give or take the tolerance, so a contact is
+    // made on the next step without much to push out
+    const float k_bullet_overlap = 0.5f;
+    const float k_bullet_tolerance = 0.25f;
+
+    typedef std::chrono::steady_clock step_clock;
+
+    // first fraction along from + delta * t, up to max_fraction, at
+    // which the segment enters the circle. false if it misses or
+    // starts inside
+    bool ray_circle ( const vec2& from,
+                      const vec2& delta,
+                      const vec2& center,
+                      float radius,
+                      float max_fraction,
+                      float& fraction,
+                      vec2& normal )
+    {
+        vec2 offset = from - center;
+
+        float a = delta.dot ( delta );
+        float b = offset.dot ( delta );
+        float c = offset.dot ( offset ) - radius * radius;
+        float discriminant = b * b - a * c;
+
+        if ( c < 0.0f || a == 0.0f || discriminant < 0.0f ) {
+            return false;
+        }
+
+        float t = ( -b - std::sqrt ( discriminant ) ) / a;
+
+        if ( t < 0.0f || t > max_fraction ) {
+            return false;
+        }
+
+        fraction = t;
+        normal = ( offset + delta * t ) / radius;
+
+        return true;
+    }
+
+    // same for a counter clockwise convex polygon, clipping the segment
+    // against the plane of every edge
+    bool ray_polygon ( const vec2& from,
+                       const vec2& delta,
+                       const vec2* vertices,
+                       unsigned int count,
+                       float max_fraction,
+                       float& fraction,
+                       vec2& normal )
+    {
+        float t_min = 0.0f;
+        float t_max = max_fraction;
+        int hit_edge = -1;
+        vec2 hit_normal;
+
+        for ( unsigned int i = 0; i < count; ++i ) {
+            const vec2& v0 = vertices [ i ];
+            const vec2& v1 = vertices [ i + 1 < count ? i + 1 : 0 ];
+
+            vec2 n { v1.y ( ) - v0.y ( ), v0.x ( ) - v1.x ( ) };
+
+            float distance = n.dot ( v0 - from );
+            float speed = n.dot ( delta );
+
+            if ( speed == 0.0f ) {
+                if ( distance < 0.0f ) {
+                    return false;
+                }
+
+                continue;
+            }
+
+            float t = distance / speed;
+
+            if ( speed < 0.0f && t > t_min ) {
+                t_min = t;
+                hit_edge = static_cast<int> ( i );
+                hit_normal = n;
+            } else if ( speed > 0.0f && t < t_max ) {
+                t_max = t;
+            }
+
+            if ( t_min > t_max ) {
+                return false;
+            }
+        }
+
+        if ( hit_edge < 0 ) {
+            return false;
+        }
+
+        hit_normal.normalize ( );
+
+        fraction = t_min;
+        normal = hit_normal;
+
+        return true;
+    }
+
+    // milliseconds since start, moving start up to now
+    double lap ( step_clock::time_point& start )
+    {
+        step_clock::time_point now = step_clock::now ( );
+        double ms = std::chrono::duration<double, std::milli> ( now - start ).count ( );
+
+        start = now;
+
+        return ms;
+    }
+
+}
+
+quad_world::quad_world ( ) :
+    m_pool { new thread_pool { } },
+    m_bounds_stale { true },
+    m_updated { false },
+    m_awake { 0 },
+    m_timings { },
+    m_fixed_dt { k_default_fixed_dt },
+    m_max_substeps { k_default_max_substeps },
+    m_accumulator { 0.0f }
+{
+    set_broad_phase ( broad_phase_grid );
+}
+
+quad_world::handle quad_world::create ( const vec2& center,
+                                        float width,
+                                        float height,
+                                        float mass,
+                                        float rotation )
+{
+    // inertia of a quad
+    float inertia = ( mass / 12.0f ) * ( width * width + height * height );
+
+    return insert ( center, width * 0.5f, height * 0.5f, mass, inertia, rotation, shape_box, k_no_polygon );
+}
+
+quad_world::handle quad_world::create_circle ( const vec2& center,
+                                               float radius,
+                                               float mass )
+{
+    float inertia = mass * radius * radius * 0.5f;
+
+    return insert ( center, radius, radius, mass, inertia, 0.0f, shape_circle, k_no_polygon );
+}
+
+quad_world::handle quad_world::create_polygon ( const vec2& center,
+                                                unsigned int polygon,
+                                                float mass,
+                                                float rotation )
+{
+    // k_no_polygon from a polygon add_polygon would not take included
+    if ( polygon >= m_polygons.size ( ) ) {
+        return handle { ~0u, 0 };
+    }
+
+    const convex_polygon& p = m_polygons [ polygon ];
+
+    return insert ( center, p.extents.x ( ), p.extents.y ( ), mass, mass * p.inertia, rotation, shape_polygon, polygon );
+}
+
+unsigned int quad_world::add_polygon ( const vec2* points, unsigned int count )
+{
+    convex_polygon polygon;
+
+    if ( !make_polygon ( points, count, polygon ) ) {
+        return k_no_polygon;
+    }
+
+    m_polygons.push_back ( polygon );
+
+    return static_cast<unsigned int> ( m_polygons.size ( ) - 1 );
+}
+
+quad_world::handle quad_world::insert ( const vec2& center,
+                                        float half_width,
+                                        float half_height,
+                                        float mass,
+                                        float inertia,
+                                        float rotation,
+                                        shape_kind shape,
+                                        unsigned int polygon )
+{
+    unsigned int index = size ( );
+    unsigned int s = 0;
+
+    // reuse a destroyed slot if there is one
+    if ( !m_free_slots.empty ( ) ) {
+        s = m_free_slots.back ( );
+        m_free_slots.pop_back ( );
+    } else {
+        s = static_cast<unsigned int> ( m_slots.size ( ) );
+        m_slots.push_back ( slot { 0, 0 } );
+    }
+
+    m_slots [ s ].index = index;
+    m_owners.push_back ( s );
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].push_back ( 0.0f );
+    }
+
+    fill ( index, center, half_width, half_height, mass, inertia, rotation, shape, polygon );
+
+    update_corners ( index, index + 1 );
+
+    // new bodies start awake, static ones stay behind the awake range
+    if ( mass > 0.0f ) {
+        wake ( index );
+    }
+
+    return handle { s, m_slots [ s ].generation };
+}
+
+void quad_world::fill ( unsigned int index,
+                        const vec2& center,
+                        float half_width,
+                        float half_height,
+                        float mass,
+                        float inertia,
+                        float rotation,
+                        shape_kind shape,
+                        unsigned int polygon )
+{
+    if ( mass <= 0.0f ) {
+        mass = 0.0f;
+        inertia = 0.0f;
+    }
+
+    m_streams [ s_center_x ][ index ] = center.x ( );
+    m_streams [ s_center_y ][ index ] = center.y ( );
+    m_streams [ s_rotation ][ index ] = rotation;
+    m_streams [ s_inv_mass ][ index ] = mass > 0.0f ? 1.0f / mass : 0.0f;
+    m_streams [ s_inv_inertia ][ index ] = mass > 0.0f ? 1.0f / inertia : 0.0f;
+    m_streams [ s_half_width ][ index ] = half_width;
+    m_streams [ s_half_height ][ index ] = half_height;
+    m_streams [ s_mass ][ index ] = mass;
+    m_streams [ s_inertia ][ index ] = inertia;
+    m_streams [ s_previous_x ][ index ] = center.x ( );
+    m_streams [ s_previous_y ][ index ] = center.y ( );
+    m_streams [ s_previous_rotation ][ index ] = rotation;
+
+    // the polygon index is exact as a float up to 2 ^ 24
+    m_streams [ s_shape ][ index ] = static_cast<float> ( shape );
+    m_streams [ s_polygon ][ index ] = shape == shape_polygon ? static_cast<float> ( polygon ) : 0.0f;
+}
+
+void quad_world::create_bodies ( const body_def* defs, unsigned int count, handle* out )
+{
+    unsigned int first = size ( );
+    unsigned int last = first;
+
+    // polygons that are not the world's make no body, as with
+    // create_polygon
+    for ( unsigned int i = 0; i < count; ++i ) {
+        if ( defs [ i ].shape != shape_polygon || defs [ i ].polygon < m_polygons.size ( ) ) {
+            last++;
+        }
+    }
+
+    // every stream grows once for the whole batch
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].resize ( last, 0.0f );
+    }
+
+    m_owners.resize ( last );
+
+    unsigned int index = first;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const body_def& def = defs [ i ];
+
+        if ( def.shape == shape_polygon && def.polygon >= m_polygons.size ( ) ) {
+            if ( out ) {
+                out [ i ] = handle { ~0u, 0 };
+            }
+
+            continue;
+        }
+
+        unsigned int s = 0;
+
+        if ( !m_free_slots.empty ( ) ) {
+            s = m_free_slots.back ( );
+            m_free_slots.pop_back ( );
+        } else {
+            s = static_cast<unsigned int> ( m_slots.size ( ) );
+            m_slots.push_back ( slot { 0, 0 } );
+        }
+
+        m_slots [ s ].index = index;
+        m_owners [ index ] = s;
+
+        float width = def.size.x ( );
+        float height = def.size.y ( );
+
+        if ( def.shape == shape_circle ) {
+            fill ( index, def.center, width, width, def.mass, def.mass * width * width * 0.5f, 0.0f, shape_circle, k_no_polygon );
+        } else if ( def.shape == shape_polygon ) {
+            const convex_polygon& p = m_polygons [ def.polygon ];
+
+            fill ( index, def.center, p.extents.x ( ), p.extents.y ( ), def.mass, def.mass * p.inertia, def.rotation, shape_polygon, def.polygon );
+        } else {
+            float inertia = ( def.mass / 12.0f ) * ( width * width + height * height );
+
+            fill ( index, def.center, width * 0.5f, height * 0.5f, def.mass, inertia, def.rotation, shape_box, k_no_polygon );
+        }
+
+        m_streams [ s_bullet ][ index ] = def.bullet ? 1.0f : 0.0f;
+
+        if ( out ) {
+            out [ i ] = handle { s, m_slots [ s ].generation };
+        }
+
+        index++;
+    }
+
+    update_corners ( first, last );
+
+    // the same order waking them one at a time would leave, every
+    // dynamic body swapped in at the end of the awake range
+    for ( unsigned int index = first; index < last; ++index ) {
+        if ( m_streams [ s_inv_mass ][ index ] > 0.0f ) {
+            swap_bodies ( index, m_awake );
+            m_awake++;
+        }
+    }
+}
+
+void quad_world::destroy ( handle h )
+{
+    if ( !alive ( h ) ) {
+        return;
+    }
+
+    m_joints.remove_attached ( h.slot );
+
+    unsigned int index = m_slots [ h.slot ].index;
+    unsigned int last = size ( ) - 1;
+
+    // keep the awake range packed, the last awake body fills the hole
+    if ( index < m_awake ) {
+        m_awake--;
+        swap_bodies ( index, m_awake );
+        index = m_awake;
+    }
+
+    m_broad_phase->remove ( index, last );
+
+    // move the last body into the hole to keep the streams packed
+    if ( index != last ) {
+        for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+            m_streams [ i ][ index ] = m_streams [ i ][ last ];
+        }
+
+        m_owners [ index ] = m_owners [ last ];
+        m_slots [ m_owners [ index ] ].index = index;
+    }
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].pop_back ( );
+    }
+
+    m_owners.pop_back ( );
+    m_bounds_stale = true;
+
+    // bump the generation so stale handles are rejected
+    m_slots [ h.slot ].generation++;
+    m_free_slots.push_back ( h.slot );
+}
+
+void quad_world::save_body ( handle h, float* fields ) const
+{
+    unsigned int index = m_slots [ h.slot ].index;
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        fields [ i ] = m_streams [ i ][ index ];
+    }
+}
+
+quad_world::handle quad_world::restore_body ( const float* fields, bool awake )
+{
+    unsigned int index = size ( );
+    unsigned int s = 0;
+
+    if ( !m_free_slots.empty ( ) ) {
+        s = m_free_slots.back ( );
+        m_free_slots.pop_back ( );
+    } else {
+        s = static_cast<unsigned int> ( m_slots.size ( ) );
+        m_slots.push_back ( slot { 0, 0 } );
+    }
+
+    m_slots [ s ].index = index;
+    m_owners.push_back ( s );
+
+    // the corners and cached sine and cosine come back with the rest
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].push_back ( fields [ i ] );
+    }
+
+    m_bounds_stale = true;
+
+    if ( awake && fields [ s_inv_mass ] > 0.0f ) {
+        swap_bodies ( index, m_awake );
+        m_awake++;
+    } else {
+        settle_pose ( index );
+    }
+
+    return handle { s, m_slots [ s ].generation };
+}
+
+bool quad_world::alive ( handle h ) const
+{
+    return h.slot < m_slots.size ( ) &&
+           m_slots [ h.slot ].generation == h.generation &&
+           m_slots [ h.slot ].index < size ( ) &&
+           m_owners [ m_slots [ h.slot ].index ] == h.slot;
+}
+
+void quad_world::reserve ( unsigned int count )
+{
+    m_slots.reserve ( count );
+    m_owners.reserve ( count );
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].reserve ( count );
+    }
+
+    m_bounds.reserve ( count );
+    m_stay_awake.reserve ( count );
+    m_solver.reserve ( count * k_contacts_per_body );
+}
+
+void quad_world::clear ( )
+{
+    // keep the slots around so outstanding handles stay invalid
+    for ( unsigned int i = 0; i < size ( ); ++i ) {
+        m_slots [ m_owners [ i ] ].generation++;
+    }
+
+    // every slot is free now, last first so the world built next gets
+    // them back in the order a fresh one would hand them out
+    m_free_slots.clear ( );
+
+    for ( unsigned int s = static_cast<unsigned int> ( m_slots.size ( ) ); s-- > 0; ) {
+        m_free_slots.push_back ( s );
+    }
+
+    m_owners.clear ( );
+    m_broad_phase->clear ( );
+    m_joints.clear ( );
+    m_awake = 0;
+    m_bounds.clear ( );
+    m_bounds_stale = true;
+    m_pairs.clear ( );
+    m_accumulator = 0.0f;
+
+    // contacts name dense indices, and kept ones would warm start
+    // bodies that reuse their slots
+    m_solver.restore ( nullptr, 0 );
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].clear ( );
+    }
+}
+
+joint_handle quad_world::create_joint ( handle a, handle b, const joint_def& def )
+{
+    if ( !alive ( a ) || !alive ( b ) || a.slot == b.slot ) {
+        return joint_handle { ~0u, 0 };
+    }
+
+    unsigned int ia = index ( a );
+    unsigned int ib = index ( b );
+
+    vec2 center_a { m_streams [ s_center_x ][ ia ], m_streams [ s_center_y ][ ia ] };
+    vec2 center_b { m_streams [ s_center_x ][ ib ], m_streams [ s_center_y ][ ib ] };
+
+    float rotation_a = m_streams [ s_rotation ][ ia ];
+    float rotation_b = m_streams [ s_rotation ][ ib ];
+
+    float sin_a, cos_a, sin_b, cos_b;
+
+    fast_math::sincos ( rotation_a, sin_a, cos_a );
+    fast_math::sincos ( rotation_b, sin_b, cos_b );
+
+    // world space into each body's frame, the inverse rotation
+    vec2 ra = def.anchor_a - center_a;
+    vec2 rb = def.anchor_b - center_b;
+
+    joint_constraint j { };
+
+    j.kind = def.kind;
+    j.slot_a = a.slot;
+    j.slot_b = b.slot;
+    j.a = ia;
+    j.b = ib;
+    j.local_a.set ( ra.x ( ) * cos_a + ra.y ( ) * sin_a, ra.y ( ) * cos_a - ra.x ( ) * sin_a );
+    j.local_b.set ( rb.x ( ) * cos_b + rb.y ( ) * sin_b, rb.y ( ) * cos_b - rb.x ( ) * sin_b );
+    j.local_axis.set ( def.axis.x ( ) * cos_a + def.axis.y ( ) * sin_a, def.axis.y ( ) * cos_a - def.axis.x ( ) * sin_a );
+    j.local_axis.normalize ( );
+    j.reference_angle = rotation_b - rotation_a;
+    j.length = def.length < 0.0f ? def.anchor_a.distance_to ( def.anchor_b ) : def.length;
+    j.motor = def.motor;
+    j.motor_speed = def.motor_speed;
+    j.max_motor_force = def.max_motor_force;
+    j.linear_offset = def.linear_offset;
+    j.angular_offset = def.angular_offset;
+    j.max_force = def.max_force;
+    j.max_torque = def.max_torque;
+    j.correction = def.correction;
+    j.collide_connected = def.collide_connected;
+
+    joint_handle h = m_joints.add ( j );
+
+    wake_joint ( h );
+
+    return h;
+}
+
+joint_handle quad_world::restore_joint ( handle a, handle b, const joint_constraint& joint )
+{
+    if ( !alive ( a ) || !alive ( b ) || a.slot == b.slot ) {
+        return joint_handle { ~0u, 0 };
+    }
+
+    joint_constraint j = joint;
+
+    j.slot_a = a.slot;
+    j.slot_b = b.slot;
+    j.a = index ( a );
+    j.b = index ( b );
+
+    return m_joints.add ( j );
+}
+
+void quad_world::destroy_joint ( joint_handle h )
+{
+    if ( !m_joints.alive ( h ) ) {
+        return;
+    }
+
+    // the bodies may have been held up by it
+    wake_joint ( h );
+    m_joints.remove ( h );
+}
+
+void quad_world::set_motor_speed ( joint_handle h, float speed )
+{
+    if ( !m_joints.alive ( h ) ) {
+        return;
+    }
+
+    m_joints.get ( h ).motor_speed = speed;
+    wake_joint ( h );
+}
+
+void quad_world::set_motor_target ( joint_handle h, const vec2& linear_offset, float angular_offset )
+{
+    if ( !m_joints.alive ( h ) ) {
+        return;
+    }
+
+    joint_constraint& j = m_joints.get ( h );
+
+    j.linear_offset = linear_offset;
+    j.angular_offset = angular_offset;
+
+    wake_joint ( h );
+}
+
+void quad_world::wake_joint ( joint_handle h )
+{
+    // the first wake can move b, so its index is looked up after
+    const joint_constraint& j = m_joints.get ( h );
+
+    wake ( m_slots [ j.slot_a ].index );
+    wake ( m_slots [ j.slot_b ].index );
+}
+
+quad_world::quad_ref quad_world::get ( handle h )
+{
+    return quad_ref { this, h };
+}
+
+void quad_world::update ( float dt, float friction )
+{
+    PROFILE_SCOPE ( "integrate" );
+
+    if ( m_updated ) {
+        m_bounds_stale = true;
+    }
+
+    m_updated = true;
+
+    save_poses ( );
+
+    // each chunk is integrated and transformed while it is in cache,
+    // most resting bodies come out where they were and keep their corners
+    m_pool->parallel_for ( m_awake, k_body_grain, [ this, dt, friction ] ( unsigned int first, unsigned int last ) {
+        PROFILE_SCOPE ( "integrate_chunk" );
+
+        m_integrator.integrate ( *this, first, last, dt, friction );
+        m_integrator.transform_moved_corners ( *this, first, last );
+    } );
+}
+
+void quad_world::set_threads ( unsigned int threads )
+{
+    m_pool.reset ( new thread_pool { threads } );
+    m_broad_phase->set_thread_pool ( m_pool.get ( ) );
+}
+
+void quad_world::step ( float dt, float friction )
+{
+    PROFILE_SCOPE ( "step" );
+
+    m_scratch.reset ( );
+
+    step_clock::time_point start = step_clock::now ( );
+    step_clock::time_point phase = start;
+
+    update ( dt, friction );
+
+    // gravity goes straight into the velocity the solver starts from,
+    // going through the force accumulator would scale it by the decay
+    if ( m_gravity.x ( ) != 0.0f || m_gravity.y ( ) != 0.0f ) {
+        float* velocity_x = data ( s_velocity_x );
+        float* velocity_y = data ( s_velocity_y );
+        const float* inv_mass = data ( s_inv_mass );
+
+        vec2 dv = m_gravity * dt;
+
+        for ( unsigned int i = 0; i < m_awake; ++i ) {
+            if ( inv_mass [ i ] > 0.0f ) {
+                velocity_x [ i ] += dv.x ( );
+                velocity_y [ i ] += dv.y ( );
+            }
+        }
+    }
+
+    m_timings.integrate = lap ( phase );
+
+    const std::vector<body_pair>& pairs = find_pairs ( );
+
+    m_timings.broad_phase = lap ( phase );
+
+    m_solver.collide ( *this, pairs );
+
+    m_timings.narrow_phase = lap ( phase );
+
+    m_solver.solve ( *this, dt );
+
+    sweep_bullets ( dt );
+
+    m_timings.solve = lap ( phase );
+
+    update_sleep ( dt );
+
+    m_timings.sleep = lap ( phase );
+    m_timings.total = lap ( start );
+}
+
+unsigned long long quad_world::checksum ( ) const
+{
+    const stream hashed [ ] = {
+        s_center_x, s_center_y, s_rotation,
+        s_velocity_x, s_velocity_y, s_angular_velocity
+    };
+
+    // fnv-1a over the slot and the raw bits of each value
+    unsigned long long hash = 14695981039346656037ull;
+
+    for ( unsigned int s = 0; s < slot_count ( ); ++s ) {
+        if ( !slot_live ( s ) ) {
+            continue;
+        }
+
+        unsigned int words [ 1 + sizeof ( hashed ) / sizeof ( hashed [ 0 ] ) ];
+        unsigned int i = m_slots [ s ].index;
+
+        words [ 0 ] = s;
+
+        for ( unsigned int f = 0; f < sizeof ( hashed ) / sizeof ( hashed [ 0 ] ); ++f ) {
+            std::memcpy ( &words [ f + 1 ], &m_streams [ hashed [ f ] ][ i ], sizeof ( float ) );
+        }
+
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*> ( words );
+
+        for ( unsigned int b = 0; b < sizeof ( words ); ++b ) {
+            hash ^= bytes [ b ];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+void quad_world::wake ( handle h )
+{
+    if ( alive ( h ) ) {
+        wake ( index ( h ) );
+    }
+}
+
+void quad_world::wake ( unsigned int index )
+{
+    if ( index < m_awake || m_streams [ s_inv_mass ][ index ] == 0.0f ) {
+        return;
+    }
+
+    m_streams [ s_sleep_time ][ index ] = 0.0f;
+    settle_pose ( index );
+
+    swap_bodies ( index, m_awake );
+    m_awake++;
+}
+
+void quad_world::update_sleep ( float dt )
+{
+    PROFILE_SCOPE ( "sleep" );
+
+    unsigned int count = size ( );
+
+    // wake anything left asleep from before sleeping was turned off,
+    // whatever gets swapped past i is static
+    if ( !m_sleep.enabled ) {
+        for ( unsigned int i = m_awake; i < count; ++i ) {
+            wake ( i );
+        }
+
+        return;
+    }
+
+    float* velocity_x = data ( s_velocity_x );
+    float* velocity_y = data ( s_velocity_y );
+    float* angular_velocity = data ( s_angular_velocity );
+    float* sleep_time = data ( s_sleep_time );
+
+    float linear_tolerance = m_sleep.linear_tolerance * m_sleep.linear_tolerance;
+    float angular_tolerance = m_sleep.angular_tolerance * m_sleep.angular_tolerance;
+
+    m_stay_awake.assign ( count, 0 );
+
+    for ( unsigned int i = 0; i < m_awake; ++i ) {
+        float speed = velocity_x [ i ] * velocity_x [ i ] + velocity_y [ i ] * velocity_y [ i ];
+        float spin = angular_velocity [ i ] * angular_velocity [ i ];
+
+        if ( speed > linear_tolerance || spin > angular_tolerance ) {
+            sleep_time [ i ] = 0.0f;
+        } else {
+            sleep_time [ i ] += dt;
+        }
+
+        m_stay_awake [ i ] = sleep_time [ i ] < m_sleep.time_to_sleep;
+    }
+
+    // touching bodies sleep and wake together, an island with a
+    // moving body wakes up the sleeping ones it ran into
+    for ( unsigned int island = 0; island < m_solver.island_count ( ); ++island ) {
+        if ( !m_solver.island_awake ( island ) ) {
+            continue;
+        }
+
+        const unsigned int* bodies = m_solver.island_bodies ( island );
+        unsigned int body_count = m_solver.island_body_count ( island );
+
+        float min_sleep_time = m_sleep.time_to_sleep;
+
+        for ( unsigned int i = 0; i < body_count; ++i ) {
+            min_sleep_time = std::min ( min_sleep_time, sleep_time [ bodies [ i ] ] );
+        }
+
+        bool stay_awake = min_sleep_time < m_sleep.time_to_sleep;
+
+        for ( unsigned int i = 0; i < body_count; ++i ) {
+            m_stay_awake [ bodies [ i ] ] = stay_awake;
+
+            if ( stay_awake && bodies [ i ] >= m_awake ) {
+                sleep_time [ bodies [ i ] ] = 0.0f;
+            }
+        }
+    }
+
+    float* force_x = data ( s_force_x );
+    float* force_y = data ( s_force_y );
+    float* torque = data ( s_torque );
+
+    for ( unsigned int i = 0; i < m_awake; ++i ) {
+        if ( !m_stay_awake [ i ] ) {
+            settle_pose ( i );
+
+            velocity_x [ i ] = 0.0f;
+            velocity_y [ i ] = 0.0f;
+            angular_velocity [ i ] = 0.0f;
+            force_x [ i ] = 0.0f;
+            force_y [ i ] = 0.0f;
+            torque [ i ] = 0.0f;
+        }
+    }
+
+    // partition the awake bodies to the front, only the ones on the
+    // wrong side of the boundary move
+    unsigned int front = 0;
+    unsigned int back = count;
+
+    for ( ;; ) {
+        while ( front < back && m_stay_awake [ front ] ) {
+            front++;
+        }
+
+        while ( front < back && !m_stay_awake [ back - 1 ] ) {
+            back--;
+        }
+
+        if ( front >= back ) {
+            break;
+        }
+
+        swap_bodies ( front, back - 1 );
+        std::swap ( m_stay_awake [ front ], m_stay_awake [ back - 1 ] );
+    }
+
+    m_awake = front;
+
+    m_solver.remap ( *this );
+
+#ifdef RIGID_BODY_PROFILE
+    const float* inv_mass = data ( s_inv_mass );
+    unsigned int sleeping = 0;
+
+    for ( unsigned int i = m_awake; i < count; ++i ) {
+        sleeping += inv_mass [ i ] > 0.0f;
+    }
+
+    PROFILE_SET ( counter_sleeping_bodies, sleeping );
+#endif
+}
+
+void quad_world::set_bullet ( handle h, bool bullet )
+{
+    if ( alive ( h ) ) {
+        m_streams [ s_bullet ][ index ( h ) ] = bullet ? 1.0f : 0.0f;
+    }
+}
+
+void quad_world::sweep_bullets ( float dt )
+{
+    PROFILE_SCOPE ( "ccd" );
+
+    const float* bullet = data ( s_bullet );
+    const float* half_width = data ( s_half_width );
+    const float* half_height = data ( s_half_height );
+
+    float* velocity_x = data ( s_velocity_x );
+    float* velocity_y = data ( s_velocity_y );
+    float* angular_velocity = data ( s_angular_velocity );
+
+    float slop = m_solver.settings ( ).slop;
+
+    // where each body is now and how far it goes on the next step
+    auto sweep_of = [ this, dt ] ( unsigned int i ) {
+        box_sweep sweep;
+
+        sweep.center = vec2 { m_streams [ s_center_x ][ i ], m_streams [ s_center_y ][ i ] };
+        sweep.rotation = m_streams [ s_rotation ][ i ];
+        sweep.half_extents = vec2 { m_streams [ s_half_width ][ i ], m_streams [ s_half_height ][ i ] };
+        sweep.translation = vec2 { m_streams [ s_velocity_x ][ i ], m_streams [ s_velocity_y ][ i ] } * dt;
+        sweep.angle = m_streams [ s_angular_velocity ][ i ] * dt;
+
+        return sweep;
+    };
+
+    // bullets are rare, they are swept one after another so a bullet
+    // meeting another sees its final velocity
+    for ( unsigned int i = 0; i < m_awake; ++i ) {
+        if ( bullet [ i ] == 0.0f ) {
+            continue;
+        }
+
+        box_sweep sweep = sweep_of ( i );
+
+        float radius = sweep.half_extents.mag ( );
+        float motion = sweep.translation.mag ( ) + std::fabs ( sweep.angle ) * radius;
+
+        // the discrete test catches anything a slower body runs into
+        if ( motion <= std::min ( half_width [ i ], half_height [ i ] ) ) {
+            continue;
+        }
+
+        // the circle around the box covers it at any angle
+        vec2 end = sweep.center + sweep.translation;
+        aabb box;
+
+        box.min.set ( std::min ( sweep.center.x ( ), end.x ( ) ) - radius,
+                      std::min ( sweep.center.y ( ), end.y ( ) ) - radius );
+        box.max.set ( std::max ( sweep.center.x ( ), end.x ( ) ) + radius,
+                      std::max ( sweep.center.y ( ), end.y ( ) ) + radius );
+
+        m_query.clear ( );
+        m_broad_phase->query ( m_bounds.data ( ), size ( ), box, m_query );
+
+        float toi = 1.0f;
+
+        for ( unsigned int q = 0; q < m_query.size ( ); ++q ) {
+            unsigned int j = m_query [ q ];
+
+            if ( j == i || m_joints.filtered ( m_owners [ i ], m_owners [ j ] ) ) {
+                continue;
+            }
+
+            box_sweep other = sweep_of ( j );
+
+            // a bullet already overlapping is pushed out by the contact,
+            // it may only go a little deeper meanwhile
+            float target = std::min ( 0.0f, box_separation ( sweep, other, 0.0f ) ) - k_bullet_overlap * slop;
+
+            toi = std::min ( toi, box_time_of_impact ( sweep, other, target, k_bullet_tolerance * slop ) );
+        }
+
+        if ( toi < 1.0f ) {
+            velocity_x [ i ] *= toi;
+            velocity_y [ i ] *= toi;
+            angular_velocity [ i ] *= toi;
+        }
+
+        PROFILE_COUNT ( counter_bullets, 1 );
+    }
+}
+
+void quad_world::swap_bodies ( unsigned int a, unsigned int b )
+{
+    if ( a == b ) {
+        return;
+    }
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        std::swap ( m_streams [ i ][ a ], m_streams [ i ][ b ] );
+    }
+
+    std::swap ( m_owners [ a ], m_owners [ b ] );
+    m_slots [ m_owners [ a ] ].index = a;
+    m_slots [ m_owners [ b ] ].index = b;
+
+    if ( a < m_bounds.size ( ) && b < m_bounds.size ( ) ) {
+        std::swap ( m_bounds [ a ], m_bounds [ b ] );
+    }
+
+    m_broad_phase->swap ( a, b );
+}
+
+void quad_world::set_fixed_step ( float dt, unsigned int max_substeps )
+{
+    // a step of no time would never drain the accumulator, and the
+    // alpha after it would be nan. nan fails this too
+    if ( dt > 0.0f ) {
+        m_fixed_dt = dt;
+    }
+
+    m_max_substeps = std::max ( max_substeps, 1u );
+    m_accumulator = std::min ( m_accumulator, m_fixed_dt );
+}
+
+unsigned int quad_world::accumulate ( float frame_dt )
+{
+    // nan would stop the world for good, a negative time push the
+    // interpolation below zero and inf turn it into nan
+    if ( !std::isfinite ( frame_dt ) || frame_dt <= 0.0f ) {
+        return 0;
+    }
+
+    m_accumulator += frame_dt;
+
+    unsigned int steps = 0;
+
+    while ( m_accumulator >= m_fixed_dt && steps < m_max_substeps ) {
+        m_accumulator -= m_fixed_dt;
+        steps++;
+    }
+
+    // out of substeps, drop the whole steps we are behind by
+    if ( m_accumulator >= m_fixed_dt ) {
+        m_accumulator = std::fmod ( m_accumulator, m_fixed_dt );
+    }
+
+    return steps;
+}
+
+unsigned int quad_world::advance ( float frame_dt, float friction )
+{
+    unsigned int steps = accumulate ( frame_dt );
+
+    for ( unsigned int i = 0; i < steps; ++i ) {
+        step ( m_fixed_dt, friction );
+    }
+
+    return steps;
+}
+
+void quad_world::save_poses ( )
+{
+    // bodies asleep or static do not move, their previous pose was set
+    // to the current one when they stopped
+    std::copy ( data ( s_center_x ), data ( s_center_x ) + m_awake, data ( s_previous_x ) );
+    std::copy ( data ( s_center_y ), data ( s_center_y ) + m_awake, data ( s_previous_y ) );
+    std::copy ( data ( s_rotation ), data ( s_rotation ) + m_awake, data ( s_previous_rotation ) );
+}
+
+void quad_world::settle_pose ( unsigned int index )
+{
+    m_streams [ s_previous_x ][ index ] = m_streams [ s_center_x ][ index ];
+    m_streams [ s_previous_y ][ index ] = m_streams [ s_center_y ][ index ];
+    m_streams [ s_previous_rotation ][ index ] = m_streams [ s_rotation ][ index ];
+}
+
+void quad_world::interpolated_corners ( unsigned int index, vec2* out ) const
+{
+    float alpha = interpolation ( );
+
+    const float* center_x = data ( s_center_x );
+    const float* center_y = data ( s_center_y );
+    const float* rotation = data ( s_rotation );
+    const float* previous_x = data ( s_previous_x );
+    const float* previous_y = data ( s_previous_y );
+    const float* previous_rotation = data ( s_previous_rotation );
+
+    vec2 center { previous_x [ index ] + ( center_x [ index ] - previous_x [ index ] ) * alpha,
+                  previous_y [ index ] + ( center_y [ index ] - previous_y [ index ] ) * alpha };
+    float angle = previous_rotation [ index ] + ( rotation [ index ] - previous_rotation [ index ] ) * alpha;
+
+    float sin_rot = 0.0f;
+    float cos_rot = 0.0f;
+
+    fast_math::sincos ( angle, sin_rot, cos_rot );
+
+    float hw = data ( s_half_width ) [ index ];
+    float hh = data ( s_half_height ) [ index ];
+
+    // same winding as the cached corners
+    vec2 x_axis { hw * cos_rot, hw * sin_rot };
+    vec2 y_axis { -hh * sin_rot, hh * cos_rot };
+
+    out [ 0 ] = center - x_axis - y_axis;
+    out [ 1 ] = center + x_axis - y_axis;
+    out [ 2 ] = center + x_axis + y_axis;
+    out [ 3 ] = center - x_axis + y_axis;
+}
+
+unsigned int quad_world::interpolated_outline ( unsigned int index, vec2* out ) const
+{
+    shape_kind kind = static_cast<shape_kind> ( data ( s_shape ) [ index ] );
+
+    if ( kind == shape_box ) {
+        interpolated_corners ( index, out );
+        return rigid_quad_2d::k_num_corners;
+    }
+
+    float alpha = interpolation ( );
+
+    const float* previous_x = data ( s_previous_x );
+    const float* previous_y = data ( s_previous_y );
+    const float* previous_rotation = data ( s_previous_rotation );
+
+    vec2 center { previous_x [ index ] + ( data ( s_center_x ) [ index ] - previous_x [ index ] ) * alpha,
+                  previous_y [ index ] + ( data ( s_center_y ) [ index ] - previous_y [ index ] ) * alpha };
+    float angle = previous_rotation [ index ] + ( data ( s_rotation ) [ index ] - previous_rotation [ index ] ) * alpha;
+
+    float sin_rot = 0.0f;
+    float cos_rot = 0.0f;
+
+    if ( kind == shape_circle ) {
+        float radius = data ( s_half_width ) [ index ];
+        float step = 6.28318531f / k_max_outline;
+
+        for ( unsigned int p = 0; p < k_max_outline; ++p ) {
+            fast_math::sincos ( angle + step * p, sin_rot, cos_rot );
+            out [ p ] = center + vec2 { cos_rot, sin_rot } * radius;
+        }
+
+        return k_max_outline;
+    }
+
+    const convex_polygon& polygon = m_polygons [ static_cast<unsigned int> ( data ( s_polygon ) [ index ] ) ];
+
+    fast_math::sincos ( angle, sin_rot, cos_rot );
+
+    for ( unsigned int v = 0; v < polygon.count; ++v ) {
+        const vec2& p = polygon.vertices [ v ];
+
+        out [ v ] = center + vec2 { p.x ( ) * cos_rot - p.y ( ) * sin_rot, p.x ( ) * sin_rot + p.y ( ) * cos_rot };
+    }
+
+    return polygon.count;
+}
+
+void quad_world::update_corners ( )
+{
+    update_corners ( 0, size ( ) );
+}
+
+void quad_world::update_corners ( unsigned int first, unsigned int last )
+{
+    m_integrator.transform_corners ( *this, first, last );
+    m_bounds_stale = true;
+}
+
+void quad_world::set_simd_level ( simd_level level )
+{
+    m_integrator = quad_integrator { level };
+}
+
+const std::vector<body_pair>& quad_world::find_pairs ( )
+{
+    PROFILE_SCOPE ( "broad_phase" );
+
+    update_bounds ( );
+
+    m_broad_phase->find_pairs ( m_bounds.data ( ), size ( ), m_pairs );
+
+    return m_pairs;
+}
+
+void quad_world::set_broad_phase ( broad_phase_kind kind,
+                                   float cell_size )
+{
+    m_broad_phase_kind = kind;
+    m_cell_size = cell_size;
+
+    switch ( kind ) {
+        case broad_phase_sweep:
+            m_broad_phase.reset ( new sweep_and_prune { } );
+            break;
+        case broad_phase_tree:
+            m_broad_phase.reset ( new aabb_tree_broad_phase { } );
+            break;
+        default:
+            m_broad_phase.reset ( new spatial_hash_grid { cell_size } );
+            break;
+    }
+
+    m_broad_phase->set_thread_pool ( m_pool.get ( ) );
+}
+
+void quad_world::query ( const aabb& box, std::vector<handle>& out )
+{
+    update_bounds ( );
+
+    m_query.clear ( );
+    m_broad_phase->query ( m_bounds.data ( ), size ( ), box, m_query );
+
+    for ( unsigned int i = 0; i < m_query.size ( ); ++i ) {
+        out.push_back ( handle_at ( m_query [ i ] ) );
+    }
+}
+
+bool quad_world::ray_cast ( const vec2& from, const vec2& to, ray_hit& hit )
+{
+    update_bounds ( );
+
+    bool found = false;
+    vec2 delta = to - from;
+
+    const float* center_x = data ( s_center_x );
+    const float* center_y = data ( s_center_y );
+    const float* rotation = data ( s_rotation );
+    const float* half_width = data ( s_half_width );
+    const float* half_height = data ( s_half_height );
+    const float* shape = data ( s_shape );
+
+    auto callback = [ & ] ( unsigned int i, float max_fraction ) {
+        // circles and polygons have their own tests
+        if ( shape [ i ] != shape_box ) {
+            shape_instance instance;
+            float fraction = 0.0f;
+            vec2 normal;
+
+            shape_of ( i, instance );
+
+            bool entered = instance.kind == shape_circle ?
+                ray_circle ( from, delta, instance.center, instance.radius, max_fraction, fraction, normal ) :
+                ray_polygon ( from, delta, instance.vertices, instance.count, max_fraction, fraction, normal );
+
+            if ( !entered ) {
+                return max_fraction;
+            }
+
+            found = true;
+            hit.body = handle_at ( i );
+            hit.fraction = fraction;
+            hit.point = from + delta * fraction;
+            hit.normal = normal;
+
+            return fraction;
+        }
+
+        float sin_rot = 0.0f;
+        float cos_rot = 0.0f;
+
+        fast_math::sincos ( rotation [ i ], sin_rot, cos_rot );
+
+        // move the segment into the body's frame and slab test the box
+        float ox = from.x ( ) - center_x [ i ];
+        float oy = from.y ( ) - center_y [ i ];
+
+        float origin [ 2 ] = { ox * cos_rot + oy * sin_rot, oy * cos_rot - ox * sin_rot };
+        float dir [ 2 ] = { delta.x ( ) * cos_rot + delta.y ( ) * sin_rot,
+                            delta.y ( ) * cos_rot - delta.x ( ) * sin_rot };
+        float extent [ 2 ] = { half_width [ i ], half_height [ i ] };
+
+        float t_min = 0.0f;
+        float t_max = max_fraction;
+        int hit_axis = -1;
+        float hit_sign = 0.0f;
+
+        for ( int axis = 0; axis < 2; ++axis ) {
+            if ( dir [ axis ] == 0.0f ) {
+                if ( origin [ axis ] < -extent [ axis ] || origin [ axis ] > extent [ axis ] ) {
+                    return max_fraction;
+                }
+
+                continue;
+            }
+
+            float inv = 1.0f / dir [ axis ];
+            float t1 = ( -extent [ axis ] - origin [ axis ] ) * inv;
+            float t2 = ( extent [ axis ] - origin [ axis ] ) * inv;
+            float sign = -1.0f;
+
+            if ( t1 > t2 ) {
+                std::swap ( t1, t2 );
+                sign = 1.0f;
+            }
+
+            if ( t1 > t_min ) {
+                t_min = t1;
+                hit_axis = axis;
+                hit_sign = sign;
+            }
+
+            t_max = std::min ( t_max, t2 );
+
+            if ( t_min > t_max ) {
+                return max_fraction;
+            }
+        }
+
+        // started inside
+        if ( hit_axis < 0 ) {
+            return max_fraction;
+        }
+
+        float nx = hit_axis == 0 ? hit_sign : 0.0f;
+        float ny = hit_axis == 1 ? hit_sign : 0.0f;
+
+        found = true;
+        hit.body = handle_at ( i );
+        hit.fraction = t_min;
+        hit.point = from + delta * t_min;
+        hit.normal.set ( nx * cos_rot - ny * sin_rot, ny * cos_rot + nx * sin_rot );
+
+        return t_min;
+    };
+
+    m_broad_phase->ray_cast ( m_bounds.data ( ), size ( ), from, to, callback );
+
+    return found;
+}
+
+void quad_world::update_bounds ( )
+{
+    unsigned int count = size ( );
+
+    m_bounds.resize ( count );
+
+    // the bounds of sleeping and static bodies go along with them when
+    // they are swapped, only the awake ones can have moved since
+    bool all = m_bounds_stale;
+    unsigned int range = all ? count : m_awake;
+
+    m_bounds_stale = false;
+    m_updated = false;
+
+    m_pool->parallel_for ( range, k_body_grain, [ this, all ] ( unsigned int first, unsigned int last ) {
+        const float* x [ rigid_quad_2d::k_num_corners ];
+        const float* y [ rigid_quad_2d::k_num_corners ];
+
+        for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+            x [ c ] = corner_x ( c );
+            y [ c ] = corner_y ( c );
+        }
+
+        const float* center_x = data ( s_center_x );
+        const float* center_y = data ( s_center_y );
+        const float* rotation = data ( s_rotation );
+        const float* previous_x = data ( s_previous_x );
+        const float* previous_y = data ( s_previous_y );
+        const float* previous_rotation = data ( s_previous_rotation );
+        const float* half_width = data ( s_half_width );
+        const float* shape = data ( s_shape );
+
+        for ( unsigned int i = first; i < last; ++i ) {
+            if ( !all && center_x [ i ] == previous_x [ i ] && center_y [ i ] == previous_y [ i ] &&
+                 rotation [ i ] == previous_rotation [ i ] ) {
+                continue;
+            }
+
+            // the corners of a circle's box reach past it when turned
+            if ( shape [ i ] == shape_circle ) {
+                m_bounds [ i ].min.set ( center_x [ i ] - half_width [ i ], center_y [ i ] - half_width [ i ] );
+                m_bounds [ i ].max.set ( center_x [ i ] + half_width [ i ], center_y [ i ] + half_width [ i ] );
+                continue;
+            }
+
+            float min_x = std::min ( std::min ( x [ 0 ][ i ], x [ 1 ][ i ] ), std::min ( x [ 2 ][ i ], x [ 3 ][ i ] ) );
+            float max_x = std::max ( std::max ( x [ 0 ][ i ], x [ 1 ][ i ] ), std::max ( x [ 2 ][ i ], x [ 3 ][ i ] ) );
+            float min_y = std::min ( std::min ( y [ 0 ][ i ], y [ 1 ][ i ] ), std::min ( y [ 2 ][ i ], y [ 3 ][ i ] ) );
+            float max_y = std::max ( std::max ( y [ 0 ][ i ], y [ 1 ][ i ] ), std::max ( y [ 2 ][ i ], y [ 3 ][ i ] ) );
+
+            m_bounds [ i ].min.set ( min_x, min_y );
+            m_bounds [ i ].max.set ( max_x, max_y );
+        }
+    } );
+}
+
+void quad_world::collision ( handle a,
+                             handle b,
+                             rigid_quad_2d::collision_results& res ) const
+{
+    collision ( index ( a ), index ( b ), res );
+}
+
+void quad_world::collision ( unsigned int a,
+                             unsigned int b,
+                             rigid_quad_2d::collision_results& res ) const
+{
+    const float* shape = data ( s_shape );
+
+    if ( shape [ a ] == shape_box && shape [ b ] == shape_box ) {
+        vec2 a_corners [ rigid_quad_2d::k_num_corners ];
+        vec2 b_corners [ rigid_quad_2d::k_num_corners ];
+
+        corners ( a, a_corners );
+        corners ( b, b_corners );
+
+        rigid_quad_2d::collision ( a_corners, b_corners, res );
+        return;
+    }
+
+    // the other shapes answer from their manifold, the middle of its
+    // points and the deepest of them
+    contact_manifold manifold;
+
+    res.collided = collision ( a, b, manifold );
+
+    if ( !res.collided ) {
+        return;
+    }
+
+    res.normal = manifold.normal;
+    res.point = manifold.points [ 0 ].point;
+    res.depth = -manifold.points [ 0 ].separation;
+
+    if ( manifold.count > 1 ) {
+        res.point = ( res.point + manifold.points [ 1 ].point ) * 0.5f;
+        res.depth = std::max ( res.depth, -manifold.points [ 1 ].separation );
+    }
+}
+
+bool quad_world::collision ( unsigned int a,
+                             unsigned int b,
+                             contact_manifold& manifold ) const
+{
+    const float* shape = data ( s_shape );
+
+    // most pairs are boxes, their corners are cached and they need
+    // nothing else
+    if ( shape [ a ] == shape_box && shape [ b ] == shape_box ) {
+        vec2 a_corners [ rigid_quad_2d::k_num_corners ];
+        vec2 b_corners [ rigid_quad_2d::k_num_corners ];
+
+        corners ( a, a_corners );
+        corners ( b, b_corners );
+
+        return collide_boxes ( a_corners, b_corners, manifold );
+    }
+
+    shape_instance a_shape;
+    shape_instance b_shape;
+
+    shape_of ( a, a_shape );
+    shape_of ( b, b_shape );
+
+    return collide_shapes ( a_shape, b_shape, manifold );
+}
+
+void quad_world::shape_of ( unsigned int index, shape_instance& out ) const
+{
+    out.kind = static_cast<shape_kind> ( data ( s_shape ) [ index ] );
+    out.center.set ( data ( s_center_x ) [ index ], data ( s_center_y ) [ index ] );
+
+    switch ( out.kind ) {
+        case shape_circle:
+            out.count = 0;
+            out.radius = data ( s_half_width ) [ index ];
+            break;
+        case shape_polygon: {
+            const convex_polygon& polygon = m_polygons [ static_cast<unsigned int> ( data ( s_polygon ) [ index ] ) ];
+
+            float sin_rot = 0.0f;
+            float cos_rot = 0.0f;
+
+            fast_math::sincos ( data ( s_rotation ) [ index ], sin_rot, cos_rot );
+
+            out.count = polygon.count;
+            out.radius = polygon.radius;
+
+            for ( unsigned int v = 0; v < polygon.count; ++v ) {
+                const vec2& p = polygon.vertices [ v ];
+                const vec2& n = polygon.normals [ v ];
+
+                out.vertices [ v ].set ( out.center.x ( ) + p.x ( ) * cos_rot - p.y ( ) * sin_rot,
+                                         out.center.y ( ) + p.x ( ) * sin_rot + p.y ( ) * cos_rot );
+                out.normals [ v ].set ( n.x ( ) * cos_rot - n.y ( ) * sin_rot,
+                                        n.x ( ) * sin_rot + n.y ( ) * cos_rot );
+            }
+
+            break;
+        }
+        default: {
+            float sin_rot = 0.0f;
+            float cos_rot = 0.0f;
+
+            fast_math::sincos ( data ( s_rotation ) [ index ], sin_rot, cos_rot );
+
+            out.count = rigid_quad_2d::k_num_corners;
+            out.radius = 0.0f;
+            corners ( index, out.vertices );
+
+            // the edges run along the rotated axes, starting from the
+            // bottom edge of the winding
+            out.normals [ 0 ].set ( sin_rot, -cos_rot );
+            out.normals [ 1 ].set ( cos_rot, sin_rot );
+            out.normals [ 2 ].set ( -sin_rot, cos_rot );
+            out.normals [ 3 ].set ( -cos_rot, -sin_rot );
+            break;
+        }
+    }
+}
+
+void quad_world::corners ( unsigned int index, vec2* out ) const
+{
+    for ( unsigned int c = 0; c < rigid_quad_2d::k_num_corners; ++c ) {
+        out [ c ].set ( corner_x ( c ) [ index ], corner_y ( c ) [ index ] );
+    }
+}
+
+quad_world::quad_ref::quad_ref ( quad_world* world, handle h ) :
+    m_world { world },
+    m_handle { h }
+{
+
+}
+
+float& quad_world::quad_ref::field ( stream s ) const
+{
+    return m_world->m_streams [ s ][ m_world->index ( m_handle ) ];
+}
+
+void quad_world::quad_ref::wake ( const vec2& force ) const
+{
+    if ( force.x ( ) != 0.0f || force.y ( ) != 0.0f ) {
+        m_world->wake ( m_world->index ( m_handle ) );
+    }
+}
+
+void quad_world::quad_ref::push ( const vec2& force )
+{
+    wake ( force );
+
+    field ( s_force_x ) += force.x ( );
+    field ( s_force_y ) += force.y ( );
+}
+
+void quad_world::quad_ref::pull ( const vec2& force )
+{
+    wake ( force );
+
+    field ( s_force_x ) -= force.x ( );
+    field ( s_force_y ) -= force.y ( );
+}
+
+void quad_world::quad_ref::push ( const vec2& force,
+                                  const vec2& point )
+{
+    push ( force );
+    field ( s_torque ) += ( force.mag ( ) * center ( ).perp_dot ( point ) );
+}
+
+void quad_world::quad_ref::pull ( const vec2& force,
+                                  const vec2& point )
+{
+    pull ( force );
+    field ( s_torque ) -= ( force.mag ( ) * center ( ).perp_dot ( point ) );
+}
+
+void quad_world::quad_ref::impulse ( float impulse,
+                                     const vec2& normal )
+{
+    wake ( normal * impulse );
+
+    float scale = impulse * field ( s_inv_mass );
+
+    field ( s_velocity_x ) += normal.x ( ) * scale;
+    field ( s_velocity_y ) += normal.y ( ) * scale;
+}
+
+float quad_world::quad_ref::width ( ) const { return field ( s_half_width ) * 2.0f; }
+float quad_world::quad_ref::height ( ) const { return field ( s_half_height ) * 2.0f; }
+
+float quad_world::quad_ref::mass ( ) const { return field ( s_mass ); }
+float quad_world::quad_ref::inv_mass ( ) const { return field ( s_inv_mass ); }
+float quad_world::quad_ref::inertia ( ) const { return field ( s_inertia ); }
+float quad_world::quad_ref::rotation ( ) const { return field ( s_rotation ); }
+
+vec2 quad_world::quad_ref::center ( ) const
+{
+    return vec2 { field ( s_center_x ), field ( s_center_y ) };
+}
+
+vec2 quad_world::quad_ref::corner ( unsigned int index ) const
+{
+    unsigned int i = m_world->index ( m_handle );
+
+    return vec2 { m_world->corner_x ( index ) [ i ],
+                  m_world->corner_y ( index ) [ i ] };
+}
+
+vec2 quad_world::quad_ref::total_force ( ) const
+{
+    return vec2 { field ( s_force_x ), field ( s_force_y ) };
+}
+
+float quad_world::quad_ref::total_torque ( ) const { return field ( s_torque ); }
+
+vec2 quad_world::quad_ref::interpolated_center ( ) const
+{
+    float alpha = m_world->interpolation ( );
+
+    vec2 previous { field ( s_previous_x ), field ( s_previous_y ) };
+
+    return previous + ( center ( ) - previous ) * alpha;
+}
+
+float quad_world::quad_ref::interpolated_rotation ( ) const
+{
+    float previous = field ( s_previous_rotation );
+
+    return previous + ( rotation ( ) - previous ) * m_world->interpolation ( );
+}
+
+void quad_world::quad_ref::interpolated_corners ( vec2* out ) const
+{
+    m_world->interpolated_corners ( m_world->index ( m_handle ), out );
+}
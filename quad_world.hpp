@@ -0,0 +1,520 @@
+#ifndef QUAD_WORLD
+#define QUAD_WORLD
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "broad_phase.hpp"
+#include "contact_solver.hpp"
+#include "joint.hpp"
+#include "quad_integrator.hpp"
+#include "rigid_quad_2d.hpp"
+#include "shape_collision.hpp"
+#include "step_arena.hpp"
+#include "thread_pool.hpp"
+
+struct sleep_settings {
+    bool enabled;
+
+    // a body slower than these is resting
+    float linear_tolerance;
+    float angular_tolerance;
+
+    // how long every body in an island has to rest before it sleeps
+    float time_to_sleep;
+
+    sleep_settings ( ) :
+        enabled { true },
+        linear_tolerance { 0.01f },
+        angular_tolerance { 0.035f },
+        time_to_sleep { 0.5f }
+    {}
+};
+
+// milliseconds spent in each phase of the last step
+struct step_timings {
+    double integrate;
+    double broad_phase;
+    double narrow_phase;
+    double solve;
+    double sleep;
+    double total;
+};
+
+class snapshot_view;
+
+// quad_world stores its bodies as a structure of arrays, one contiguous
+// stream per field, so the per step passes only touch the fields they
+// need. a body is a box, a circle or a convex polygon, the half
+// extents of circles are their radius and those of polygons cover
+// them at any angle, so the corners stay a bound for every shape.
+// the corners and the sine and cosine of the rotation are cached
+// per body and only rebuilt when it moves or turns. bodies are
+// addressed through stable handles, the dense streams are kept
+// packed by moving the last body into the hole on destroy.
+// awake bodies are kept in front of sleeping and static ones so the
+// per step passes only run over the awake range.
+class quad_world {
+public:
+    struct handle {
+        unsigned int slot;
+        unsigned int generation;
+    };
+
+    // every per body field lives in its own stream
+    enum stream {
+        s_center_x,
+        s_center_y,
+        s_rotation,
+        s_velocity_x,
+        s_velocity_y,
+        s_angular_velocity,
+        s_force_x,
+        s_force_y,
+        s_torque,
+        s_inv_mass,
+        s_inv_inertia,
+        s_half_width,
+        s_half_height,
+        s_mass,
+        s_inertia,
+        s_previous_x,
+        s_previous_y,
+        s_previous_rotation,
+        s_sleep_time,
+        s_bullet,
+        s_shape,
+        s_polygon,
+        s_sin_rotation,
+        s_cos_rotation,
+        s_corner_x0,
+        s_corner_x1,
+        s_corner_x2,
+        s_corner_x3,
+        s_corner_y0,
+        s_corner_y1,
+        s_corner_y2,
+        s_corner_y3,
+        k_num_streams
+    };
+
+    class quad_ref;
+
+    struct ray_hit {
+        handle body;
+        vec2 point;
+        vec2 normal;
+        float fraction;
+    };
+
+    quad_world ( );
+
+    // a mass of zero or less makes a static body that never moves
+    handle create ( const vec2& center,
+                    float width,
+                    float height,
+                    float mass,
+                    float rotation = 0.0f );
+
+    // a circle is a box of half extents radius to everything but the
+    // narrow phase, ray casts and drawing
+    handle create_circle ( const vec2& center,
+                           float radius,
+                           float mass );
+
+    // polygon is from add_polygon, its centroid goes at center. returns
+    // a dead handle if it is not one of the world's polygons
+    handle create_polygon ( const vec2& center,
+                            unsigned int polygon,
+                            float mass,
+                            float rotation = 0.0f );
+
+    // one body for create_bodies. size is the width and height of a box
+    // or the radius of a circle in x, a polygon takes its size from the
+    // polygon. circles ignore the rotation
+    struct body_def {
+        shape_kind shape;
+        unsigned int polygon;
+        vec2 center;
+        vec2 size;
+        float mass;
+        float rotation;
+        bool bullet;
+    };
+
+    // create count bodies at once, the same as creating them one at a
+    // time in order but with every stream grown once and the corners
+    // transformed in one pass. the handles go to out if it is not null,
+    // dead for a def create_polygon would not take
+    void create_bodies ( const body_def* defs, unsigned int count, handle* out = nullptr );
+
+    void destroy ( handle h );
+    bool alive ( handle h ) const;
+
+    // a body's k_num_streams fields, one from each stream, to take it
+    // out of the world and put it back later exactly as it was. the
+    // restored body gets a new handle and goes in awake if awake is
+    // set and it is not static, asleep otherwise. its polygon has to
+    // still be in the world, which it is unless the world was loaded
+    void save_body ( handle h, float* fields ) const;
+    handle restore_body ( const float* fields, bool awake );
+
+    shape_kind shape ( handle h ) const { return static_cast<shape_kind> ( m_streams [ s_shape ][ index ( h ) ] ); }
+
+    // polygons are shared by every body made from them and kept until
+    // the world is loaded over, see make_polygon for what points are
+    // accepted. returns k_no_polygon if they are not
+    unsigned int add_polygon ( const vec2* points, unsigned int count );
+    unsigned int polygon_count ( ) const { return static_cast<unsigned int> ( m_polygons.size ( ) ); }
+    const convex_polygon& polygon ( unsigned int id ) const { return m_polygons [ id ]; }
+    const convex_polygon* polygons ( ) const { return m_polygons.data ( ); }
+
+    static const unsigned int k_no_polygon = ~0u;
+
+    // room for count bodies, and the contacts a pile of that many
+    // usually has, so the first steps do not grow anything
+    void reserve ( unsigned int count );
+    void clear ( );
+
+    // write every body, handle slot, setting and warm starting contact
+    // to a snapshot file in one pass, see snapshot.hpp
+    bool save ( const std::string& path ) const;
+
+    // replace the world with a snapshot, handles saved with it stay
+    // valid. returns false and leaves the world alone if the file is
+    // not a snapshot this build can read
+    bool load ( const std::string& path );
+    bool load ( const snapshot_view& view );
+
+    quad_ref get ( handle h );
+
+    // bodies [ 0, awake_count ) are awake, the rest are asleep or
+    // static. a body sleeps with its island once every body in it
+    // has rested for the time to sleep, and wakes when pushed, pulled
+    // or touched by an awake body
+    unsigned int awake_count ( ) const { return m_awake; }
+    bool awake ( handle h ) const { return index ( h ) < m_awake; }
+    void wake ( handle h );
+
+    sleep_settings& sleeping ( ) { return m_sleep; }
+
+    // a bullet that moves far enough in a step to pass through
+    // something is swept against the bodies in its way and stopped
+    // where it first touches one, instead of tunnelling. the sweep
+    // only runs for bullets moving that fast
+    void set_bullet ( handle h, bool bullet );
+    bool bullet ( handle h ) const { return m_streams [ s_bullet ][ index ( h ) ] != 0.0f; }
+
+    // update every awake body over time, decaying the force and
+    // torque with friction, same as rigid_quad_2d::update. the pose
+    // before is kept for interpolation, and only bodies that moved
+    // from it have their corners rebuilt
+    void update ( float dt, float friction );
+
+    // rebuild the cached corners of every body
+    void update_corners ( );
+
+    // full simulation step: update, apply gravity, find pairs and
+    // solve the contacts. the solved velocities move the bodies
+    // on the next step, cut short for bullets that would hit
+    // something on the way
+    void step ( float dt, float friction );
+
+    // physics runs at a fixed rate no matter the frame rate. time is
+    // banked in an accumulator and spent in whole steps, at most
+    // max_substeps per frame so a hitch cannot snowball, the rest
+    // of a long frame is dropped. a dt that is not above zero is
+    // ignored and max_substeps is at least one
+    void set_fixed_step ( float dt, unsigned int max_substeps = 8 );
+    float fixed_step ( ) const { return m_fixed_dt; }
+    unsigned int max_substeps ( ) const { return m_max_substeps; }
+
+    // bank frame_dt and return how many fixed steps are due, for
+    // callers that apply their own forces before every step. a frame_dt
+    // that is not finite and above zero banks nothing
+    unsigned int accumulate ( float frame_dt );
+
+    // accumulate then take the due steps, returns how many ran
+    unsigned int advance ( float frame_dt, float friction );
+
+    // how far the leftover time is into the next step, 0 to 1,
+    // used to blend the previous and current poses for rendering
+    float interpolation ( ) const { return m_accumulator / m_fixed_dt; }
+
+    void interpolated_corners ( unsigned int index, vec2* out ) const;
+
+    // the outline of any shape, corners or polygon vertices, or points
+    // around a circle. returns how many, at most k_max_outline
+    unsigned int interpolated_outline ( unsigned int index, vec2* out ) const;
+
+    static const unsigned int k_max_outline = 16;
+
+    const step_timings& timings ( ) const { return m_timings; }
+
+    void set_gravity ( const vec2& gravity ) { m_gravity = gravity; }
+    const vec2& gravity ( ) const { return m_gravity; }
+
+    solver_settings& solver ( ) { return m_solver.settings ( ); }
+    const std::vector<contact_constraint>& contacts ( ) const { return m_solver.contacts ( ); }
+
+    // joints between two bodies, see joint.hpp. both bodies wake up
+    // and a joint goes away with either of its bodies. returns a dead
+    // handle if a body is dead or both are the same
+    joint_handle create_joint ( handle a, handle b, const joint_def& def );
+
+    // a copy of a joint from joints ( ) put back between a and b, its
+    // anchors and warm starting impulses as they were
+    joint_handle restore_joint ( handle a, handle b, const joint_constraint& joint );
+    void destroy_joint ( joint_handle h );
+    bool alive ( joint_handle h ) const { return m_joints.alive ( h ); }
+
+    // retarget a joint's motor, waking its bodies
+    void set_motor_speed ( joint_handle h, float speed );
+    void set_motor_target ( joint_handle h, const vec2& linear_offset, float angular_offset );
+
+    joint_set& joints ( ) { return m_joints; }
+    const joint_set& joints ( ) const { return m_joints; }
+
+    // hash of the exact bits of every live body's pose and velocities,
+    // taken in slot order so it does not depend on sleeping or the
+    // dense order. two worlds fed the same inputs on deterministic
+    // builds match step for step
+    unsigned long long checksum ( ) const;
+
+    // threads used by step, counting the calling thread. 0 uses
+    // every hardware thread, 1 keeps everything on the caller.
+    // integration, bounds, the grid broad phase, the narrow phase
+    // and the contact islands are split between them
+    void set_threads ( unsigned int threads );
+    unsigned int threads ( ) const { return m_pool->size ( ); }
+    thread_pool& pool ( ) { return *m_pool; }
+
+    // scratch for the current step, emptied when the next one starts
+    step_arena& scratch ( ) { return m_scratch; }
+
+    // batch integration runs on the widest simd path the cpu
+    // supports unless a narrower one is asked for here
+    void set_simd_level ( simd_level level );
+    simd_level simd ( ) const { return m_integrator.level ( ); }
+
+    // recompute every body's bounds from its corners and return the
+    // candidate pairs from the broad phase, as dense indices
+    const std::vector<body_pair>& find_pairs ( );
+
+    // the pairs the last find_pairs returned, the ones the narrow phase
+    // tested in the last step. the dense indices are the ones from
+    // before the step put bodies to sleep or woke them, which moves
+    // bodies, as does adding, destroying or waking one since. they
+    // can name other bodies until find_pairs runs again
+    const std::vector<body_pair>& pairs ( ) const { return m_pairs; }
+
+    // cell_size is the grid's cell size, the other broad phases
+    // ignore it. the tree keeps its own fat margin
+    void set_broad_phase ( broad_phase_kind kind,
+                           float cell_size = 0.25f );
+    broad_phase_kind broad_phase_type ( ) const { return m_broad_phase_kind; }
+    float cell_size ( ) const { return m_cell_size; }
+
+    // pairs that started / stopped overlapping in the last find_pairs,
+    // only tracked by the tree broad phase
+    const std::vector<body_pair>& begun_pairs ( ) const { return m_broad_phase->begun_pairs ( ); }
+    const std::vector<body_pair>& ended_pairs ( ) const { return m_broad_phase->ended_pairs ( ); }
+
+    // bodies whose bounds overlap box, appended to out
+    void query ( const aabb& box, std::vector<handle>& out );
+
+    // closest body hit by the segment from -> to, rays starting
+    // inside a body ignore that body
+    bool ray_cast ( const vec2& from, const vec2& to, ray_hit& hit );
+
+    void collision ( handle a,
+                     handle b,
+                     rigid_quad_2d::collision_results& res ) const;
+    void collision ( unsigned int a,
+                     unsigned int b,
+                     rigid_quad_2d::collision_results& res ) const;
+    bool collision ( unsigned int a,
+                     unsigned int b,
+                     contact_manifold& manifold ) const;
+
+    // the dense index of a body moves when another body is destroyed,
+    // only hold on to it for the duration of a pass
+    inline unsigned int size ( ) const;
+    inline unsigned int index ( handle h ) const;
+    inline unsigned int slot_index ( unsigned int slot ) const;
+
+    // slots ever handed out, live or free. a slot is live when the
+    // body at its index is owned by it
+    unsigned int slot_count ( ) const { return static_cast<unsigned int> ( m_slots.size ( ) ); }
+    bool slot_live ( unsigned int slot ) const { return m_slots [ slot ].index < size ( ) && m_owners [ m_slots [ slot ].index ] == slot; }
+    inline handle handle_at ( unsigned int index ) const;
+
+    inline float* data ( stream s );
+    inline const float* data ( stream s ) const;
+
+    inline float* corner_x ( unsigned int corner );
+    inline float* corner_y ( unsigned int corner );
+    inline const float* corner_x ( unsigned int corner ) const;
+    inline const float* corner_y ( unsigned int corner ) const;
+
+    void corners ( unsigned int index, vec2* out ) const;
+
+    // the body's shape posed where it is now
+    void shape_of ( unsigned int index, shape_instance& out ) const;
+
+    // valid after find_pairs
+    const aabb& bounds ( unsigned int index ) const { return m_bounds [ index ]; }
+
+private:
+
+    handle insert ( const vec2& center,
+                    float half_width,
+                    float half_height,
+                    float mass,
+                    float inertia,
+                    float rotation,
+                    shape_kind shape,
+                    unsigned int polygon );
+
+    // set every field of the body at index, its streams already zeroed
+    void fill ( unsigned int index,
+                const vec2& center,
+                float half_width,
+                float half_height,
+                float mass,
+                float inertia,
+                float rotation,
+                shape_kind shape,
+                unsigned int polygon );
+
+    void update_corners ( unsigned int first, unsigned int last );
+    void update_bounds ( );
+    void save_poses ( );
+
+    // previous pose to the current one, for a body that stops moving
+    // and so is left out of save_poses
+    void settle_pose ( unsigned int index );
+
+    void wake ( unsigned int index );
+    void wake_joint ( joint_handle h );
+    void update_sleep ( float dt );
+    void sweep_bullets ( float dt );
+    void swap_bodies ( unsigned int a, unsigned int b );
+
+    struct slot {
+        unsigned int index;
+        unsigned int generation;
+    };
+
+    std::vector<slot> m_slots;
+    std::vector<unsigned int> m_free_slots;
+
+    // dense index back to the owning slot
+    std::vector<unsigned int> m_owners;
+
+    std::vector<float> m_streams [ k_num_streams ];
+
+    quad_integrator m_integrator;
+    std::unique_ptr<thread_pool> m_pool;
+    step_arena m_scratch;
+
+    broad_phase_kind m_broad_phase_kind;
+    float m_cell_size;
+    std::unique_ptr<broad_phase> m_broad_phase;
+
+    std::vector<aabb> m_bounds;
+
+    // set when bodies are added, removed or posed outside of a step,
+    // find_pairs then rebuilds every body's bounds rather than only
+    // those of the awake bodies that moved. the bounds can only tell
+    // moves from the last update, so two updates without find_pairs
+    // in between make them stale as well
+    bool m_bounds_stale;
+    bool m_updated;
+    std::vector<body_pair> m_pairs;
+    std::vector<unsigned int> m_query;
+
+    std::vector<convex_polygon> m_polygons;
+
+    vec2 m_gravity;
+    contact_solver m_solver;
+    joint_set m_joints;
+
+    unsigned int m_awake;
+    sleep_settings m_sleep;
+    std::vector<unsigned char> m_stay_awake;
+
+    step_timings m_timings;
+
+    float m_fixed_dt;
+    unsigned int m_max_substeps;
+    float m_accumulator;
+};
+
+// view over a single body in a quad_world, exposing the rigid_quad_2d api
+class quad_world::quad_ref {
+public:
+    quad_ref ( quad_world* world, handle h );
+
+    void push ( const vec2& force );
+    void pull ( const vec2& force );
+
+    void push ( const vec2& force,
+                const vec2& point );
+    void pull ( const vec2& force,
+                const vec2& point );
+
+    void impulse ( float impulse,
+                   const vec2& normal );
+
+    float width ( ) const;
+    float height ( ) const;
+
+    float mass ( ) const;
+    float inv_mass ( ) const;
+    float inertia ( ) const;
+    float rotation ( ) const;
+
+    vec2 center ( ) const;
+    vec2 corner ( unsigned int index ) const;
+    vec2 total_force ( ) const;
+    float total_torque ( ) const;
+
+    // pose blended between the last two steps by the world's interpolation
+    vec2 interpolated_center ( ) const;
+    float interpolated_rotation ( ) const;
+    void interpolated_corners ( vec2* out ) const;
+
+    handle id ( ) const { return m_handle; }
+
+private:
+
+    float& field ( stream s ) const;
+
+    // a body acted on with anything but zero wakes up
+    void wake ( const vec2& force ) const;
+
+    quad_world* m_world;
+    handle m_handle;
+};
+
+inline unsigned int quad_world::size ( ) const { return static_cast<unsigned int> ( m_owners.size ( ) ); }
+inline unsigned int quad_world::index ( handle h ) const { return m_slots [ h.slot ].index; }
+inline unsigned int quad_world::slot_index ( unsigned int slot ) const { return m_slots [ slot ].index; }
+
+inline quad_world::handle quad_world::handle_at ( unsigned int index ) const
+{
+    unsigned int s = m_owners [ index ];
+    return handle { s, m_slots [ s ].generation };
+}
+
+inline float* quad_world::data ( stream s ) { return m_streams [ s ].data ( ); }
+inline const float* quad_world::data ( stream s ) const { return m_streams [ s ].data ( ); }
+
+inline float* quad_world::corner_x ( unsigned int corner ) { return data ( static_cast<stream> ( s_corner_x0 + corner ) ); }
+inline float* quad_world::corner_y ( unsigned int corner ) { return data ( static_cast<stream> ( s_corner_y0 + corner ) ); }
+inline const float* quad_world::corner_x ( unsigned int corner ) const { return data ( static_cast<stream> ( s_corner_x0 + corner ) ); }
+inline const float* quad_world::corner_y ( unsigned int corner ) const { return data ( static_cast<stream> ( s_corner_y0 + corner ) ); }
+
+#endif
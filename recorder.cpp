@@ -0,0 +1,604 @@
+#include "recorder.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+    const char k_magic [ 4 ] = { 'R', 'B', 'Q', 'R' };
+    const unsigned int k_version = 1;
+
+    // center x, center y, rotation, velocity x, velocity y, angular velocity
+    const unsigned int k_values_per_body = 6;
+
+    const unsigned char k_key_flag = 1;
+
+    void put_varint ( std::vector<unsigned char>& out, unsigned long long v )
+    {
+        while ( v >= 0x80 ) {
+            out.push_back ( static_cast<unsigned char> ( v | 0x80 ) );
+            v >>= 7;
+        }
+
+        out.push_back ( static_cast<unsigned char> ( v ) );
+    }
+
+    // small magnitudes of either sign become small unsigned numbers
+    void put_signed ( std::vector<unsigned char>& out, long long v )
+    {
+        put_varint ( out, ( static_cast<unsigned long long> ( v ) << 1 ) ^ static_cast<unsigned long long> ( v >> 63 ) );
+    }
+
+    void put_float ( std::vector<unsigned char>& out, float v )
+    {
+        unsigned char bytes [ sizeof ( float ) ];
+        std::memcpy ( bytes, &v, sizeof ( float ) );
+        out.insert ( out.end ( ), bytes, bytes + sizeof ( float ) );
+    }
+
+    // reads from a bounded buffer, any read past the end marks it failed
+    struct reader {
+        const unsigned char* at;
+        const unsigned char* end;
+        bool failed;
+
+        unsigned long long varint ( )
+        {
+            unsigned long long v = 0;
+
+            for ( unsigned int shift = 0; shift < 64; shift += 7 ) {
+                if ( at == end ) {
+                    break;
+                }
+
+                unsigned char b = *at++;
+                v |= static_cast<unsigned long long> ( b & 0x7f ) << shift;
+
+                if ( !( b & 0x80 ) ) {
+                    return v;
+                }
+            }
+
+            failed = true;
+            return 0;
+        }
+
+        long long signed_varint ( )
+        {
+            unsigned long long v = varint ( );
+            return static_cast<long long> ( v >> 1 ) ^ -static_cast<long long> ( v & 1 );
+        }
+
+        float real ( )
+        {
+            float v = 0.0f;
+
+            if ( end - at < static_cast<long> ( sizeof ( float ) ) ) {
+                failed = true;
+                return v;
+            }
+
+            std::memcpy ( &v, at, sizeof ( float ) );
+            at += sizeof ( float );
+
+            return v;
+        }
+    };
+
+    long long quantize ( float v, float precision )
+    {
+        if ( !std::isfinite ( v ) ) {
+            return 0;
+        }
+
+        return std::llround ( static_cast<double> ( v ) / precision );
+    }
+
+    float dequantize ( long long q, float precision )
+    {
+        return static_cast<float> ( static_cast<double> ( q ) * precision );
+    }
+
+}
+
+void recorded_frame::clear ( )
+{
+    slots.clear ( );
+    center_x.clear ( );
+    center_y.clear ( );
+    rotation.clear ( );
+    velocity_x.clear ( );
+    velocity_y.clear ( );
+    angular_velocity.clear ( );
+    inputs.clear ( );
+}
+
+recorder::recorder ( ) :
+    m_head { 0 },
+    m_count { 0 },
+    m_stop { false },
+    m_step { 0 },
+    m_dropped { 0 },
+    m_gap { false },
+    m_since_key { 0 },
+    m_written { 0 }
+{
+
+}
+
+recorder::~recorder ( )
+{
+    close ( );
+}
+
+bool recorder::open ( const std::string& path,
+                      const recorder_settings& settings )
+{
+    close ( );
+
+    m_out.open ( path, std::ios::binary | std::ios::trunc );
+
+    if ( !m_out ) {
+        return false;
+    }
+
+    m_settings = settings;
+
+    if ( m_settings.buffered_frames == 0 ) {
+        m_settings.buffered_frames = 1;
+    }
+
+    recording_header h;
+    std::memset ( &h, 0, sizeof ( h ) );
+
+    std::memcpy ( h.magic, k_magic, sizeof ( k_magic ) );
+    h.version = k_version;
+    h.header_size = sizeof ( recording_header );
+    h.keyframe_interval = m_settings.keyframe_interval;
+    h.position_precision = m_settings.position_precision;
+    h.rotation_precision = m_settings.rotation_precision;
+    h.velocity_precision = m_settings.velocity_precision;
+    h.angular_precision = m_settings.angular_precision;
+
+    m_out.write ( reinterpret_cast<const char*> ( &h ), sizeof ( h ) );
+
+    m_frames.resize ( m_settings.buffered_frames );
+    m_head = 0;
+    m_count = 0;
+    m_stop = false;
+
+    m_inputs.clear ( );
+    m_step = 0;
+    m_dropped = 0;
+    m_gap = false;
+
+    m_previous_slots.clear ( );
+    m_since_key = 0;
+    m_written = sizeof ( h );
+
+    m_writer = std::thread { &recorder::write, this };
+
+    return true;
+}
+
+void recorder::close ( )
+{
+    if ( !m_writer.joinable ( ) ) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock ( m_mutex );
+        m_stop = true;
+    }
+
+    m_ready.notify_all ( );
+    m_writer.join ( );
+
+    m_out.close ( );
+}
+
+void recorder::input ( const quad_world& world, quad_world::handle body, const vec2& force )
+{
+    if ( recording ( ) && world.alive ( body ) ) {
+        m_inputs.push_back ( recorded_input { body.slot, force } );
+    }
+}
+
+void recorder::record ( const quad_world& world )
+{
+    if ( !recording ( ) ) {
+        return;
+    }
+
+    unsigned int tail = 0;
+
+    {
+        std::lock_guard<std::mutex> lock ( m_mutex );
+
+        // the writer is behind, lose this frame rather than wait
+        if ( m_count == m_frames.size ( ) ) {
+            m_dropped++;
+            m_step++;
+            m_gap = true;
+            m_inputs.clear ( );
+
+            return;
+        }
+
+        tail = ( m_head + m_count ) % static_cast<unsigned int> ( m_frames.size ( ) );
+    }
+
+    // the writer does not touch the tail until it is counted
+    recorded_frame& frame = m_frames [ tail ];
+
+    frame.clear ( );
+    frame.step = m_step++;
+    frame.key = m_gap;
+    frame.inputs.swap ( m_inputs );
+
+    m_gap = false;
+
+    const float* center_x = world.data ( quad_world::s_center_x );
+    const float* center_y = world.data ( quad_world::s_center_y );
+    const float* rotation = world.data ( quad_world::s_rotation );
+    const float* velocity_x = world.data ( quad_world::s_velocity_x );
+    const float* velocity_y = world.data ( quad_world::s_velocity_y );
+    const float* angular_velocity = world.data ( quad_world::s_angular_velocity );
+
+    unsigned int bodies = world.size ( );
+
+    frame.slots.resize ( bodies );
+    frame.center_x.resize ( bodies );
+    frame.center_y.resize ( bodies );
+    frame.rotation.resize ( bodies );
+    frame.velocity_x.resize ( bodies );
+    frame.velocity_y.resize ( bodies );
+    frame.angular_velocity.resize ( bodies );
+
+    // walk the slots rather than the dense order, which sleeping and
+    // destroying shuffle, so a body keeps its place between frames
+    unsigned int n = 0;
+
+    for ( unsigned int s = 0; s < world.slot_count ( ); ++s ) {
+        if ( !world.slot_live ( s ) ) {
+            continue;
+        }
+
+        unsigned int i = world.slot_index ( s );
+
+        frame.slots [ n ] = s;
+        frame.center_x [ n ] = center_x [ i ];
+        frame.center_y [ n ] = center_y [ i ];
+        frame.rotation [ n ] = rotation [ i ];
+        frame.velocity_x [ n ] = velocity_x [ i ];
+        frame.velocity_y [ n ] = velocity_y [ i ];
+        frame.angular_velocity [ n ] = angular_velocity [ i ];
+        n++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock ( m_mutex );
+        m_count++;
+    }
+
+    m_ready.notify_one ( );
+}
+
+void recorder::write ( )
+{
+    for ( ;; ) {
+        unsigned int head = 0;
+
+        {
+            std::unique_lock<std::mutex> lock ( m_mutex );
+
+            m_ready.wait ( lock, [ this ] { return m_stop || m_count > 0; } );
+
+            // drain before stopping
+            if ( m_count == 0 ) {
+                return;
+            }
+
+            head = m_head;
+        }
+
+        encode ( m_frames [ head ] );
+
+        m_out.write ( reinterpret_cast<const char*> ( m_bytes.data ( ) ), static_cast<std::streamsize> ( m_bytes.size ( ) ) );
+        m_written += m_bytes.size ( );
+
+        {
+            std::lock_guard<std::mutex> lock ( m_mutex );
+
+            m_head = ( m_head + 1 ) % static_cast<unsigned int> ( m_frames.size ( ) );
+            m_count--;
+        }
+    }
+}
+
+void recorder::encode ( const recorded_frame& frame )
+{
+    unsigned int bodies = frame.size ( );
+
+    bool key = frame.key ||
+               m_since_key == 0 ||
+               m_since_key >= m_settings.keyframe_interval ||
+               frame.slots != m_previous_slots;
+
+    m_since_key = key ? 1 : m_since_key + 1;
+
+    m_current.resize ( bodies * k_values_per_body );
+
+    for ( unsigned int i = 0; i < bodies; ++i ) {
+        long long* q = &m_current [ i * k_values_per_body ];
+
+        q [ 0 ] = quantize ( frame.center_x [ i ], m_settings.position_precision );
+        q [ 1 ] = quantize ( frame.center_y [ i ], m_settings.position_precision );
+        q [ 2 ] = quantize ( frame.rotation [ i ], m_settings.rotation_precision );
+        q [ 3 ] = quantize ( frame.velocity_x [ i ], m_settings.velocity_precision );
+        q [ 4 ] = quantize ( frame.velocity_y [ i ], m_settings.velocity_precision );
+        q [ 5 ] = quantize ( frame.angular_velocity [ i ], m_settings.angular_precision );
+    }
+
+    // the payload goes after its length, which is only known at the end
+    std::vector<unsigned char>& out = m_bytes;
+    out.clear ( );
+
+    out.push_back ( key ? k_key_flag : 0 );
+    put_varint ( out, frame.step );
+    put_varint ( out, bodies );
+
+    if ( key ) {
+        unsigned int previous = 0;
+
+        for ( unsigned int i = 0; i < bodies; ++i ) {
+            put_varint ( out, frame.slots [ i ] - previous );
+            previous = frame.slots [ i ];
+        }
+
+        for ( unsigned int i = 0; i < m_current.size ( ); ++i ) {
+            put_signed ( out, m_current [ i ] );
+        }
+    } else {
+        for ( unsigned int i = 0; i < m_current.size ( ); ++i ) {
+            put_signed ( out, m_current [ i ] - m_previous [ i ] );
+        }
+    }
+
+    put_varint ( out, frame.inputs.size ( ) );
+
+    for ( const recorded_input& in : frame.inputs ) {
+        put_varint ( out, in.slot );
+        put_float ( out, in.force.x ( ) );
+        put_float ( out, in.force.y ( ) );
+    }
+
+    unsigned char length [ 10 ];
+    unsigned int length_size = 0;
+    unsigned long long payload = out.size ( );
+
+    do {
+        length [ length_size++ ] = static_cast<unsigned char> ( ( payload & 0x7f ) | ( payload >= 0x80 ? 0x80 : 0 ) );
+        payload >>= 7;
+    } while ( payload );
+
+    out.insert ( out.begin ( ), length, length + length_size );
+
+    m_previous.swap ( m_current );
+
+    if ( key ) {
+        m_previous_slots = frame.slots;
+    }
+}
+
+replayer::replayer ( ) :
+    m_next { 0 }
+{
+    std::memset ( &m_header, 0, sizeof ( m_header ) );
+}
+
+bool replayer::open ( const std::string& path )
+{
+    std::ifstream in { path, std::ios::binary };
+
+    if ( !in ) {
+        return false;
+    }
+
+    m_data.assign ( std::istreambuf_iterator<char> { in }, std::istreambuf_iterator<char> { } );
+
+    if ( m_data.size ( ) < sizeof ( recording_header ) ) {
+        return false;
+    }
+
+    std::memcpy ( &m_header, m_data.data ( ), sizeof ( m_header ) );
+
+    if ( std::memcmp ( m_header.magic, k_magic, sizeof ( k_magic ) ) != 0 ||
+         m_header.version != k_version ||
+         m_header.header_size != sizeof ( recording_header ) ) {
+        return false;
+    }
+
+    // index the frames, a recording cut off mid frame ends before it
+    m_frame_offsets.clear ( );
+    m_frame_steps.clear ( );
+    m_key_frames.clear ( );
+
+    size_t offset = sizeof ( recording_header );
+
+    while ( offset < m_data.size ( ) ) {
+        reader r { m_data.data ( ) + offset, m_data.data ( ) + m_data.size ( ), false };
+
+        unsigned long long length = r.varint ( );
+        size_t payload = static_cast<size_t> ( r.at - m_data.data ( ) );
+
+        if ( r.failed || length < 1 || length > m_data.size ( ) - payload ) {
+            break;
+        }
+
+        unsigned char flags = *r.at++;
+        unsigned long long step = r.varint ( );
+
+        if ( r.failed ) {
+            break;
+        }
+
+        m_frame_offsets.push_back ( offset );
+        m_frame_steps.push_back ( step );
+        m_key_frames.push_back ( flags & k_key_flag );
+
+        offset = payload + static_cast<size_t> ( length );
+    }
+
+    rewind ( );
+
+    return true;
+}
+
+bool replayer::next ( )
+{
+    if ( m_next >= m_frame_offsets.size ( ) ) {
+        return false;
+    }
+
+    return decode ( m_next++ );
+}
+
+bool replayer::seek ( unsigned long long step )
+{
+    unsigned int target = 0;
+
+    while ( target < m_frame_steps.size ( ) && m_frame_steps [ target ] < step ) {
+        target++;
+    }
+
+    if ( target == m_frame_steps.size ( ) ) {
+        return false;
+    }
+
+    // decode forward from the key frame at or before it
+    unsigned int start = target;
+
+    while ( start > 0 && !m_key_frames [ start ] ) {
+        start--;
+    }
+
+    for ( m_next = start; m_next <= target; ) {
+        if ( !next ( ) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void replayer::rewind ( )
+{
+    m_next = 0;
+    m_frame.clear ( );
+    m_values.clear ( );
+}
+
+bool replayer::decode ( unsigned int index )
+{
+    const unsigned char* begin = m_data.data ( ) + m_frame_offsets [ index ];
+    reader r { begin, m_data.data ( ) + m_data.size ( ), false };
+
+    unsigned long long length = r.varint ( );
+    r.end = r.at + length;
+
+    bool key = ( *r.at++ & k_key_flag ) != 0;
+
+    m_frame.step = r.varint ( );
+    m_frame.key = key;
+
+    unsigned long long bodies = r.varint ( );
+
+    // a delta frame carries on from the frame before it
+    if ( r.failed || bodies > length || ( !key && bodies != m_frame.slots.size ( ) ) ) {
+        return false;
+    }
+
+    if ( key ) {
+        m_frame.slots.resize ( bodies );
+
+        unsigned int slot = 0;
+
+        for ( unsigned int i = 0; i < bodies; ++i ) {
+            slot += static_cast<unsigned int> ( r.varint ( ) );
+            m_frame.slots [ i ] = slot;
+        }
+
+        m_values.assign ( bodies * k_values_per_body, 0 );
+    }
+
+    for ( unsigned int i = 0; i < m_values.size ( ); ++i ) {
+        m_values [ i ] += r.signed_varint ( );
+    }
+
+    m_frame.center_x.resize ( bodies );
+    m_frame.center_y.resize ( bodies );
+    m_frame.rotation.resize ( bodies );
+    m_frame.velocity_x.resize ( bodies );
+    m_frame.velocity_y.resize ( bodies );
+    m_frame.angular_velocity.resize ( bodies );
+
+    for ( unsigned int i = 0; i < bodies; ++i ) {
+        const long long* q = &m_values [ i * k_values_per_body ];
+
+        m_frame.center_x [ i ] = dequantize ( q [ 0 ], m_header.position_precision );
+        m_frame.center_y [ i ] = dequantize ( q [ 1 ], m_header.position_precision );
+        m_frame.rotation [ i ] = dequantize ( q [ 2 ], m_header.rotation_precision );
+        m_frame.velocity_x [ i ] = dequantize ( q [ 3 ], m_header.velocity_precision );
+        m_frame.velocity_y [ i ] = dequantize ( q [ 4 ], m_header.velocity_precision );
+        m_frame.angular_velocity [ i ] = dequantize ( q [ 5 ], m_header.angular_precision );
+    }
+
+    unsigned long long inputs = r.varint ( );
+
+    m_frame.inputs.clear ( );
+
+    for ( unsigned long long i = 0; i < inputs && !r.failed; ++i ) {
+        unsigned int slot = static_cast<unsigned int> ( r.varint ( ) );
+        float x = r.real ( );
+        float y = r.real ( );
+
+        m_frame.inputs.push_back ( recorded_input { slot, vec2 { x, y } } );
+    }
+
+    return !r.failed;
+}
+
+void replayer::apply ( quad_world& world ) const
+{
+    float* center_x = world.data ( quad_world::s_center_x );
+    float* center_y = world.data ( quad_world::s_center_y );
+    float* rotation = world.data ( quad_world::s_rotation );
+    float* velocity_x = world.data ( quad_world::s_velocity_x );
+    float* velocity_y = world.data ( quad_world::s_velocity_y );
+    float* angular_velocity = world.data ( quad_world::s_angular_velocity );
+    float* previous_x = world.data ( quad_world::s_previous_x );
+    float* previous_y = world.data ( quad_world::s_previous_y );
+    float* previous_rotation = world.data ( quad_world::s_previous_rotation );
+
+    for ( unsigned int i = 0; i < m_frame.size ( ); ++i ) {
+        unsigned int s = m_frame.slots [ i ];
+
+        if ( s >= world.slot_count ( ) || !world.slot_live ( s ) ) {
+            continue;
+        }
+
+        unsigned int b = world.slot_index ( s );
+
+        center_x [ b ] = previous_x [ b ] = m_frame.center_x [ i ];
+        center_y [ b ] = previous_y [ b ] = m_frame.center_y [ i ];
+        rotation [ b ] = previous_rotation [ b ] = m_frame.rotation [ i ];
+        velocity_x [ b ] = m_frame.velocity_x [ i ];
+        velocity_y [ b ] = m_frame.velocity_y [ i ];
+        angular_velocity [ b ] = m_frame.angular_velocity [ i ];
+    }
+
+    world.update_corners ( );
+}
@@ -0,0 +1,196 @@
+#ifndef RECORDER
+#define RECORDER
+
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "quad_world.hpp"
+
+// recordings are a header followed by one frame per recorded step.
+// every frame holds each live body's center, rotation and velocities,
+// quantized to fixed precision and stored as the difference from the
+// same body in the frame before as zigzag varints, so a body at rest
+// costs six bytes. a key frame stores the values themselves and the
+// slot of every body, one is written every keyframe_interval frames,
+// whenever bodies come or go and after frames were dropped. the forces
+// the caller fed in before the step are kept exactly, as floats.
+struct recording_header {
+    char magic [ 4 ];
+    unsigned int version;
+    unsigned int header_size;
+    unsigned int keyframe_interval;
+
+    // quantization steps, in metres, radians, metres and radians per second
+    float position_precision;
+    float rotation_precision;
+    float velocity_precision;
+    float angular_precision;
+};
+
+struct recorder_settings {
+    unsigned int keyframe_interval;
+
+    // frames waiting for the writer, more than this are dropped
+    unsigned int buffered_frames;
+
+    float position_precision;
+    float rotation_precision;
+    float velocity_precision;
+    float angular_precision;
+
+    recorder_settings ( ) :
+        keyframe_interval { 60 },
+        buffered_frames { 16 },
+        position_precision { 0.0001f },
+        rotation_precision { 0.0001f },
+        velocity_precision { 0.0001f },
+        angular_precision { 0.0001f }
+    {}
+};
+
+// a force fed to a body before a step
+struct recorded_input {
+    unsigned int slot;
+    vec2 force;
+};
+
+// one step of bodies ordered by slot and the inputs that went into it
+struct recorded_frame {
+    unsigned long long step;
+
+    // stored as a key frame, or has to be because frames before it
+    // were dropped
+    bool key;
+
+    std::vector<unsigned int> slots;
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> rotation;
+    std::vector<float> velocity_x;
+    std::vector<float> velocity_y;
+    std::vector<float> angular_velocity;
+
+    std::vector<recorded_input> inputs;
+
+    unsigned int size ( ) const { return static_cast<unsigned int> ( slots.size ( ) ); }
+    void clear ( );
+};
+
+// records a world step by step to disk. record copies the bodies into
+// a buffered frame and returns, a writer thread encodes and writes it.
+// when the writer falls behind by buffered_frames the newest frames
+// are dropped rather than stalling the step, the next one kept is a
+// key frame. the buffers are reused so recording allocates nothing
+// once the world stops growing.
+class recorder {
+public:
+    recorder ( );
+    ~recorder ( );
+
+    recorder ( const recorder& ) = delete;
+    recorder& operator= ( const recorder& ) = delete;
+
+    // returns false if the file cannot be created
+    bool open ( const std::string& path,
+                const recorder_settings& settings = recorder_settings { } );
+
+    // write out what is buffered and stop the writer
+    void close ( );
+
+    bool recording ( ) const { return m_writer.joinable ( ); }
+
+    // note a force given to body for the step about to be taken
+    void input ( const quad_world& world, quad_world::handle body, const vec2& force );
+
+    // capture the world after a step along with the inputs since the
+    // last capture
+    void record ( const quad_world& world );
+
+    unsigned long long frames ( ) const { return m_step; }
+    unsigned long long dropped ( ) const { return m_dropped; }
+
+    unsigned long long bytes_written ( ) const { return m_written.load ( ); }
+
+private:
+
+    void write ( );
+    void encode ( const recorded_frame& frame );
+
+    recorder_settings m_settings;
+    std::ofstream m_out;
+    std::thread m_writer;
+
+    // ring of frames between the stepping thread and the writer
+    std::vector<recorded_frame> m_frames;
+    unsigned int m_head;
+    unsigned int m_count;
+    bool m_stop;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+
+    // stepping thread only
+    std::vector<recorded_input> m_inputs;
+    unsigned long long m_step;
+    unsigned long long m_dropped;
+    bool m_gap;
+
+    // writer thread only, the last frame written quantized
+    std::vector<unsigned int> m_previous_slots;
+    std::vector<long long> m_previous;
+    std::vector<long long> m_current;
+    std::vector<unsigned char> m_bytes;
+    unsigned int m_since_key;
+    std::atomic<unsigned long long> m_written;
+};
+
+// reads a recording back a frame at a time, no simulation involved
+class replayer {
+public:
+    replayer ( );
+
+    // reads the whole file, returns false if it is not a recording
+    bool open ( const std::string& path );
+
+    // decode the next frame, false at the end of the recording
+    bool next ( );
+
+    // jump to the first frame at or after step
+    bool seek ( unsigned long long step );
+
+    void rewind ( );
+
+    const recording_header& header ( ) const { return m_header; }
+    const recorded_frame& frame ( ) const { return m_frame; }
+
+    // frames in the recording, counted on open
+    unsigned int frame_count ( ) const { return static_cast<unsigned int> ( m_frame_offsets.size ( ) ); }
+
+    // pose the bodies of world that share a slot with the current
+    // frame and give them its velocities. the previous pose matches so
+    // interpolation shows the frame as is
+    void apply ( quad_world& world ) const;
+
+private:
+
+    bool decode ( unsigned int index );
+
+    recording_header m_header;
+    std::vector<unsigned char> m_data;
+
+    // start, step and key flag of every frame
+    std::vector<size_t> m_frame_offsets;
+    std::vector<unsigned long long> m_frame_steps;
+    std::vector<unsigned char> m_key_frames;
+    unsigned int m_next;
+
+    recorded_frame m_frame;
+    std::vector<long long> m_values;
+};
+
+#endif
@@ -0,0 +1,441 @@
+#include "region_streamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <type_traits>
+
+#include <sys/stat.h>
+
+namespace {
+
+    const char k_magic [ 4 ] = { 'R', 'B', 'R', 'G' };
+    const unsigned int k_byte_order = 0x01020304u;
+
+    const unsigned int k_not_leaving = ~0u;
+
+    static_assert ( std::is_trivially_copyable<region_body>::value,
+                    "bodies are written as raw memory" );
+    static_assert ( std::is_trivially_copyable<region_joint>::value,
+                    "joints are written as raw memory" );
+
+    // squared distance from point to the nearest point of the box
+    float distance2 ( const vec2& point, float min_x, float min_y, float max_x, float max_y )
+    {
+        float dx = std::max ( std::max ( min_x - point.x ( ), point.x ( ) - max_x ), 0.0f );
+        float dy = std::max ( std::max ( min_y - point.y ( ), point.y ( ) - max_y ), 0.0f );
+
+        return dx * dx + dy * dy;
+    }
+
+}
+
+region_streamer::region_streamer ( quad_world& world, const region_settings& settings ) :
+    m_world ( world ),
+    m_settings ( settings )
+{
+    // already being there is fine, failing shows up when writing
+    ::mkdir ( m_settings.directory.c_str ( ), 0755 );
+}
+
+bool region_streamer::update ( )
+{
+    if ( m_points.empty ( ) ) {
+        return true;
+    }
+
+    freeze_strays ( );
+
+    bool ok = true;
+
+    for ( auto it = m_regions.begin ( ); it != m_regions.end ( ); ) {
+        region& r = it->second;
+        region_state state = wanted ( r.x, r.y );
+
+        if ( state == region_active ) {
+            if ( r.state == region_paged && !read ( r ) ) {
+                ok = false;
+                ++it;
+                continue;
+            }
+
+            // active regions hold nothing, their bodies are the world's
+            thaw ( r );
+            it = m_regions.erase ( it );
+            continue;
+        }
+
+        if ( state == region_frozen && r.state == region_paged ) {
+            if ( read ( r ) ) {
+                r.state = region_frozen;
+            } else {
+                ok = false;
+            }
+        } else if ( state == region_paged && ( r.state == region_frozen || !r.bodies.empty ( ) ) ) {
+            ok = write ( r ) && ok;
+        }
+
+        ++it;
+    }
+
+    return ok;
+}
+
+void region_streamer::region_of ( const vec2& point, int& x, int& y ) const
+{
+    x = static_cast<int> ( std::floor ( point.x ( ) / m_settings.region_size ) );
+    y = static_cast<int> ( std::floor ( point.y ( ) / m_settings.region_size ) );
+}
+
+region_state region_streamer::state ( int x, int y ) const
+{
+    auto it = m_regions.find ( key ( x, y ) );
+
+    return it == m_regions.end ( ) ? region_active : it->second.state;
+}
+
+unsigned int region_streamer::frozen_bodies ( ) const
+{
+    unsigned int count = 0;
+
+    for ( const auto& entry : m_regions ) {
+        if ( entry.second.state == region_frozen ) {
+            count += static_cast<unsigned int> ( entry.second.bodies.size ( ) );
+        }
+    }
+
+    return count;
+}
+
+unsigned int region_streamer::paged_bodies ( ) const
+{
+    unsigned int count = 0;
+
+    for ( const auto& entry : m_regions ) {
+        if ( entry.second.state == region_paged ) {
+            count += entry.second.paged + static_cast<unsigned int> ( entry.second.bodies.size ( ) );
+        }
+    }
+
+    return count;
+}
+
+unsigned int region_streamer::frozen_regions ( ) const
+{
+    unsigned int count = 0;
+
+    for ( const auto& entry : m_regions ) {
+        count += entry.second.state == region_frozen ? 1 : 0;
+    }
+
+    return count;
+}
+
+unsigned int region_streamer::paged_regions ( ) const
+{
+    unsigned int count = 0;
+
+    for ( const auto& entry : m_regions ) {
+        count += entry.second.state == region_paged ? 1 : 0;
+    }
+
+    return count;
+}
+
+std::string region_streamer::path ( int x, int y ) const
+{
+    std::ostringstream out;
+    out << m_settings.directory << "/region_" << x << "_" << y << ".bin";
+
+    return out.str ( );
+}
+
+region_state region_streamer::wanted ( int x, int y ) const
+{
+    float size = m_settings.region_size;
+    float min_x = x * size;
+    float min_y = y * size;
+
+    float nearest = std::numeric_limits<float>::max ( );
+
+    for ( const vec2& point : m_points ) {
+        nearest = std::min ( nearest, distance2 ( point, min_x, min_y, min_x + size, min_y + size ) );
+    }
+
+    if ( nearest <= m_settings.active_radius * m_settings.active_radius ) {
+        return region_active;
+    }
+
+    if ( nearest <= m_settings.frozen_radius * m_settings.frozen_radius ) {
+        return region_frozen;
+    }
+
+    return region_paged;
+}
+
+region_streamer::region& region_streamer::at ( int x, int y )
+{
+    auto it = m_regions.find ( key ( x, y ) );
+
+    if ( it != m_regions.end ( ) ) {
+        return it->second;
+    }
+
+    // bodies wander into a paged region in memory and are written
+    // out with it on the next update
+    region& r = m_regions [ key ( x, y ) ];
+
+    r.x = x;
+    r.y = y;
+    r.state = wanted ( x, y );
+    r.paged = 0;
+
+    return r;
+}
+
+void region_streamer::freeze_strays ( )
+{
+    const float* center_x = m_world.data ( quad_world::s_center_x );
+    const float* center_y = m_world.data ( quad_world::s_center_y );
+    const float* half_width = m_world.data ( quad_world::s_half_width );
+    const float* half_height = m_world.data ( quad_world::s_half_height );
+
+    float largest = m_settings.region_size * 0.25f;
+
+    m_leaving.clear ( );
+    m_leaving_region.clear ( );
+    m_slot_leaving.assign ( m_world.slot_count ( ), k_not_leaving );
+
+    for ( unsigned int i = 0; i < m_world.size ( ); ++i ) {
+        if ( std::max ( half_width [ i ], half_height [ i ] ) > largest ) {
+            continue;
+        }
+
+        int x = 0;
+        int y = 0;
+
+        region_of ( vec2 { center_x [ i ], center_y [ i ] }, x, y );
+
+        if ( wanted ( x, y ) == region_active ) {
+            continue;
+        }
+
+        quad_world::handle h = m_world.handle_at ( i );
+
+        m_slot_leaving [ h.slot ] = static_cast<unsigned int> ( m_leaving.size ( ) );
+        m_leaving.push_back ( h );
+        m_leaving_region.push_back ( key ( x, y ) );
+    }
+
+    if ( m_leaving.empty ( ) ) {
+        return;
+    }
+
+    // a joint to a body staying, or to one going to another region,
+    // keeps both where they are, and so on along the group
+    const joint_constraint* joints = m_world.joints ( ).data ( );
+    unsigned int joint_count = m_world.joints ( ).size ( );
+
+    for ( bool changed = true; changed; ) {
+        changed = false;
+
+        for ( unsigned int i = 0; i < joint_count; ++i ) {
+            unsigned int a = m_slot_leaving [ joints [ i ].slot_a ];
+            unsigned int b = m_slot_leaving [ joints [ i ].slot_b ];
+
+            if ( a == k_not_leaving && b == k_not_leaving ) {
+                continue;
+            }
+
+            if ( a != k_not_leaving && b != k_not_leaving && m_leaving_region [ a ] == m_leaving_region [ b ] ) {
+                continue;
+            }
+
+            m_slot_leaving [ joints [ i ].slot_a ] = k_not_leaving;
+            m_slot_leaving [ joints [ i ].slot_b ] = k_not_leaving;
+            changed = true;
+        }
+    }
+
+    m_leaving_index.assign ( m_leaving.size ( ), k_not_leaving );
+
+    for ( unsigned int i = 0; i < m_leaving.size ( ); ++i ) {
+        const quad_world::handle& h = m_leaving [ i ];
+
+        if ( m_slot_leaving [ h.slot ] != i ) {
+            continue;
+        }
+
+        unsigned long long k = static_cast<unsigned long long> ( m_leaving_region [ i ] );
+        region& r = at ( static_cast<int> ( static_cast<unsigned int> ( k >> 32 ) ),
+                         static_cast<int> ( static_cast<unsigned int> ( k ) ) );
+
+        m_leaving_index [ i ] = static_cast<unsigned int> ( r.bodies.size ( ) );
+
+        r.bodies.emplace_back ( );
+        m_world.save_body ( h, r.bodies.back ( ).fields );
+        r.bodies.back ( ).awake = m_world.awake ( h ) ? 1 : 0;
+    }
+
+    for ( unsigned int i = 0; i < joint_count; ++i ) {
+        unsigned int a = m_slot_leaving [ joints [ i ].slot_a ];
+        unsigned int b = m_slot_leaving [ joints [ i ].slot_b ];
+
+        if ( a == k_not_leaving || b == k_not_leaving ) {
+            continue;
+        }
+
+        long long k = m_leaving_region [ a ];
+
+        m_regions [ k ].joints.push_back ( region_joint { m_leaving_index [ a ], m_leaving_index [ b ], joints [ i ] } );
+    }
+
+    // the joints go with their bodies
+    for ( unsigned int i = 0; i < m_leaving.size ( ); ++i ) {
+        if ( m_leaving_index [ i ] != k_not_leaving ) {
+            m_world.destroy ( m_leaving [ i ] );
+        }
+    }
+}
+
+bool region_streamer::write ( region& r )
+{
+    // bodies that arrived after it was paged join the ones on disk
+    if ( r.paged > 0 && !read ( r ) ) {
+        return false;
+    }
+
+    region_file_header h;
+    std::memset ( &h, 0, sizeof ( h ) );
+
+    std::memcpy ( h.magic, k_magic, sizeof ( k_magic ) );
+    h.version = k_version;
+    h.byte_order = k_byte_order;
+    h.header_size = sizeof ( region_file_header );
+    h.stream_count = quad_world::k_num_streams;
+    h.joint_size = sizeof ( joint_constraint );
+    h.x = r.x;
+    h.y = r.y;
+    h.bodies = static_cast<unsigned int> ( r.bodies.size ( ) );
+    h.joints = static_cast<unsigned int> ( r.joints.size ( ) );
+
+    std::ofstream out { path ( r.x, r.y ), std::ios::binary | std::ios::trunc };
+
+    out.write ( reinterpret_cast<const char*> ( &h ), sizeof ( h ) );
+    out.write ( reinterpret_cast<const char*> ( r.bodies.data ( ) ),
+                static_cast<std::streamsize> ( sizeof ( region_body ) * h.bodies ) );
+    out.write ( reinterpret_cast<const char*> ( r.joints.data ( ) ),
+                static_cast<std::streamsize> ( sizeof ( region_joint ) * h.joints ) );
+
+    if ( !out ) {
+        return false;
+    }
+
+    r.state = region_paged;
+    r.paged = h.bodies;
+
+    // give the memory back, not just empty the vectors
+    std::vector<region_body> ( ).swap ( r.bodies );
+    std::vector<region_joint> ( ).swap ( r.joints );
+
+    return true;
+}
+
+bool region_streamer::read ( region& r )
+{
+    if ( r.paged == 0 ) {
+        return true;
+    }
+
+    std::string file = path ( r.x, r.y );
+    std::ifstream in { file, std::ios::binary };
+
+    region_file_header h;
+
+    in.read ( reinterpret_cast<char*> ( &h ), sizeof ( h ) );
+
+    if ( !in ||
+         std::memcmp ( h.magic, k_magic, sizeof ( k_magic ) ) != 0 ||
+         h.version != k_version ||
+         h.byte_order != k_byte_order ||
+         h.header_size != sizeof ( region_file_header ) ||
+         h.stream_count != quad_world::k_num_streams ||
+         h.joint_size != sizeof ( joint_constraint ) ||
+         h.x != r.x || h.y != r.y ||
+         h.bodies != r.paged ) {
+        return false;
+    }
+
+    // the counts have to match the file before anything is sized from
+    // them, a cut short or corrupt file fails here
+    std::streamoff start = in.tellg ( );
+    in.seekg ( 0, std::ios::end );
+    unsigned long long rest = static_cast<unsigned long long> ( in.tellg ( ) - start );
+    in.seekg ( start );
+
+    if ( !in || rest != sizeof ( region_body ) * 1ull * h.bodies + sizeof ( region_joint ) * 1ull * h.joints ) {
+        return false;
+    }
+
+    // the file's bodies go in front of any that arrived since
+    std::vector<region_body> bodies ( h.bodies );
+    std::vector<region_joint> joints ( h.joints );
+
+    in.read ( reinterpret_cast<char*> ( bodies.data ( ) ), static_cast<std::streamsize> ( sizeof ( region_body ) * h.bodies ) );
+    in.read ( reinterpret_cast<char*> ( joints.data ( ) ), static_cast<std::streamsize> ( sizeof ( region_joint ) * h.joints ) );
+
+    if ( !in ) {
+        return false;
+    }
+
+    // thaw looks the joints' bodies up by these
+    for ( const region_joint& j : joints ) {
+        if ( j.a >= h.bodies || j.b >= h.bodies ) {
+            return false;
+        }
+    }
+
+    for ( region_joint& j : r.joints ) {
+        j.a += h.bodies;
+        j.b += h.bodies;
+    }
+
+    bodies.insert ( bodies.end ( ), r.bodies.begin ( ), r.bodies.end ( ) );
+    joints.insert ( joints.end ( ), r.joints.begin ( ), r.joints.end ( ) );
+
+    r.bodies.swap ( bodies );
+    r.joints.swap ( joints );
+    r.paged = 0;
+
+    in.close ( );
+    std::remove ( file.c_str ( ) );
+
+    return true;
+}
+
+void region_streamer::thaw ( region& r )
+{
+    std::vector<quad_world::handle> handles ( r.bodies.size ( ) );
+
+    for ( std::size_t i = 0; i < r.bodies.size ( ); ++i ) {
+        handles [ i ] = m_world.restore_body ( r.bodies [ i ].fields, r.bodies [ i ].awake != 0 );
+    }
+
+    for ( const region_joint& j : r.joints ) {
+        m_world.restore_joint ( handles [ j.a ], handles [ j.b ], j.joint );
+    }
+
+    r.bodies.clear ( );
+    r.joints.clear ( );
+}
+
+long long region_streamer::key ( int x, int y )
+{
+    unsigned long long high = static_cast<unsigned int> ( x );
+
+    return static_cast<long long> ( ( high << 32 ) | static_cast<unsigned int> ( y ) );
+}
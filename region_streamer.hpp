@@ -0,0 +1,171 @@
+#ifndef REGION_STREAMER
+#define REGION_STREAMER
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "joint.hpp"
+#include "quad_world.hpp"
+
+// splits a world too big to keep live into square regions on a grid
+// and moves them between three states by how far they are from the
+// points of interest, so the step only pays for the bodies near them
+// and memory only holds the regions around those:
+//
+//     active  the region's bodies are in the world and simulated
+//     frozen  they are taken out of the world and kept in memory
+//     paged   they are written to a file of their own and freed
+//
+// a body belongs to the region its center is in, checked every update,
+// so one that wanders out of the active area is frozen with whatever
+// region it ends up in. bodies joined together move as a group, and a
+// group that reaches out of a region stays in the world until it is
+// all inside one. bodies wider than half a region, the ground and the
+// like, are never taken out.
+//
+// handles to bodies that leave the world go dead, they come back with
+// new ones. keep a point of interest on anything a handle is held to.
+// region files are native endian, like snapshots, and only read back
+// by the build that wrote them.
+struct region_settings {
+    // side of a square region
+    float region_size;
+
+    // regions within this distance of a point of interest are active,
+    // within frozen_radius frozen and paged further out
+    float active_radius;
+    float frozen_radius;
+
+    // where paged regions are written, made if it is not there
+    std::string directory;
+
+    region_settings ( ) :
+        region_size { 4.0f },
+        active_radius { 4.0f },
+        frozen_radius { 8.0f },
+        directory { "regions" }
+    {}
+};
+
+enum region_state {
+    region_active,
+    region_frozen,
+    region_paged,
+    k_num_region_states
+};
+
+// one body out of the world, every stream's field and whether it
+// was awake
+struct region_body {
+    float fields [ quad_world::k_num_streams ];
+    unsigned int awake;
+};
+
+// a joint between two bodies of the same region, a and b index its
+// bodies
+struct region_joint {
+    unsigned int a;
+    unsigned int b;
+    joint_constraint joint;
+};
+
+struct region_file_header {
+    char magic [ 4 ];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned int header_size;
+    unsigned int stream_count;
+    unsigned int joint_size;
+
+    int x;
+    int y;
+    unsigned int bodies;
+    unsigned int joints;
+};
+
+class region_streamer {
+public:
+    static const unsigned int k_version = 1;
+
+    region_streamer ( quad_world& world, const region_settings& settings = region_settings ( ) );
+
+    region_streamer ( const region_streamer& ) = delete;
+    region_streamer& operator= ( const region_streamer& ) = delete;
+
+    // the points regions are kept active around, set every frame or
+    // whenever they move. with none every region is active
+    void clear_points ( ) { m_points.clear ( ); }
+    void add_point ( const vec2& point ) { m_points.push_back ( point ); }
+    const std::vector<vec2>& points ( ) const { return m_points; }
+
+    // move every region to the state its distance from the points
+    // asks for. call between steps, not during one. returns false if
+    // a region could not be written or read back, it is left as it
+    // was and tried again next time
+    bool update ( );
+
+    // the region a point is in and its state, regions never seen are
+    // active
+    void region_of ( const vec2& point, int& x, int& y ) const;
+    region_state state ( int x, int y ) const;
+
+    // bodies held out of the world, in memory and on disk
+    unsigned int frozen_bodies ( ) const;
+    unsigned int paged_bodies ( ) const;
+
+    // regions holding bodies out of the world, active ones are not
+    // kept track of
+    unsigned int frozen_regions ( ) const;
+    unsigned int paged_regions ( ) const;
+
+    // where the region's file goes
+    std::string path ( int x, int y ) const;
+
+    const region_settings& settings ( ) const { return m_settings; }
+
+private:
+
+    struct region {
+        int x;
+        int y;
+        region_state state;
+
+        // frozen bodies, and for a paged region any that arrived after
+        // it was written
+        std::vector<region_body> bodies;
+        std::vector<region_joint> joints;
+
+        // bodies in the file of a paged region
+        unsigned int paged;
+    };
+
+    region_state wanted ( int x, int y ) const;
+    region& at ( int x, int y );
+
+    // take the bodies whose center is in a region that is not active
+    // out of the world
+    void freeze_strays ( );
+
+    bool write ( region& r );
+    bool read ( region& r );
+    void thaw ( region& r );
+
+    static long long key ( int x, int y );
+
+    quad_world& m_world;
+    region_settings m_settings;
+    std::vector<vec2> m_points;
+
+    std::unordered_map<long long, region> m_regions;
+
+    // scratch for freeze_strays, kept to save allocating every
+    // update. the bodies leaving, the region each goes to and where in
+    // its bodies, and by slot which leaving body it is, if any
+    std::vector<quad_world::handle> m_leaving;
+    std::vector<long long> m_leaving_region;
+    std::vector<unsigned int> m_leaving_index;
+    std::vector<unsigned int> m_slot_leaving;
+};
+
+#endif
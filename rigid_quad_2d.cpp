@@ -1,66 +1,86 @@
 #include "rigid_quad_2d.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
 
-rigid_quad_2d::rigid_quad_2d ( const vec2& center,
-						       float width,
-						       float height,
-						       float mass,
-						       float rotation ) :
+#include "fast_math.hpp"
+
+template < typename T >
+basic_rigid_quad_2d<T>::basic_rigid_quad_2d ( const vec_type& center,
+                                              T width,
+                                              T height,
+                                              T mass,
+                                              T rotation ) :
 	m_width { width },
 	m_height { height },
-	m_half_width { width * 0.5f },
-	m_half_height { height * 0.5f },
+	m_half_width { width * T ( 0.5f ) },
+	m_half_height { height * T ( 0.5f ) },
 	m_mass { mass },
-	m_inv_mass { 1.0f / mass },
-	m_inertia { 0.0f },
-	m_inv_inertia { 0.0f },
+	m_inv_mass { T ( 1 ) / mass },
+	m_inertia { },
+	m_inv_inertia { },
 	m_rotation { rotation },
-    m_angular_velocity { 0.0f },
-	m_total_torque { 0.0f },
+    m_angular_velocity { },
+	m_total_torque { },
 	m_center { center }
 {
 	// inertia of a quad
-	m_inertia = m_mass / 12.0f;
+	m_inertia = m_mass / T ( 12 );
 	m_inertia *= ( width * width + height * height );
 
-	m_inv_inertia = 1.0f / m_inertia;
+	m_inv_inertia = T ( 1 ) / m_inertia;
 
-	update_corners ( );
+	// the corners around the origin never change, only their pose
+	m_local_corners[ 0 ].set ( -m_half_width, -m_half_height );
+	m_local_corners[ 1 ].set (  m_half_width, -m_half_height );
+	m_local_corners[ 2 ].set (  m_half_width,  m_half_height );
+	m_local_corners[ 3 ].set ( -m_half_width,  m_half_height );
+
+	// same polynomial as quad_world so both give the same corners on
+	// every platform, libm sin and cos differ between libraries
+	fast_math::sincos ( m_rotation, m_sin_rotation, m_cos_rotation );
+
+	pose_corners ( );
 }
 
-void rigid_quad_2d::push ( const vec2& force )
+template < typename T >
+void basic_rigid_quad_2d<T>::push ( const vec_type& force )
 {
 	m_total_force += force;
 }
 
-void rigid_quad_2d::pull ( const vec2& force )
+template < typename T >
+void basic_rigid_quad_2d<T>::pull ( const vec_type& force )
 {
 	m_total_force -= force;
 }
 
-void rigid_quad_2d::push ( const vec2& force,
-                            const vec2& point )
+template < typename T >
+void basic_rigid_quad_2d<T>::push ( const vec_type& force,
+                                     const vec_type& point )
 {
 	m_total_force += force;
 	m_total_torque += ( force.mag ( ) * m_center.perp_dot ( point ) );
 }
 
-void rigid_quad_2d::pull ( const vec2& force,
-                            const vec2& point )
+template < typename T >
+void basic_rigid_quad_2d<T>::pull ( const vec_type& force,
+                                     const vec_type& point )
 {
 	m_total_force -= force;
 	m_total_torque -= ( force.mag ( ) * m_center.perp_dot ( point ) );
 }
 
-void rigid_quad_2d::impulse ( float impulse,
-                              const vec2& normal )
+template < typename T >
+void basic_rigid_quad_2d<T>::impulse ( T impulse,
+                                       const vec_type& normal )
 {
     m_velocity += ( normal * ( impulse / m_mass ) );
 }
 
-void rigid_quad_2d::update ( float dt, float friction )
+template < typename T >
+void basic_rigid_quad_2d<T>::update ( T dt, T friction )
 {
 	// F = ma, a = dv/dt, v = dc/dt, c = c0 + F / m * dt ^ 2
     m_center += m_velocity * dt;
@@ -77,100 +97,122 @@ void rigid_quad_2d::update ( float dt, float friction )
 	m_total_torque -= ( m_total_torque * friction );
 }
 
-void rigid_quad_2d::update_corners ()
+template < typename T >
+void basic_rigid_quad_2d<T>::update_corners ()
 {
-	// start at the origin and set up each corner
-	m_corners[ 0 ].set ( -m_half_width, -m_half_height );
-	m_corners[ 1 ].set (  m_half_width, -m_half_height );
-	m_corners[ 2 ].set (  m_half_width,  m_half_height );
-	m_corners[ 3 ].set ( -m_half_width,  m_half_height );
+	bool turned = m_rotation != m_posed_rotation;
+
+	// a body at rest keeps its corners
+	if ( !turned && m_center.x() == m_posed_center.x() && m_center.y() == m_posed_center.y() ) {
+		return;
+	}
 
-	float cos_rot = cos ( m_rotation );
-	float sin_rot = sin ( m_rotation );
+	// one that only moved keeps its sine and cosine too
+	if ( turned ) {
+		fast_math::sincos ( m_rotation, m_sin_rotation, m_cos_rotation );
+	}
+
+	pose_corners ( );
+}
+
+template < typename T >
+void basic_rigid_quad_2d<T>::pose_corners ()
+{
+	m_posed_center = m_center;
+	m_posed_rotation = m_rotation;
 
 	// rotate and offset them by the center
 	for ( unsigned int i = 0; i < k_num_corners; ++i ) {
-		float rot_x = m_corners[ i ].x() * cos_rot - m_corners [ i ].y() * sin_rot;
-		float rot_y = m_corners[ i ].y() * cos_rot + m_corners [ i ].x() * sin_rot;
+		T rot_x = m_local_corners[ i ].x() * m_cos_rotation - m_local_corners [ i ].y() * m_sin_rotation;
+		T rot_y = m_local_corners[ i ].y() * m_cos_rotation + m_local_corners [ i ].x() * m_sin_rotation;
 
 		m_corners [ i ].set ( rot_x + m_center.x(),
 		                      rot_y + m_center.y() );
 	}
 }
 
-void rigid_quad_2d::collision ( const rigid_quad_2d& a,
-                                const rigid_quad_2d& b,
-                                collision_results& res )
+template < typename T >
+void basic_rigid_quad_2d<T>::collision ( const basic_rigid_quad_2d& a,
+                                         const basic_rigid_quad_2d& b,
+                                         collision_results& res )
 {
-    // for each corner, test if it is inside the other shape
-    for ( unsigned int i = 0; i < k_num_corners; ++i ) {
-        if ( is_point_inside_quad ( a.m_corners[i],
-                                    b,
-                                    res.normal ) ) {
-            res.collided = true;
-            res.point = a.m_corners [ i ];
-            res.normal.normalize ( );
-            res.normal.negate ( );
-            return;
-        }
+    collision ( a.m_corners, b.m_corners, res );
+}
 
-        if ( is_point_inside_quad ( b.m_corners[i],
-                                    a,
-                                    res.normal ) ) {
-            res.collided = true;
-            res.point = b.m_corners [ i ];
-            res.normal.normalize ( );
-            res.normal.negate ( );
-            return;
-        }
+template < typename T >
+void basic_rigid_quad_2d<T>::collision ( const vec_type* a_corners,
+                                         const vec_type* b_corners,
+                                         collision_results& res )
+{
+    basic_contact_manifold<T> manifold;
+
+    res.collided = collide_boxes ( a_corners, b_corners, manifold );
+
+    if ( !res.collided ) {
+        return;
     }
 
-    res.collided = false;
+    res.normal = manifold.normal;
+    res.point = manifold.points [ 0 ].point;
+    res.depth = -manifold.points [ 0 ].separation;
+
+    if ( manifold.count > 1 ) {
+        res.point = ( res.point + manifold.points [ 1 ].point ) * T ( 0.5f );
+        res.depth = std::max ( res.depth, -manifold.points [ 1 ].separation );
+    }
+}
+
+template < typename T >
+bool basic_rigid_quad_2d<T>::collision ( const basic_rigid_quad_2d& a,
+                                         const basic_rigid_quad_2d& b,
+                                         basic_contact_manifold<T>& manifold )
+{
+    return collide_boxes ( a.m_corners, b.m_corners, manifold );
 }
 
-bool rigid_quad_2d::is_point_inside_quad ( const vec2& p,
-                                           const rigid_quad_2d& quad,
-                                           vec2& collision_normal )
+template < typename T >
+bool basic_rigid_quad_2d<T>::is_point_inside_quad ( const vec_type& p,
+                                                    const vec_type* quad_corners,
+                                                    vec_type& collision_normal )
 {
-    vec2 edge;
-    vec2 trans_p;
-    vec2 closest_normal;
-    vec2 edge_proj;
-    vec2 normal;
-    float closest_normal_dist = std::numeric_limits<float>::max();
-
-    // build each edge
+    vec_type edge;
+    vec_type trans_p;
+    vec_type normal;
+    T closest_normal_dist = std::numeric_limits<T>::max();
+
+    // build each edge, the count is fixed so this unrolls
     for ( unsigned int i = 0; i < k_num_corners; ++i ) {
-        unsigned int next = ( i + 1 ) % k_num_corners;
+        unsigned int next = i + 1 < k_num_corners ? i + 1 : 0;
 
         // A = -(y2 - y1)
         // B = x2 - x1
         // C = -(A * x1 + B * y1)
-        const vec2& first = quad.m_corners [ i ];
-        const vec2& second = quad.m_corners [ next ];
+        const vec_type& first = quad_corners [ i ];
+        const vec_type& second = quad_corners [ next ];
 
-        float a = -( second.y ( ) - first.y ( ) );
-        float b = second.x ( ) - first.x ( );
-        float c = -( a * first.x ( ) + b * first.y ( ) );
+        T a = -( second.y ( ) - first.y ( ) );
+        T b = second.x ( ) - first.x ( );
+        T c = -( a * first.x ( ) + b * first.y ( ) );
 
         // D = A * xp + B * yp + C
-        float d = a * p.x ( ) + b * p.y ( ) + c;
+        T d = a * p.x ( ) + b * p.y ( ) + c;
 
-        if ( d < 0.0f ) {
+        if ( d < T ( ) ) {
             return false;
         }
 
         // find the edge vector
-        edge = quad.m_corners [ next ] - quad.m_corners [ i ];
+        edge = second - first;
 
-        // project the point onto the edge
-        trans_p = quad.m_corners [ next ] - p;
-        edge_proj = trans_p.project_onto ( edge );
-        normal = edge_proj - trans_p;
+        // project the point onto the edge, the squared length is the
+        // dot product so no square root is needed
+        trans_p = second - p;
+        normal = edge * ( trans_p.dot ( edge ) / edge.dot ( edge ) ) - trans_p;
 
-        d = normal.mag ( );
+        // squared distances from p to the projected points order the
+        // same as the distances
+        d = normal.dot ( normal );
 
-        // find the distance from p to that projected point
         if ( d < closest_normal_dist ) {
             closest_normal_dist = d;
             collision_normal = normal;
@@ -180,3 +222,5 @@ bool rigid_quad_2d::is_point_inside_quad ( const vec2& p,
     return true;
 }
 
+template class basic_rigid_quad_2d<float>;
+template class basic_rigid_quad_2d<q16_16>;
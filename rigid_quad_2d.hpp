@@ -1,103 +1,137 @@
 #ifndef RIGID_QUAD_2D
 #define RIGID_QUAD_2D
 
+#include "box_collision.hpp"
 #include "vector2.hpp"
 
-class rigid_quad_2d {
+// the scalar type is float, or a fixed point type to run the body and
+// its collisions on integers only. both are instantiated in
+// rigid_quad_2d.cpp, quad_world keeps its bodies as floats
+template < typename T >
+class basic_rigid_quad_2d {
 public:
-	rigid_quad_2d ( const vec2& center,
-			        float width,
-			        float height,
-			        float mass,
-			        float roation = 0.0f );
+	typedef vector2<T> vec_type;
 
+	basic_rigid_quad_2d ( const vec_type& center,
+			              T width,
+			              T height,
+			              T mass,
+			              T roation = T ( ) );
 
-	void push ( const vec2& force );
-    void pull ( const vec2& force );
 
-	void push ( const vec2& force,
-		        const vec2& point );
-	void pull ( const vec2& force,
-		        const vec2& point );
+	void push ( const vec_type& force );
+    void pull ( const vec_type& force );
+
+	void push ( const vec_type& force,
+		        const vec_type& point );
+	void pull ( const vec_type& force,
+		        const vec_type& point );
 
     // used in collision resolution, impulse the force and torque in
     // the direction of the normal using the coefficient of restitution
-    void impulse ( float impulse,
-                   const vec2& normal );
+    void impulse ( T impulse,
+                   const vec_type& normal );
 
 	// update the object over time, decaying the force
 	// and torque with friction
-	void update ( float dt, float friction );
-    
+	void update ( T dt, T friction );
+
     struct collision_results {
         bool collided;
-        vec2 point;
-        vec2 normal;
+        vec_type point;
+        vec_type normal;
+        T depth;
     };
 
-    static void collision ( const rigid_quad_2d& a,
-                            const rigid_quad_2d& b,
+    static void collision ( const basic_rigid_quad_2d& a,
+                            const basic_rigid_quad_2d& b,
                             collision_results& res );
 
+    // same test on raw corner lists, so bodies that are not stored
+    // as rigid_quad_2d objects can share the narrow phase. the normal
+    // points from a to b and the point is the middle of the manifold
+    static void collision ( const vec_type* a_corners,
+                            const vec_type* b_corners,
+                            collision_results& res );
+
+    static bool collision ( const basic_rigid_quad_2d& a,
+                            const basic_rigid_quad_2d& b,
+                            basic_contact_manifold<T>& manifold );
+
+    // point containment test, also gives the normal of the closest edge
+    static bool is_point_inside_quad ( const vec_type& p,
+                                       const vec_type* quad_corners,
+                                       vec_type& collision_normal );
+
 	static const unsigned int k_num_corners = 4;
 
-	inline float width ( ) const;
-	inline float height ( ) const;
+	inline T width ( ) const;
+	inline T height ( ) const;
 
-	inline float mass ( ) const;
-    inline float inv_mass ( ) const;
-	inline float inertia ( ) const;
-	inline float rotation ( ) const;
+	inline T mass ( ) const;
+    inline T inv_mass ( ) const;
+	inline T inertia ( ) const;
+	inline T rotation ( ) const;
 
-	inline const vec2& center ( ) const;
-	inline const vec2& corner ( unsigned int index ) const;
-	inline const vec2& total_force ( ) const;
-	inline float total_torque ( ) const;
+	inline const vec_type& center ( ) const;
+	inline const vec_type& corner ( unsigned int index ) const;
+	inline const vec_type& total_force ( ) const;
+	inline T total_torque ( ) const;
 
 private:
 
+	// rebuild the corners if the body moved or turned since they were
+	// last posed
 	void update_corners ();
-
-    static bool is_point_inside_quad ( const vec2& p,
-                                       const rigid_quad_2d& quad,
-                                       vec2& collision_normal );
+	void pose_corners ();
 
 private:
 
-	float m_width;
-	float m_height;
-	float m_half_width;
-	float m_half_height;
+	T m_width;
+	T m_height;
+	T m_half_width;
+	T m_half_height;
 
-	float m_mass;
-	float m_inv_mass;
+	T m_mass;
+	T m_inv_mass;
 
-	float m_inertia;
-	float m_inv_inertia;
+	T m_inertia;
+	T m_inv_inertia;
 
-	float m_rotation;
+	T m_rotation;
 
-    vec2 m_velocity;
-    float m_angular_velocity;
+    vec_type m_velocity;
+    T m_angular_velocity;
 
-	vec2 m_total_force;
-	float m_total_torque;
+	vec_type m_total_force;
+	T m_total_torque;
 
-	vec2 m_center;
-	vec2 m_corners[k_num_corners];
+	vec_type m_center;
+	vec_type m_local_corners[k_num_corners];
+	vec_type m_corners[k_num_corners];
+
+	// the pose the corners were built for and the sine and cosine
+	// of its rotation
+	vec_type m_posed_center;
+	T m_posed_rotation;
+	T m_sin_rotation;
+	T m_cos_rotation;
 };
 
-inline float rigid_quad_2d::width ( ) const { return m_width; }
-inline float rigid_quad_2d::height ( ) const { return m_height; }
+using rigid_quad_2d = basic_rigid_quad_2d<float>;
+using rigid_quad_2d_q16 = basic_rigid_quad_2d<q16_16>;
+
+template < typename T > inline T basic_rigid_quad_2d<T>::width ( ) const { return m_width; }
+template < typename T > inline T basic_rigid_quad_2d<T>::height ( ) const { return m_height; }
 
-inline float rigid_quad_2d::mass ( ) const { return m_mass; }
-inline float rigid_quad_2d::inv_mass ( ) const { return m_inv_mass; }
-inline float rigid_quad_2d::inertia ( ) const { return m_inertia; }
-inline float rigid_quad_2d::rotation ( ) const { return m_rotation; }
+template < typename T > inline T basic_rigid_quad_2d<T>::mass ( ) const { return m_mass; }
+template < typename T > inline T basic_rigid_quad_2d<T>::inv_mass ( ) const { return m_inv_mass; }
+template < typename T > inline T basic_rigid_quad_2d<T>::inertia ( ) const { return m_inertia; }
+template < typename T > inline T basic_rigid_quad_2d<T>::rotation ( ) const { return m_rotation; }
 
-inline const vec2& rigid_quad_2d::center ( ) const { return m_center; }
-inline const vec2& rigid_quad_2d::corner ( unsigned int index ) const { return m_corners [ index ]; }
-inline const vec2& rigid_quad_2d::total_force ( ) const { return m_total_force; }
-inline float rigid_quad_2d::total_torque ( ) const { return m_total_torque; }
+template < typename T > inline const vector2<T>& basic_rigid_quad_2d<T>::center ( ) const { return m_center; }
+template < typename T > inline const vector2<T>& basic_rigid_quad_2d<T>::corner ( unsigned int index ) const { return m_corners [ index ]; }
+template < typename T > inline const vector2<T>& basic_rigid_quad_2d<T>::total_force ( ) const { return m_total_force; }
+template < typename T > inline T basic_rigid_quad_2d<T>::total_torque ( ) const { return m_total_torque; }
 
 #endif
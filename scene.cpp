@@ -0,0 +1,281 @@
+#include "scene.hpp"
+
+#include <cmath>
+
+#include "fast_math.hpp"
+
+namespace {
+
+    const float k_box_size = 0.2f;
+
+    const char* const k_scene_names [ k_num_scenes ] = {
+        "stack",
+        "pyramid",
+        "rain",
+        "chain",
+        "pile",
+        "shapes"
+    };
+
+    // the chains hang from anchors, each link pinned to the next by a
+    // revolute joint across the gap between them
+    const unsigned int k_chain_links = 20;
+    const float k_link_width = 0.1f;
+    const float k_link_height = 0.04f;
+    const float k_link_gap = 0.02f;
+
+    // the shapes scene mixes these regular polygons in with its boxes
+    // and circles
+    const unsigned int k_polygon_sides [ ] = { 3, 5, 6 };
+    const unsigned int k_num_polygons = sizeof ( k_polygon_sides ) / sizeof ( k_polygon_sides [ 0 ] );
+
+    void build_ground ( quad_world& world, float width )
+    {
+        world.create ( vec2 { 0.0f, -k_box_size * 0.5f }, width, k_box_size, 0.0f );
+    }
+
+    // walls either side of a heap width across, twice as high
+    void build_walls ( quad_world& world, float width )
+    {
+        world.create ( vec2 { -width * 0.5f - k_box_size, width }, k_box_size, width * 2.0f, 0.0f );
+        world.create ( vec2 { width * 0.5f + k_box_size, width }, k_box_size, width * 2.0f, 0.0f );
+    }
+
+}
+
+scene::scene ( scene_kind kind,
+               unsigned int bodies,
+               unsigned int seed ) :
+    m_kind { kind },
+    m_bodies { bodies },
+    m_state { seed ? seed : 1 }
+{
+
+}
+
+void scene::build ( quad_world& world )
+{
+    world.reserve ( world.size ( ) + m_bodies + m_bodies / k_chain_links + 2 );
+
+    switch ( m_kind ) {
+        case scene_pyramid:
+            build_pyramid ( world );
+            break;
+        case scene_rain:
+            build_rain ( world );
+            break;
+        case scene_chain:
+            build_chain ( world );
+            break;
+        case scene_pile:
+            build_pile ( world );
+            break;
+        case scene_shapes:
+            build_shapes ( world );
+            break;
+        default:
+            build_stack ( world );
+            break;
+    }
+}
+
+const char* scene::name ( scene_kind kind )
+{
+    return kind < k_num_scenes ? k_scene_names [ kind ] : "unknown";
+}
+
+bool scene::parse ( const std::string& name, scene_kind& kind )
+{
+    for ( unsigned int i = 0; i < k_num_scenes; ++i ) {
+        if ( name == k_scene_names [ i ] ) {
+            kind = static_cast<scene_kind> ( i );
+            return true;
+        }
+    }
+
+    return false;
+}
+
+float scene::random ( )
+{
+    // xorshift32
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+
+    return static_cast<float> ( m_state >> 8 ) / 16777216.0f;
+}
+
+// columns of boxes 10 high
+void scene::build_stack ( quad_world& world )
+{
+    const unsigned int height = 10;
+
+    unsigned int columns = ( m_bodies + height - 1 ) / height;
+    float spacing = k_box_size * 2.0f;
+    float left = -spacing * columns * 0.5f;
+
+    build_ground ( world, spacing * columns + 1.0f );
+
+    for ( unsigned int i = 0; i < m_bodies; ++i ) {
+        float x = left + spacing * ( i / height );
+        float y = k_box_size * 0.5f + k_box_size * ( i % height );
+
+        world.create ( vec2 { x, y }, k_box_size, k_box_size, 1.0f );
+    }
+}
+
+// one pyramid, each row a box shorter than the one below. a small
+// gap keeps neighbours in a row from touching
+void scene::build_pyramid ( quad_world& world )
+{
+    const float spacing = k_box_size * 1.05f;
+
+    unsigned int base = 1;
+
+    while ( base * ( base + 1 ) / 2 < m_bodies ) {
+        base++;
+    }
+
+    build_ground ( world, spacing * base + 1.0f );
+
+    unsigned int placed = 0;
+
+    for ( unsigned int row = 0; row < base && placed < m_bodies; ++row ) {
+        unsigned int count = base - row;
+        float left = -spacing * ( count - 1 ) * 0.5f;
+
+        for ( unsigned int i = 0; i < count && placed < m_bodies; ++i, ++placed ) {
+            world.create ( vec2 { left + spacing * i, k_box_size * ( row + 0.5f ) },
+                           k_box_size, k_box_size, 1.0f );
+        }
+    }
+}
+
+// loose boxes dropped from a grid onto the ground, rotated a little
+void scene::build_rain ( quad_world& world )
+{
+    const unsigned int per_row = 100;
+
+    float spacing = k_box_size * 1.5f;
+    float left = -spacing * per_row * 0.5f;
+
+    build_ground ( world, spacing * per_row + 1.0f );
+
+    for ( unsigned int i = 0; i < m_bodies; ++i ) {
+        float x = left + spacing * ( i % per_row );
+        float y = 1.0f + spacing * ( i / per_row );
+
+        world.create ( vec2 { x, y }, k_box_size, k_box_size, 1.0f, 0.1f * ( i % 7 ) );
+    }
+}
+
+// chains of thin links side by side, each hanging from a static anchor
+void scene::build_chain ( quad_world& world )
+{
+    unsigned int chains = ( m_bodies + k_chain_links - 1 ) / k_chain_links;
+    float spacing = k_link_width * 3.0f;
+    float left = -spacing * chains * 0.5f;
+    float top = k_chain_links * ( k_link_height + k_link_gap ) + 1.0f;
+
+    build_ground ( world, spacing * chains + 1.0f );
+
+    world.joints ( ).reserve ( world.joints ( ).size ( ) + m_bodies );
+
+    unsigned int placed = 0;
+
+    for ( unsigned int c = 0; c < chains; ++c ) {
+        float x = left + spacing * c;
+
+        quad_world::handle upper = world.create ( vec2 { x, top }, k_link_width, k_link_height, 0.0f );
+
+        for ( unsigned int i = 1; i <= k_chain_links && placed < m_bodies; ++i, ++placed ) {
+            // start each chain swung out to the side so it has to settle
+            float y = top - ( k_link_height + k_link_gap ) * i;
+
+            quad_world::handle lower = world.create ( vec2 { x + k_link_width * 0.5f * i, y },
+                                                      k_link_width, k_link_height, 0.2f );
+
+            // pin the left edges together halfway across the gap
+            vec2 pin = ( world.get ( upper ).corner ( 0 ) + world.get ( lower ).corner ( 3 ) ) * 0.5f;
+
+            world.create_joint ( upper, lower, joint_def::revolute ( pin ) );
+
+            upper = lower;
+        }
+    }
+}
+
+// boxes of mixed sizes dropped overlapping into a narrow heap
+void scene::build_pile ( quad_world& world )
+{
+    // about half again the area the boxes need, the walls twice as high
+    float width = k_box_size * 2.0f + std::sqrt ( m_bodies * 0.03f );
+
+    build_ground ( world, width + 1.0f );
+
+    // walls keep the pile dense
+    build_walls ( world, width );
+
+    for ( unsigned int i = 0; i < m_bodies; ++i ) {
+        float x = ( random ( ) - 0.5f ) * ( width - k_box_size );
+        float y = k_box_size + random ( ) * width * 2.0f;
+        float w = k_box_size * ( 0.5f + random ( ) );
+        float h = k_box_size * ( 0.5f + random ( ) );
+
+        world.create ( vec2 { x, y }, w, h, w * h * 25.0f, random ( ) * 3.0f );
+    }
+}
+
+// boxes and circles of mixed sizes and regular polygons dropped into
+// a heap like the pile, a quarter boxes, a quarter circles
+void scene::build_shapes ( quad_world& world )
+{
+    const float k_density = 25.0f;
+
+    float width = k_box_size * 2.0f + std::sqrt ( m_bodies * 0.03f );
+
+    build_ground ( world, width + 1.0f );
+    build_walls ( world, width );
+
+    unsigned int polygons [ k_num_polygons ];
+
+    for ( unsigned int p = 0; p < k_num_polygons; ++p ) {
+        vec2 points [ convex_polygon::k_max_vertices ];
+
+        for ( unsigned int v = 0; v < k_polygon_sides [ p ]; ++v ) {
+            float angle = 6.28318531f * v / k_polygon_sides [ p ];
+            float s, c;
+
+            // not libm, so the polygons come out the same on every build
+            fast_math::sincos ( angle, s, c );
+            points [ v ] = vec2 { c, s } * ( k_box_size * 0.6f );
+        }
+
+        polygons [ p ] = world.add_polygon ( points, k_polygon_sides [ p ] );
+    }
+
+    for ( unsigned int i = 0; i < m_bodies; ++i ) {
+        float x = ( random ( ) - 0.5f ) * ( width - k_box_size );
+        float y = k_box_size + random ( ) * width * 2.0f;
+        float size = k_box_size * ( 0.5f + random ( ) );
+        float rotation = random ( ) * 3.0f;
+
+        vec2 center { x, y };
+
+        switch ( i % 4 ) {
+            case 0:
+                world.create ( center, size, size * 0.75f, size * size * 0.75f * k_density, rotation );
+                break;
+            case 1:
+                world.create_circle ( center, size * 0.5f, size * size * 0.785f * k_density );
+                break;
+            default: {
+                unsigned int polygon = polygons [ ( i / 4 + i % 4 ) % k_num_polygons ];
+
+                world.create_polygon ( center, polygon, world.polygon ( polygon ).area * k_density, rotation );
+                break;
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef SCENE
+#define SCENE
+
+#include <string>
+
+#include "quad_world.hpp"
+
+enum scene_kind {
+    scene_stack,
+    scene_pyramid,
+    scene_rain,
+    scene_chain,
+    scene_pile,
+    scene_shapes,
+    k_num_scenes
+};
+
+// canned scenes for the headless driver and the benchmark. the same
+// kind, body count and seed always build the same world.
+class scene {
+public:
+    scene ( scene_kind kind,
+            unsigned int bodies,
+            unsigned int seed = 1 );
+
+    // fill world with the scene's bodies and a static ground
+    void build ( quad_world& world );
+
+    scene_kind kind ( ) const { return m_kind; }
+    unsigned int bodies ( ) const { return m_bodies; }
+
+    static const char* name ( scene_kind kind );
+
+    // returns false for a name that is not a scene
+    static bool parse ( const std::string& name, scene_kind& kind );
+
+private:
+
+    void build_stack ( quad_world& world );
+    void build_pyramid ( quad_world& world );
+    void build_rain ( quad_world& world );
+    void build_chain ( quad_world& world );
+    void build_pile ( quad_world& world );
+    void build_shapes ( quad_world& world );
+
+    // uniform in [ 0, 1 ), its own generator so results do not
+    // depend on the standard library
+    float random ( );
+
+    scene_kind m_kind;
+    unsigned int m_bodies;
+    unsigned int m_state;
+};
+
+#endif
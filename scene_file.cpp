@@ -0,0 +1,888 @@
+#include "scene_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <type_traits>
+
+namespace {
+
+    const char k_magic [ 4 ] = { 'R', 'B', 'S', 'C' };
+    const unsigned int k_byte_order = 0x01020304u;
+    const unsigned long long k_section_align = 64;
+
+    // bodies go to the world this many at a time
+    const unsigned int k_batch = 256;
+
+    // most bodies one generator line can add, far past anything that
+    // steps at a usable rate. keeps a typo from overflowing the counts
+    const unsigned long long k_max_generated = 1ull << 24;
+
+    // pyramid boxes sit this far apart across, as in the canned scene
+    const float k_pyramid_spacing = 1.05f;
+
+    const float k_pi = 3.14159265358979f;
+
+    static_assert ( std::is_trivially_copyable<scene_polygon>::value,
+                    "polygons are written as raw memory" );
+    static_assert ( std::is_trivially_copyable<scene_body>::value,
+                    "bodies are written as raw memory" );
+    static_assert ( std::is_trivially_copyable<scene_joint>::value,
+                    "joints are written as raw memory" );
+
+    unsigned long long align_up ( unsigned long long offset )
+    {
+        return ( offset + k_section_align - 1 ) & ~( k_section_align - 1 );
+    }
+
+    void write_section ( std::ofstream& out,
+                         unsigned long long& position,
+                         unsigned long long offset,
+                         const void* data,
+                         unsigned long long bytes )
+    {
+        static const char k_zeros [ k_section_align ] = { };
+
+        out.write ( k_zeros, static_cast<std::streamsize> ( offset - position ) );
+        out.write ( static_cast<const char*> ( data ), static_cast<std::streamsize> ( bytes ) );
+
+        position = offset + bytes;
+    }
+
+    // count records of record bytes starting at offset fit in size
+    // bytes, worked out so a crafted offset or count cannot wrap
+    bool fits ( unsigned long long offset,
+                unsigned long long count,
+                unsigned long long record,
+                unsigned long long size )
+    {
+        return offset <= size && count <= ( size - offset ) / record;
+    }
+
+    // a whole section straight into a vector sized for it
+    template<typename T>
+    bool read_section ( std::istream& in,
+                        unsigned long long offset,
+                        unsigned int count,
+                        std::vector<T>& out )
+    {
+        out.resize ( count );
+
+        if ( count == 0 ) {
+            return true;
+        }
+
+        in.seekg ( static_cast<std::streamoff> ( offset ) );
+        in.read ( reinterpret_cast<char*> ( out.data ( ) ), static_cast<std::streamsize> ( sizeof ( T ) * count ) );
+
+        return static_cast<bool> ( in );
+    }
+
+    struct command_usage {
+        const char* name;
+        const char* usage;
+    };
+
+    const command_usage k_commands [ ] = {
+        { "gravity", "gravity <x> <y>" },
+        { "material", "material <name> <density>" },
+        { "polygon", "polygon <name> <x> <y> <x> <y> ..., 3 to 8 convex points" },
+        { "box", "box <material> <x> <y> <width> <height> [ <rotation> ]" },
+        { "circle", "circle <material> <x> <y> <radius>" },
+        { "shape", "shape <polygon> <material> <x> <y> [ <rotation> ]" },
+        { "bullet", "bullet, after a body" },
+        { "revolute", "revolute <a> <b> <x> <y> [ motor <speed> <max force> ] [ collide ]" },
+        { "weld", "weld <a> <b> <x> <y> [ collide ]" },
+        { "prismatic", "prismatic <a> <b> <x> <y> <axis x> <axis y> [ motor <speed> <max force> ] [ collide ]" },
+        { "distance", "distance <a> <b> <ax> <ay> <bx> <by> [ <length> ] [ collide ]" },
+        { "rope", "rope <a> <b> <ax> <ay> <bx> <by> <length> [ collide ]" },
+        { "grid", "grid <material> <x> <y> <columns> <rows> <width> <height> [ <gap> ]" },
+        { "pyramid", "pyramid <material> <x> <y> <base> <size>" },
+        { "field", "field <material> <min x> <min y> <max x> <max y> <count> <min size> <max size> [ <seed> ]" }
+    };
+
+    const char* usage ( const std::string& command )
+    {
+        for ( const command_usage& c : k_commands ) {
+            if ( command == c.name ) {
+                return c.usage;
+            }
+        }
+
+        return nullptr;
+    }
+
+    // the words of one line up to any comment. the readers only move
+    // past a word they could read
+    class words {
+    public:
+        explicit words ( const std::string& line ) :
+            m_next { 0 }
+        {
+            std::istringstream in { line.substr ( 0, line.find ( '#' ) ) };
+            std::string word;
+
+            while ( in >> word ) {
+                m_words.push_back ( word );
+            }
+        }
+
+        bool done ( ) const { return m_next == m_words.size ( ); }
+
+        bool word ( std::string& out )
+        {
+            if ( done ( ) ) {
+                return false;
+            }
+
+            out = m_words [ m_next++ ];
+
+            return true;
+        }
+
+        bool keyword ( const char* name )
+        {
+            if ( done ( ) || m_words [ m_next ] != name ) {
+                return false;
+            }
+
+            m_next++;
+
+            return true;
+        }
+
+        bool number ( float& out )
+        {
+            if ( done ( ) ) {
+                return false;
+            }
+
+            const char* text = m_words [ m_next ].c_str ( );
+            char* end = nullptr;
+            float value = std::strtof ( text, &end );
+
+            if ( end == text || *end != '\0' ) {
+                return false;
+            }
+
+            out = value;
+            m_next++;
+
+            return true;
+        }
+
+        bool integer ( long& out )
+        {
+            if ( done ( ) ) {
+                return false;
+            }
+
+            const char* text = m_words [ m_next ].c_str ( );
+            char* end = nullptr;
+            long value = std::strtol ( text, &end, 10 );
+
+            if ( end == text || *end != '\0' ) {
+                return false;
+            }
+
+            out = value;
+            m_next++;
+
+            return true;
+        }
+
+        bool count ( unsigned int& out )
+        {
+            if ( done ( ) || m_words [ m_next ] [ 0 ] == '-' ) {
+                return false;
+            }
+
+            const char* text = m_words [ m_next ].c_str ( );
+            char* end = nullptr;
+            unsigned long value = std::strtoul ( text, &end, 10 );
+
+            // too big for strtoul comes back as its max, which is too big
+            // here as well
+            if ( end == text || *end != '\0' || value > std::numeric_limits<unsigned int>::max ( ) ) {
+                return false;
+            }
+
+            out = static_cast<unsigned int> ( value );
+            m_next++;
+
+            return true;
+        }
+
+        bool point ( vec2& out )
+        {
+            float x = 0.0f;
+            float y = 0.0f;
+
+            if ( !number ( x ) || !number ( y ) ) {
+                return false;
+            }
+
+            out.set ( x, y );
+
+            return true;
+        }
+
+    private:
+        std::vector<std::string> m_words;
+        std::size_t m_next;
+    };
+
+    typedef std::map<std::string, unsigned int> name_table;
+
+    bool lookup ( words& w, const name_table& names, unsigned int& out )
+    {
+        std::string name;
+
+        if ( !w.word ( name ) ) {
+            return false;
+        }
+
+        name_table::const_iterator it = names.find ( name );
+
+        if ( it == names.end ( ) ) {
+            return false;
+        }
+
+        out = it->second;
+
+        return true;
+    }
+
+    // a body index, below zero counts back from the end
+    bool body ( words& w, unsigned int bodies, unsigned int& out )
+    {
+        long index = 0;
+
+        if ( !w.integer ( index ) ) {
+            return false;
+        }
+
+        if ( index < 0 ) {
+            index += static_cast<long> ( bodies );
+        }
+
+        if ( index < 0 || index >= static_cast<long> ( bodies ) ) {
+            return false;
+        }
+
+        out = static_cast<unsigned int> ( index );
+
+        return true;
+    }
+
+    // the motor and collide words any joint line can end with
+    bool joint_options ( words& w, joint_def& def, bool motor )
+    {
+        if ( motor && w.keyword ( "motor" ) ) {
+            def.motor = true;
+
+            if ( !w.number ( def.motor_speed ) || !w.number ( def.max_motor_force ) ) {
+                return false;
+            }
+        }
+
+        def.collide_connected = w.keyword ( "collide" );
+
+        return true;
+    }
+
+    float polygon_area ( const scene_polygon& p )
+    {
+        convex_polygon polygon;
+
+        return make_polygon ( p.points, p.count, polygon ) ? polygon.area : 0.0f;
+    }
+
+}
+
+scene_file::scene_file ( ) :
+    m_gravity { 0.0f, -9.8f }
+{
+    clear ( );
+}
+
+void scene_file::clear ( )
+{
+    m_polygon_areas.clear ( );
+    m_materials.clear ( );
+    m_polygons.clear ( );
+    m_bodies.clear ( );
+    m_joints.clear ( );
+    m_error.clear ( );
+
+    m_gravity.set ( 0.0f, -9.8f );
+
+    add_material ( 0.0f );
+}
+
+bool scene_file::read ( const std::string& path )
+{
+    std::ifstream in { path, std::ios::binary };
+
+    if ( !in ) {
+        m_error = "could not open " + path;
+        return false;
+    }
+
+    clear ( );
+
+    char magic [ sizeof ( k_magic ) ] = { };
+
+    in.read ( magic, sizeof ( magic ) );
+
+    if ( in && std::memcmp ( magic, k_magic, sizeof ( k_magic ) ) == 0 ) {
+        in.seekg ( 0 );
+        return read_compiled ( in );
+    }
+
+    in.clear ( );
+    in.seekg ( 0 );
+
+    return parse ( in );
+}
+
+bool scene_file::parse ( std::istream& in )
+{
+    name_table materials;
+    name_table polygons;
+
+    materials [ "static" ] = k_static;
+
+    std::string line;
+    unsigned int line_number = 0;
+
+    while ( std::getline ( in, line ) ) {
+        line_number++;
+
+        words w { line };
+        std::string command;
+
+        if ( !w.word ( command ) ) {
+            continue;
+        }
+
+        bool ok = true;
+        unsigned int count = static_cast<unsigned int> ( m_bodies.size ( ) );
+
+        if ( command == "gravity" ) {
+            ok = w.point ( m_gravity );
+        } else if ( command == "material" ) {
+            std::string name;
+            float density = 0.0f;
+
+            ok = w.word ( name ) && w.number ( density ) && std::isfinite ( density ) && density >= 0.0f;
+
+            if ( ok ) {
+                materials [ name ] = add_material ( density );
+            }
+        } else if ( command == "polygon" ) {
+            std::string name;
+            vec2 points [ convex_polygon::k_max_vertices + 1 ];
+            unsigned int n = 0;
+
+            ok = w.word ( name );
+
+            while ( ok && !w.done ( ) && n <= convex_polygon::k_max_vertices ) {
+                ok = w.point ( points [ n++ ] );
+            }
+
+            unsigned int polygon = ok ? add_polygon ( points, n ) : k_none;
+
+            ok = polygon != k_none;
+
+            if ( ok ) {
+                polygons [ name ] = polygon;
+            }
+        } else if ( command == "box" ) {
+            unsigned int material = 0;
+            vec2 center;
+            float width = 0.0f;
+            float height = 0.0f;
+            float rotation = 0.0f;
+
+            ok = lookup ( w, materials, material ) && w.point ( center ) &&
+                 w.number ( width ) && w.number ( height ) && width > 0.0f && height > 0.0f;
+
+            w.number ( rotation );
+
+            if ( ok ) {
+                add_box ( material, center, width, height, rotation );
+            }
+        } else if ( command == "circle" ) {
+            unsigned int material = 0;
+            vec2 center;
+            float radius = 0.0f;
+
+            ok = lookup ( w, materials, material ) && w.point ( center ) && w.number ( radius ) && radius > 0.0f;
+
+            if ( ok ) {
+                add_circle ( material, center, radius );
+            }
+        } else if ( command == "shape" ) {
+            unsigned int polygon = 0;
+            unsigned int material = 0;
+            vec2 center;
+            float rotation = 0.0f;
+
+            ok = lookup ( w, polygons, polygon ) && lookup ( w, materials, material ) && w.point ( center );
+
+            w.number ( rotation );
+
+            if ( ok ) {
+                add_shape ( polygon, material, center, rotation );
+            }
+        } else if ( command == "bullet" ) {
+            ok = count > 0;
+
+            if ( ok ) {
+                set_bullet ( count - 1, true );
+            }
+        } else if ( command == "revolute" || command == "weld" ) {
+            unsigned int a = 0;
+            unsigned int b = 0;
+            vec2 anchor;
+
+            ok = body ( w, count, a ) && body ( w, count, b ) && w.point ( anchor );
+
+            joint_def def = command == "weld" ? joint_def::weld ( anchor ) : joint_def::revolute ( anchor );
+
+            ok = ok && joint_options ( w, def, command == "revolute" );
+
+            if ( ok ) {
+                add_joint ( a, b, def );
+            }
+        } else if ( command == "prismatic" ) {
+            unsigned int a = 0;
+            unsigned int b = 0;
+            vec2 anchor;
+            vec2 axis;
+
+            ok = body ( w, count, a ) && body ( w, count, b ) && w.point ( anchor ) && w.point ( axis );
+
+            joint_def def = joint_def::prismatic ( anchor, axis );
+
+            ok = ok && joint_options ( w, def, true );
+
+            if ( ok ) {
+                add_joint ( a, b, def );
+            }
+        } else if ( command == "distance" || command == "rope" ) {
+            unsigned int a = 0;
+            unsigned int b = 0;
+            vec2 anchor_a;
+            vec2 anchor_b;
+            float length = -1.0f;
+
+            ok = body ( w, count, a ) && body ( w, count, b ) && w.point ( anchor_a ) && w.point ( anchor_b );
+
+            bool has_length = w.number ( length );
+
+            joint_def def = command == "rope" ? joint_def::rope ( anchor_a, anchor_b, length )
+                                              : joint_def::distance ( anchor_a, anchor_b, length );
+
+            ok = ok && ( has_length || command == "distance" ) && joint_options ( w, def, false );
+
+            if ( ok ) {
+                add_joint ( a, b, def );
+            }
+        } else if ( command == "grid" ) {
+            unsigned int material = 0;
+            vec2 origin;
+            unsigned int columns = 0;
+            unsigned int rows = 0;
+            float width = 0.0f;
+            float height = 0.0f;
+            float gap = 0.0f;
+
+            ok = lookup ( w, materials, material ) && w.point ( origin ) && w.count ( columns ) &&
+                 w.count ( rows ) && w.number ( width ) && w.number ( height ) && width > 0.0f && height > 0.0f &&
+                 static_cast<unsigned long long> ( columns ) * rows <= k_max_generated;
+
+            w.number ( gap );
+
+            if ( ok ) {
+                grid ( material, origin, columns, rows, width, height, gap );
+            }
+        } else if ( command == "pyramid" ) {
+            unsigned int material = 0;
+            vec2 origin;
+            unsigned int base = 0;
+            float size = 0.0f;
+
+            ok = lookup ( w, materials, material ) && w.point ( origin ) && w.count ( base ) &&
+                 w.number ( size ) && size > 0.0f &&
+                 static_cast<unsigned long long> ( base ) * ( base + 1ull ) / 2 <= k_max_generated;
+
+            if ( ok ) {
+                pyramid ( material, origin, base, size );
+            }
+        } else if ( command == "field" ) {
+            unsigned int material = 0;
+            vec2 min;
+            vec2 max;
+            unsigned int n = 0;
+            float min_size = 0.0f;
+            float max_size = 0.0f;
+            unsigned int seed = 1;
+
+            ok = lookup ( w, materials, material ) && w.point ( min ) && w.point ( max ) && w.count ( n ) &&
+                 w.number ( min_size ) && w.number ( max_size ) && min_size > 0.0f && max_size >= min_size &&
+                 n <= k_max_generated;
+
+            w.count ( seed );
+
+            if ( ok ) {
+                field ( material, min, max, n, min_size, max_size, seed );
+            }
+        } else {
+            std::ostringstream message;
+            message << "line " << line_number << ": unknown command " << command;
+            m_error = message.str ( );
+
+            return false;
+        }
+
+        if ( !ok || !w.done ( ) ) {
+            std::ostringstream message;
+            message << "line " << line_number << ": expected " << usage ( command );
+            m_error = message.str ( );
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool scene_file::write ( const std::string& path ) const
+{
+    scene_file_header h;
+    std::memset ( &h, 0, sizeof ( h ) );
+
+    std::memcpy ( h.magic, k_magic, sizeof ( k_magic ) );
+    h.version = k_version;
+    h.byte_order = k_byte_order;
+    h.header_size = sizeof ( scene_file_header );
+    h.polygon_size = sizeof ( scene_polygon );
+    h.body_size = sizeof ( scene_body );
+    h.joint_size = sizeof ( scene_joint );
+
+    h.materials = static_cast<unsigned int> ( m_materials.size ( ) );
+    h.polygons = static_cast<unsigned int> ( m_polygons.size ( ) );
+    h.bodies = static_cast<unsigned int> ( m_bodies.size ( ) );
+    h.joints = static_cast<unsigned int> ( m_joints.size ( ) );
+
+    h.gravity_x = m_gravity.x ( );
+    h.gravity_y = m_gravity.y ( );
+
+    h.materials_offset = align_up ( sizeof ( scene_file_header ) );
+    h.polygons_offset = align_up ( h.materials_offset + sizeof ( scene_material ) * h.materials );
+    h.bodies_offset = align_up ( h.polygons_offset + sizeof ( scene_polygon ) * h.polygons );
+    h.joints_offset = align_up ( h.bodies_offset + sizeof ( scene_body ) * h.bodies );
+    h.file_size = h.joints_offset + sizeof ( scene_joint ) * h.joints;
+
+    std::ofstream out { path, std::ios::binary | std::ios::trunc };
+
+    if ( !out ) {
+        m_error = "could not open " + path;
+        return false;
+    }
+
+    unsigned long long position = 0;
+
+    write_section ( out, position, 0, &h, sizeof ( h ) );
+    write_section ( out, position, h.materials_offset, m_materials.data ( ), sizeof ( scene_material ) * h.materials );
+    write_section ( out, position, h.polygons_offset, m_polygons.data ( ), sizeof ( scene_polygon ) * h.polygons );
+    write_section ( out, position, h.bodies_offset, m_bodies.data ( ), sizeof ( scene_body ) * h.bodies );
+    write_section ( out, position, h.joints_offset, m_joints.data ( ), sizeof ( scene_joint ) * h.joints );
+
+    if ( !out ) {
+        m_error = "could not write " + path;
+        return false;
+    }
+
+    return true;
+}
+
+bool scene_file::read_compiled ( std::istream& in )
+{
+    scene_file_header h;
+
+    in.read ( reinterpret_cast<char*> ( &h ), sizeof ( h ) );
+
+    if ( !in ||
+         h.version != k_version ||
+         h.byte_order != k_byte_order ||
+         h.header_size != sizeof ( scene_file_header ) ||
+         h.polygon_size != sizeof ( scene_polygon ) ||
+         h.body_size != sizeof ( scene_body ) ||
+         h.joint_size != sizeof ( scene_joint ) ) {
+        m_error = "not a compiled scene this build can read";
+        return false;
+    }
+
+    // nothing is sized from the counts until every section is known
+    // to be in the file
+    in.seekg ( 0, std::ios::end );
+    unsigned long long size = static_cast<unsigned long long> ( in.tellg ( ) );
+
+    if ( !in ||
+         h.file_size != size ||
+         !fits ( h.materials_offset, h.materials, sizeof ( scene_material ), size ) ||
+         !fits ( h.polygons_offset, h.polygons, sizeof ( scene_polygon ), size ) ||
+         !fits ( h.bodies_offset, h.bodies, sizeof ( scene_body ), size ) ||
+         !fits ( h.joints_offset, h.joints, sizeof ( scene_joint ), size ) ) {
+        m_error = "compiled scene is cut short";
+        return false;
+    }
+
+    scene_file loaded;
+
+    loaded.m_gravity.set ( h.gravity_x, h.gravity_y );
+
+    if ( !read_section ( in, h.materials_offset, h.materials, loaded.m_materials ) ||
+         !read_section ( in, h.polygons_offset, h.polygons, loaded.m_polygons ) ||
+         !read_section ( in, h.bodies_offset, h.bodies, loaded.m_bodies ) ||
+         !read_section ( in, h.joints_offset, h.joints, loaded.m_joints ) ) {
+        m_error = "compiled scene is cut short";
+        return false;
+    }
+
+    // the indices have to be good before anything is built from them
+    for ( const scene_material& m : loaded.m_materials ) {
+        if ( !std::isfinite ( m.density ) || m.density < 0.0f ) {
+            m_error = "compiled scene has a bad material";
+            return false;
+        }
+    }
+
+    loaded.m_polygon_areas.resize ( h.polygons );
+
+    for ( unsigned int i = 0; i < h.polygons; ++i ) {
+        loaded.m_polygon_areas [ i ] = polygon_area ( loaded.m_polygons [ i ] );
+
+        if ( loaded.m_polygon_areas [ i ] <= 0.0f ) {
+            m_error = "compiled scene has a bad polygon";
+            return false;
+        }
+    }
+
+    for ( const scene_body& b : loaded.m_bodies ) {
+        if ( b.shape >= k_num_shape_kinds ||
+             b.material >= h.materials ||
+             ( b.shape == shape_polygon && b.polygon >= h.polygons ) ) {
+            m_error = "compiled scene has a bad body";
+            return false;
+        }
+    }
+
+    for ( const scene_joint& j : loaded.m_joints ) {
+        if ( j.a >= h.bodies || j.b >= h.bodies || j.def.kind >= k_num_joint_kinds ) {
+            m_error = "compiled scene has a bad joint";
+            return false;
+        }
+    }
+
+    *this = std::move ( loaded );
+
+    return true;
+}
+
+void scene_file::build ( quad_world& world ) const
+{
+    unsigned int count = static_cast<unsigned int> ( m_bodies.size ( ) );
+
+    world.set_gravity ( m_gravity );
+    world.reserve ( world.size ( ) + count );
+
+    std::vector<unsigned int> polygons ( m_polygons.size ( ) );
+
+    for ( std::size_t i = 0; i < m_polygons.size ( ); ++i ) {
+        polygons [ i ] = world.add_polygon ( m_polygons [ i ].points, m_polygons [ i ].count );
+    }
+
+    // handles only for the joints to find their bodies by
+    std::vector<quad_world::handle> handles ( m_joints.empty ( ) ? 0 : count );
+
+    quad_world::body_def batch [ k_batch ];
+
+    for ( unsigned int first = 0; first < count; first += k_batch ) {
+        unsigned int n = std::min ( k_batch, count - first );
+
+        for ( unsigned int i = 0; i < n; ++i ) {
+            const scene_body& b = m_bodies [ first + i ];
+            quad_world::body_def& def = batch [ i ];
+            float density = m_materials [ b.material ].density;
+
+            def.shape = b.shape;
+            def.polygon = b.shape == shape_polygon ? polygons [ b.polygon ] : quad_world::k_no_polygon;
+            def.center = b.center;
+            def.size = b.size;
+            def.rotation = b.rotation;
+            def.bullet = ( b.flags & scene_body::k_bullet ) != 0;
+
+            if ( b.shape == shape_circle ) {
+                def.mass = density * k_pi * b.size.x ( ) * b.size.x ( );
+            } else if ( b.shape == shape_polygon ) {
+                def.mass = density * m_polygon_areas [ b.polygon ];
+            } else {
+                def.mass = density * b.size.x ( ) * b.size.y ( );
+            }
+        }
+
+        world.create_bodies ( batch, n, handles.empty ( ) ? nullptr : &handles [ first ] );
+    }
+
+    for ( const scene_joint& j : m_joints ) {
+        world.create_joint ( handles [ j.a ], handles [ j.b ], j.def );
+    }
+}
+
+unsigned int scene_file::add_material ( float density )
+{
+    m_materials.push_back ( scene_material { std::max ( density, 0.0f ) } );
+
+    return static_cast<unsigned int> ( m_materials.size ( ) - 1 );
+}
+
+unsigned int scene_file::add_polygon ( const vec2* points, unsigned int count )
+{
+    if ( count < 3 || count > convex_polygon::k_max_vertices ) {
+        return k_none;
+    }
+
+    scene_polygon p;
+    p.count = count;
+    std::copy ( points, points + count, p.points );
+
+    float area = polygon_area ( p );
+
+    if ( area <= 0.0f ) {
+        return k_none;
+    }
+
+    m_polygons.push_back ( p );
+    m_polygon_areas.push_back ( area );
+
+    return static_cast<unsigned int> ( m_polygons.size ( ) - 1 );
+}
+
+unsigned int scene_file::add_box ( unsigned int material, const vec2& center, float width, float height, float rotation )
+{
+    m_bodies.push_back ( scene_body { shape_box, 0, material, 0, center, vec2 { width, height }, rotation } );
+
+    return static_cast<unsigned int> ( m_bodies.size ( ) - 1 );
+}
+
+unsigned int scene_file::add_circle ( unsigned int material, const vec2& center, float radius )
+{
+    m_bodies.push_back ( scene_body { shape_circle, 0, material, 0, center, vec2 { radius, radius }, 0.0f } );
+
+    return static_cast<unsigned int> ( m_bodies.size ( ) - 1 );
+}
+
+unsigned int scene_file::add_shape ( unsigned int polygon, unsigned int material, const vec2& center, float rotation )
+{
+    m_bodies.push_back ( scene_body { shape_polygon, polygon, material, 0, center, vec2 { }, rotation } );
+
+    return static_cast<unsigned int> ( m_bodies.size ( ) - 1 );
+}
+
+void scene_file::add_joint ( unsigned int a, unsigned int b, const joint_def& def )
+{
+    m_joints.push_back ( scene_joint { a, b, def } );
+}
+
+void scene_file::set_bullet ( unsigned int body, bool bullet )
+{
+    if ( bullet ) {
+        m_bodies [ body ].flags |= scene_body::k_bullet;
+    } else {
+        m_bodies [ body ].flags &= ~scene_body::k_bullet;
+    }
+}
+
+void scene_file::grid ( unsigned int material,
+                        const vec2& origin,
+                        unsigned int columns,
+                        unsigned int rows,
+                        float width,
+                        float height,
+                        float gap )
+{
+    m_bodies.reserve ( m_bodies.size ( ) + columns * rows );
+
+    // a row at a time from the bottom so stacks are built upwards
+    for ( unsigned int row = 0; row < rows; ++row ) {
+        for ( unsigned int column = 0; column < columns; ++column ) {
+            vec2 center { origin.x ( ) + ( width + gap ) * column + width * 0.5f,
+                          origin.y ( ) + ( height + gap ) * row + height * 0.5f };
+
+            add_box ( material, center, width, height );
+        }
+    }
+}
+
+void scene_file::pyramid ( unsigned int material,
+                           const vec2& origin,
+                           unsigned int base,
+                           float size )
+{
+    const float spacing = size * k_pyramid_spacing;
+
+    m_bodies.reserve ( m_bodies.size ( ) + base * ( base + 1 ) / 2 );
+
+    for ( unsigned int row = 0; row < base; ++row ) {
+        unsigned int count = base - row;
+        float left = origin.x ( ) - spacing * ( count - 1 ) * 0.5f;
+
+        for ( unsigned int i = 0; i < count; ++i ) {
+            add_box ( material, vec2 { left + spacing * i, origin.y ( ) + size * ( row + 0.5f ) }, size, size );
+        }
+    }
+}
+
+void scene_file::field ( unsigned int material,
+                         const vec2& min,
+                         const vec2& max,
+                         unsigned int count,
+                         float min_size,
+                         float max_size,
+                         unsigned int seed )
+{
+    unsigned int state = seed ? seed : 1;
+
+    // uniform in [ 0, 1 ) from xorshift32, the same as the canned
+    // scenes so a field does not depend on the standard library
+    auto random = [ &state ] ( ) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return static_cast<float> ( state >> 8 ) / 16777216.0f;
+    };
+
+    vec2 extent = max - min;
+
+    m_bodies.reserve ( m_bodies.size ( ) + count );
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        float x = min.x ( ) + extent.x ( ) * random ( );
+        float y = min.y ( ) + extent.y ( ) * random ( );
+        float width = min_size + ( max_size - min_size ) * random ( );
+        float height = min_size + ( max_size - min_size ) * random ( );
+        float rotation = 2.0f * k_pi * random ( );
+
+        add_box ( material, vec2 { x, y }, width, height, rotation );
+    }
+}
@@ -0,0 +1,202 @@
+#ifndef SCENE_FILE
+#define SCENE_FILE
+
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "joint.hpp"
+#include "quad_world.hpp"
+
+// a world described as data, read from a text file people write or a
+// compiled one the loader can take in whole sections, and built into
+// a quad_world in batches. bodies take their mass from a material's
+// density, zero makes them static, and joints name their bodies by the
+// order they were added in. friction and restitution are the world's
+// solver settings and not part of the file.
+//
+// the text form is one command per line, # starts a comment, angles
+// are in radians:
+//
+//     gravity <x> <y>
+//     material <name> <density>
+//     polygon <name> <x> <y> <x> <y> ...
+//     box <material> <x> <y> <width> <height> [ <rotation> ]
+//     circle <material> <x> <y> <radius>
+//     shape <polygon> <material> <x> <y> [ <rotation> ]
+//     bullet
+//     revolute <a> <b> <x> <y> [ motor <speed> <max force> ] [ collide ]
+//     weld <a> <b> <x> <y> [ collide ]
+//     prismatic <a> <b> <x> <y> <axis x> <axis y> [ motor <speed> <max force> ] [ collide ]
+//     distance <a> <b> <ax> <ay> <bx> <by> [ <length> ] [ collide ]
+//     rope <a> <b> <ax> <ay> <bx> <by> <length> [ collide ]
+//     grid <material> <x> <y> <columns> <rows> <width> <height> [ <gap> ]
+//     pyramid <material> <x> <y> <base> <size>
+//     field <material> <min x> <min y> <max x> <max y> <count> <min size> <max size> [ <seed> ]
+//
+// bullet marks the last body added. joint body indices below zero count
+// back from the last body, -1 is the last. the material static, of
+// density zero, is always there. grid, pyramid and field are the
+// generators below.
+//
+// the compiled form is a scene_file_header and then the materials,
+// polygons, bodies and joints as they are laid out in memory, each
+// section on a 64 byte boundary. like a snapshot it only reads on a
+// build with the same byte order, version and record sizes.
+
+// how dense a material is, mass is density times area
+struct scene_material {
+    float density;
+};
+
+// the points as given, see make_polygon
+struct scene_polygon {
+    unsigned int count;
+    vec2 points [ convex_polygon::k_max_vertices ];
+};
+
+struct scene_body {
+    static const unsigned int k_bullet = 1;
+
+    shape_kind shape;
+
+    // index of the polygon in the file for polygons
+    unsigned int polygon;
+    unsigned int material;
+    unsigned int flags;
+
+    vec2 center;
+
+    // width and height of a box, the radius of a circle in x
+    vec2 size;
+    float rotation;
+};
+
+// a and b are body indices in the file, the def as create_joint takes it
+struct scene_joint {
+    unsigned int a;
+    unsigned int b;
+    joint_def def;
+};
+
+struct scene_file_header {
+    char magic [ 4 ];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned int header_size;
+    unsigned int polygon_size;
+    unsigned int body_size;
+    unsigned int joint_size;
+
+    unsigned int materials;
+    unsigned int polygons;
+    unsigned int bodies;
+    unsigned int joints;
+
+    float gravity_x;
+    float gravity_y;
+
+    unsigned int reserved;
+
+    // byte offsets from the start of the file
+    unsigned long long materials_offset;
+    unsigned long long polygons_offset;
+    unsigned long long bodies_offset;
+    unsigned long long joints_offset;
+    unsigned long long file_size;
+};
+
+class scene_file {
+public:
+    static const unsigned int k_version = 1;
+    static const unsigned int k_static = 0;
+    static const unsigned int k_none = ~0u;
+
+    scene_file ( );
+
+    void clear ( );
+
+    // replace the scene with a text or compiled file, told apart by
+    // the magic. returns false with the reason in error if it cannot
+    // be read, what was read of a text file before a bad line is kept
+    bool read ( const std::string& path );
+
+    // the text form from a stream, added to what is already there
+    bool parse ( std::istream& in );
+
+    // the compiled form
+    bool write ( const std::string& path ) const;
+
+    // set when read, parse or write fails, text errors give the line
+    const std::string& error ( ) const { return m_error; }
+
+    // set the gravity and create every polygon, body and joint in
+    // world, next to whatever is already in it
+    void build ( quad_world& world ) const;
+
+    void set_gravity ( const vec2& gravity ) { m_gravity = gravity; }
+    const vec2& gravity ( ) const { return m_gravity; }
+
+    unsigned int add_material ( float density );
+
+    // returns k_none if make_polygon would not accept the points
+    unsigned int add_polygon ( const vec2* points, unsigned int count );
+
+    unsigned int add_box ( unsigned int material, const vec2& center, float width, float height, float rotation = 0.0f );
+    unsigned int add_circle ( unsigned int material, const vec2& center, float radius );
+    unsigned int add_shape ( unsigned int polygon, unsigned int material, const vec2& center, float rotation = 0.0f );
+    void add_joint ( unsigned int a, unsigned int b, const joint_def& def );
+
+    void set_bullet ( unsigned int body, bool bullet );
+
+    // columns by rows boxes with their bottom left corner at origin
+    // and gap between them, touching columns stack when gap is zero
+    void grid ( unsigned int material,
+                const vec2& origin,
+                unsigned int columns,
+                unsigned int rows,
+                float width,
+                float height,
+                float gap = 0.0f );
+
+    // rows of square boxes, base wide at the bottom and one fewer
+    // each row up, centered on origin.x and standing on origin.y
+    void pyramid ( unsigned int material,
+                   const vec2& origin,
+                   unsigned int base,
+                   float size );
+
+    // count boxes of random size and angle anywhere in the box from
+    // min to max, free to overlap. the same seed gives the same field
+    void field ( unsigned int material,
+                 const vec2& min,
+                 const vec2& max,
+                 unsigned int count,
+                 float min_size,
+                 float max_size,
+                 unsigned int seed = 1 );
+
+    const std::vector<scene_material>& materials ( ) const { return m_materials; }
+    const std::vector<scene_polygon>& polygons ( ) const { return m_polygons; }
+    const std::vector<scene_body>& bodies ( ) const { return m_bodies; }
+    const std::vector<scene_joint>& joints ( ) const { return m_joints; }
+
+private:
+
+    bool read_compiled ( std::istream& in );
+
+    // area of each polygon, for the masses
+    std::vector<float> m_polygon_areas;
+
+    std::vector<scene_material> m_materials;
+    std::vector<scene_polygon> m_polygons;
+    std::vector<scene_body> m_bodies;
+    std::vector<scene_joint> m_joints;
+
+    vec2 m_gravity;
+
+    // write is const but still says why it failed
+    mutable std::string m_error;
+};
+
+#endif
@@ -0,0 +1,304 @@
+#include "shape_collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+    // contact ids of circles, the polygon feature index goes above these
+    const unsigned int k_face_feature = 0;
+    const unsigned int k_vertex_feature = 0x80;
+
+    inline unsigned int next ( unsigned int i, unsigned int count )
+    {
+        return i + 1 < count ? i + 1 : 0;
+    }
+
+    // halfway between a surface point at distance a and one at
+    // distance b from origin along the unit normal
+    inline vec2 midpoint ( const vec2& origin, const vec2& normal, float a, float b )
+    {
+        return origin + normal * ( ( a + b ) * 0.5f );
+    }
+
+    typedef bool ( *collide_function ) ( const shape_instance& a,
+                                         const shape_instance& b,
+                                         contact_manifold& manifold );
+
+    // boxes take the kernels with four vertices fixed, polygons the
+    // ones that look their count up
+    template < shape_kind Kind >
+    struct vertex_count {
+        typedef runtime_count type;
+
+        static type of ( const shape_instance& shape ) { return runtime_count { shape.count }; }
+    };
+
+    template < >
+    struct vertex_count<shape_box> {
+        typedef fixed_count<4> type;
+
+        static type of ( const shape_instance& ) { return type ( ); }
+    };
+
+    // the circle against polygon test for a fixed or run time count
+    template < typename Count >
+    bool circle_convex ( const vec2& center,
+                         float radius,
+                         const vec2* vertices,
+                         const vec2* normals,
+                         Count count,
+                         contact_manifold& manifold )
+    {
+        manifold.count = 0;
+
+        // the face the center is furthest in front of
+        unsigned int face = 0;
+        float separation = std::numeric_limits<float>::lowest ( );
+
+        for ( unsigned int i = 0; i < count; ++i ) {
+            float s = normals [ i ].dot ( center - vertices [ i ] );
+
+            if ( s > radius ) {
+                return false;
+            }
+
+            if ( s > separation ) {
+                separation = s;
+                face = i;
+            }
+        }
+
+        const vec2& face_normal = normals [ face ];
+        const vec2& v1 = vertices [ face ];
+        const vec2& v2 = vertices [ next ( face, count ) ];
+
+        contact_point& cp = manifold.points [ manifold.count++ ];
+
+        // past either end of the face the nearest vertex is closest
+        if ( separation > 0.0f ) {
+            const vec2* corner = nullptr;
+            unsigned int corner_index = 0;
+
+            if ( ( center - v1 ).dot ( v2 - v1 ) <= 0.0f ) {
+                corner = &v1;
+                corner_index = face;
+            } else if ( ( center - v2 ).dot ( v1 - v2 ) <= 0.0f ) {
+                corner = &v2;
+                corner_index = next ( face, count );
+            }
+
+            if ( corner ) {
+                vec2 d = *corner - center;
+                float distance2 = d.dot ( d );
+
+                if ( distance2 > radius * radius ) {
+                    manifold.count = 0;
+                    return false;
+                }
+
+                float distance = std::sqrt ( distance2 );
+                vec2 normal = distance > std::numeric_limits<float>::epsilon ( ) ? d / distance : -face_normal;
+
+                cp.point = midpoint ( center, normal, radius, distance );
+                cp.separation = distance - radius;
+                cp.id = ( corner_index << 8 ) | k_vertex_feature;
+
+                manifold.normal = normal;
+
+                return true;
+            }
+        }
+
+        // the face, the center may be inside
+        manifold.normal = -face_normal;
+
+        cp.point = midpoint ( center, manifold.normal, radius, separation );
+        cp.separation = separation - radius;
+        cp.id = ( face << 8 ) | k_face_feature;
+
+        return true;
+    }
+
+    bool box_box ( const shape_instance& a, const shape_instance& b, contact_manifold& manifold )
+    {
+        return collide_boxes ( a.vertices, b.vertices, manifold );
+    }
+
+    bool polygon_polygon ( const shape_instance& a, const shape_instance& b, contact_manifold& manifold )
+    {
+        return collide_polygons ( a.vertices, a.count, b.vertices, b.count, manifold );
+    }
+
+    bool circle_circle ( const shape_instance& a, const shape_instance& b, contact_manifold& manifold )
+    {
+        return collide_circles ( a.center, a.radius, b.center, b.radius, manifold );
+    }
+
+    template < shape_kind Kind >
+    bool circle_polygon ( const shape_instance& a, const shape_instance& b, contact_manifold& manifold )
+    {
+        return circle_convex ( a.center, a.radius, b.vertices, b.normals, vertex_count<Kind>::of ( b ), manifold );
+    }
+
+    // the kernel takes the circle first, turn the normal back around
+    template < shape_kind Kind >
+    bool polygon_circle ( const shape_instance& a, const shape_instance& b, contact_manifold& manifold )
+    {
+        if ( !circle_convex ( b.center, b.radius, a.vertices, a.normals, vertex_count<Kind>::of ( a ), manifold ) ) {
+            return false;
+        }
+
+        manifold.normal = -manifold.normal;
+
+        return true;
+    }
+
+    // by the kind of a then b. box against polygon goes through the
+    // polygon table, which has its own kernels for a count of four
+    const collide_function k_collide [ k_num_shape_kinds ][ k_num_shape_kinds ] = {
+        { box_box, polygon_circle<shape_box>, polygon_polygon },
+        { circle_polygon<shape_box>, circle_circle, circle_polygon<shape_polygon> },
+        { polygon_polygon, polygon_circle<shape_polygon>, polygon_polygon }
+    };
+
+    static_assert ( convex_polygon::k_max_vertices <= k_max_fixed_vertices,
+                    "every polygon gets a kernel with its count fixed" );
+
+}
+
+bool make_polygon ( const vec2* points,
+                    unsigned int count,
+                    convex_polygon& polygon )
+{
+    if ( count < 3 || count > convex_polygon::k_max_vertices ) {
+        return false;
+    }
+
+    // twice the signed area, negative for clockwise points
+    float area2 = 0.0f;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        area2 += points [ i ].perp_dot ( points [ next ( i, count ) ] );
+    }
+
+    if ( std::fabs ( area2 ) <= std::numeric_limits<float>::epsilon ( ) ) {
+        return false;
+    }
+
+    polygon.count = count;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        polygon.vertices [ i ] = area2 > 0.0f ? points [ i ] : points [ count - 1 - i ];
+    }
+
+    area2 = std::fabs ( area2 );
+
+    // every corner turns left
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const vec2& v0 = polygon.vertices [ i ];
+        const vec2& v1 = polygon.vertices [ next ( i, count ) ];
+        const vec2& v2 = polygon.vertices [ next ( next ( i, count ), count ) ];
+
+        if ( ( v1 - v0 ).perp_dot ( v2 - v1 ) <= 0.0f ) {
+            return false;
+        }
+    }
+
+    // centroid as the area weighted centers of the fan triangles
+    vec2 centroid;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const vec2& v0 = polygon.vertices [ i ];
+        const vec2& v1 = polygon.vertices [ next ( i, count ) ];
+
+        centroid += ( v0 + v1 ) * v0.perp_dot ( v1 );
+    }
+
+    centroid /= 3.0f * area2;
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        polygon.vertices [ i ] -= centroid;
+    }
+
+    // second moment of the fan triangles about the centroid, divided
+    // by the area for a mass of one
+    float moment = 0.0f;
+
+    polygon.radius = 0.0f;
+    polygon.extents = vec2 { };
+
+    for ( unsigned int i = 0; i < count; ++i ) {
+        const vec2& v0 = polygon.vertices [ i ];
+        const vec2& v1 = polygon.vertices [ next ( i, count ) ];
+
+        moment += v0.perp_dot ( v1 ) * ( v0.dot ( v0 ) + v0.dot ( v1 ) + v1.dot ( v1 ) );
+
+        vec2 normal { v1.y ( ) - v0.y ( ), v0.x ( ) - v1.x ( ) };
+        normal.normalize ( );
+
+        polygon.normals [ i ] = normal;
+        polygon.radius = std::max ( polygon.radius, v0.mag ( ) );
+        polygon.extents.set ( std::max ( polygon.extents.x ( ), std::fabs ( v0.x ( ) ) ),
+                              std::max ( polygon.extents.y ( ), std::fabs ( v0.y ( ) ) ) );
+    }
+
+    polygon.area = area2 * 0.5f;
+    polygon.inertia = moment / ( 6.0f * area2 );
+
+    return true;
+}
+
+bool collide_circles ( const vec2& a_center,
+                       float a_radius,
+                       const vec2& b_center,
+                       float b_radius,
+                       contact_manifold& manifold )
+{
+    manifold.count = 0;
+
+    vec2 d = b_center - a_center;
+    float reach = a_radius + b_radius;
+    float distance2 = d.dot ( d );
+
+    if ( distance2 > reach * reach ) {
+        return false;
+    }
+
+    float distance = std::sqrt ( distance2 );
+
+    // concentric, any direction will do
+    vec2 normal { 0.0f, 1.0f };
+
+    if ( distance > std::numeric_limits<float>::epsilon ( ) ) {
+        normal = d / distance;
+    }
+
+    contact_point& cp = manifold.points [ manifold.count++ ];
+
+    cp.point = midpoint ( a_center, normal, a_radius, distance - b_radius );
+    cp.separation = distance - reach;
+    cp.id = 0;
+
+    manifold.normal = normal;
+
+    return true;
+}
+
+bool collide_circle_polygon ( const vec2& center,
+                              float radius,
+                              const vec2* vertices,
+                              const vec2* normals,
+                              unsigned int count,
+                              contact_manifold& manifold )
+{
+    return circle_convex ( center, radius, vertices, normals, runtime_count { count }, manifold );
+}
+
+bool collide_shapes ( const shape_instance& a,
+                      const shape_instance& b,
+                      contact_manifold& manifold )
+{
+    return k_collide [ a.kind ][ b.kind ] ( a, b, manifold );
+}
@@ -0,0 +1,84 @@
+#ifndef SHAPE_COLLISION
+#define SHAPE_COLLISION
+
+#include "box_collision.hpp"
+
+enum shape_kind {
+    shape_box,
+    shape_circle,
+    shape_polygon,
+    k_num_shape_kinds
+};
+
+// a convex polygon in its own frame, counter clockwise around its
+// centroid. the vertices are kept inline so a polygon never allocates
+// and whole arrays of them copy as plain memory
+struct convex_polygon {
+    static const unsigned int k_max_vertices = 8;
+
+    unsigned int count;
+    vec2 vertices [ k_max_vertices ];
+
+    // unit outward normal of the edge from vertex i to i + 1
+    vec2 normals [ k_max_vertices ];
+
+    // furthest vertex from the centroid, and the furthest along each
+    // axis, so the box of half extents covers the polygon
+    float radius;
+    vec2 extents;
+
+    float area;
+
+    // moment of inertia about the centroid for a mass of one
+    float inertia;
+};
+
+// build a polygon from count points around the origin, in either
+// winding. the points are moved so the centroid is at the origin.
+// returns false for fewer than three or more than k_max_vertices
+// points, or points that are not convex or enclose no area
+bool make_polygon ( const vec2* points,
+                    unsigned int count,
+                    convex_polygon& polygon );
+
+// one body's shape posed in world space for the narrow phase. boxes
+// and polygons fill count vertices counter clockwise and the unit
+// normals of their edges, rotated from the ones worked out up front
+// rather than rebuilt from the vertices. circles only fill the center
+// and radius
+struct shape_instance {
+    shape_kind kind;
+    unsigned int count;
+    vec2 center;
+    float radius;
+    vec2 vertices [ convex_polygon::k_max_vertices ];
+    vec2 normals [ convex_polygon::k_max_vertices ];
+};
+
+// circle against circle, one point halfway between the surfaces
+bool collide_circles ( const vec2& a_center,
+                       float a_radius,
+                       const vec2& b_center,
+                       float b_radius,
+                       contact_manifold& manifold );
+
+// circle a against a counter clockwise polygon b with the unit normal
+// of each edge, the normal points from the circle to the polygon. the
+// closest feature is the face the center is in front of or the vertex
+// it is nearest to
+bool collide_circle_polygon ( const vec2& center,
+                              float radius,
+                              const vec2* vertices,
+                              const vec2* normals,
+                              unsigned int count,
+                              contact_manifold& manifold );
+
+// picks the kernel for the pair of shape kinds from a table, each kind
+// pair has its own so circles never pay for the polygon clipping and
+// boxes run with their four vertices fixed at compile time. the
+// manifold's normal points from a to b whichever order the kernel takes
+bool collide_shapes ( const shape_instance& a,
+                      const shape_instance& b,
+                      contact_manifold& manifold );
+
+#endif
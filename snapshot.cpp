@@ -0,0 +1,421 @@
+#include "snapshot.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "quad_world.hpp"
+
+namespace {
+
+    const char k_magic [ 4 ] = { 'R', 'B', 'Q', 'S' };
+    const unsigned int k_byte_order = 0x01020304u;
+
+    // every section starts on a cache line so it can be used in place
+    const unsigned long long k_section_align = 64;
+
+    static_assert ( std::is_trivially_copyable<contact_constraint>::value,
+                    "contacts are written as raw memory" );
+    static_assert ( std::is_trivially_copyable<joint_constraint>::value,
+                    "joints are written as raw memory" );
+    static_assert ( std::is_trivially_copyable<convex_polygon>::value,
+                    "polygons are written as raw memory" );
+
+    unsigned long long align_up ( unsigned long long offset )
+    {
+        return ( offset + k_section_align - 1 ) & ~( k_section_align - 1 );
+    }
+
+    // count records of record bytes starting at offset fit in size
+    // bytes, worked out so a crafted offset or count cannot wrap
+    bool fits ( unsigned long long offset,
+                unsigned long long count,
+                unsigned long long record,
+                unsigned long long size )
+    {
+        return offset <= size && ( record == 0 || count <= ( size - offset ) / record );
+    }
+
+    // a section's bytes at offset, padding the gap before it with zeros
+    void write_section ( std::ofstream& out,
+                         unsigned long long& position,
+                         unsigned long long offset,
+                         const void* data,
+                         unsigned long long bytes )
+    {
+        static const char k_zeros [ k_section_align ] = { };
+
+        out.write ( k_zeros, static_cast<std::streamsize> ( offset - position ) );
+        out.write ( static_cast<const char*> ( data ), static_cast<std::streamsize> ( bytes ) );
+
+        position = offset + bytes;
+    }
+
+}
+
+snapshot_view::snapshot_view ( ) :
+    m_data { nullptr },
+    m_mapping { nullptr },
+    m_mapped_size { 0 }
+{
+
+}
+
+snapshot_view::~snapshot_view ( )
+{
+    close ( );
+}
+
+bool snapshot_view::map ( const std::string& path )
+{
+    close ( );
+
+    int fd = ::open ( path.c_str ( ), O_RDONLY );
+
+    if ( fd < 0 ) {
+        return false;
+    }
+
+    struct stat info;
+
+    if ( ::fstat ( fd, &info ) != 0 || info.st_size < static_cast<off_t> ( sizeof ( snapshot_header ) ) ) {
+        ::close ( fd );
+        return false;
+    }
+
+    size_t size = static_cast<size_t> ( info.st_size );
+    void* mapping = ::mmap ( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    // the mapping holds its own reference to the file
+    ::close ( fd );
+
+    if ( mapping == MAP_FAILED ) {
+        return false;
+    }
+
+    if ( !check ( mapping, size ) ) {
+        ::munmap ( mapping, size );
+        return false;
+    }
+
+    m_data = mapping;
+    m_mapping = mapping;
+    m_mapped_size = size;
+
+    return true;
+}
+
+bool snapshot_view::view ( const void* data, size_t size )
+{
+    close ( );
+
+    if ( !check ( data, size ) ) {
+        return false;
+    }
+
+    m_data = data;
+
+    return true;
+}
+
+void snapshot_view::close ( )
+{
+    if ( m_mapping ) {
+        ::munmap ( m_mapping, m_mapped_size );
+    }
+
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_mapped_size = 0;
+}
+
+bool snapshot_view::check ( const void* data, size_t size ) const
+{
+    if ( !data || size < sizeof ( snapshot_header ) ) {
+        return false;
+    }
+
+    const snapshot_header& h = *static_cast<const snapshot_header*> ( data );
+
+    if ( std::memcmp ( h.magic, k_magic, sizeof ( k_magic ) ) != 0 ||
+         h.version != k_version ||
+         h.byte_order != k_byte_order ||
+         h.header_size != sizeof ( snapshot_header ) ||
+         h.stream_count != quad_world::k_num_streams ||
+         h.contact_size != sizeof ( contact_constraint ) ||
+         h.joint_size != sizeof ( joint_constraint ) ||
+         h.polygon_size != sizeof ( convex_polygon ) ||
+         h.file_size != size ) {
+        return false;
+    }
+
+    // settings the world divides by or steps with, the grid's cell
+    // index and the accumulator's step count go bad on anything else
+    if ( h.broad_phase >= k_num_broad_phase_kinds ||
+         !std::isfinite ( h.cell_size ) || h.cell_size <= 0.0f ||
+         !std::isfinite ( h.accumulator ) || h.accumulator < 0.0f ) {
+        return false;
+    }
+
+    // every section has to fit inside the file
+    unsigned long long body_bytes = h.bodies * 1ull * sizeof ( float );
+
+    bool in_file = h.awake <= h.bodies &&
+                   h.bodies <= h.slots &&
+                   h.stream_stride >= body_bytes &&
+                   fits ( h.slots_offset, h.slots, 2 * sizeof ( unsigned int ), size ) &&
+                   fits ( h.free_slots_offset, h.free_slots, sizeof ( unsigned int ), size ) &&
+                   fits ( h.owners_offset, h.bodies, sizeof ( unsigned int ), size ) &&
+                   fits ( h.streams_offset, h.stream_count, h.stream_stride, size ) &&
+                   fits ( h.contacts_offset, h.contacts, sizeof ( contact_constraint ), size ) &&
+                   h.joints <= h.joint_slots &&
+                   fits ( h.joint_slots_offset, h.joint_slots, 2 * sizeof ( unsigned int ), size ) &&
+                   fits ( h.free_joint_slots_offset, h.free_joint_slots, sizeof ( unsigned int ), size ) &&
+                   fits ( h.joints_offset, h.joints, sizeof ( joint_constraint ), size ) &&
+                   fits ( h.polygons_offset, h.polygons, sizeof ( convex_polygon ), size );
+
+    if ( !in_file ) {
+        return false;
+    }
+
+    // and the handles have to point at bodies, or a bad file would
+    // index out of the streams later on
+    const unsigned char* bytes = static_cast<const unsigned char*> ( data );
+    const unsigned int* slots = reinterpret_cast<const unsigned int*> ( bytes + h.slots_offset );
+    const unsigned int* owners = reinterpret_cast<const unsigned int*> ( bytes + h.owners_offset );
+
+    for ( unsigned int i = 0; i < h.bodies; ++i ) {
+        if ( owners [ i ] >= h.slots || slots [ owners [ i ] * 2 ] != i ) {
+            return false;
+        }
+    }
+
+    // every shape has to be one this build knows, polygons one of the
+    // file's with no more vertices than fit
+    const float* shapes = reinterpret_cast<const float*> ( bytes + h.streams_offset + quad_world::s_shape * h.stream_stride );
+    const float* polygon_ids = reinterpret_cast<const float*> ( bytes + h.streams_offset + quad_world::s_polygon * h.stream_stride );
+    const convex_polygon* polygons = reinterpret_cast<const convex_polygon*> ( bytes + h.polygons_offset );
+
+    for ( unsigned int i = 0; i < h.bodies; ++i ) {
+        if ( !( shapes [ i ] >= 0.0f && shapes [ i ] < k_num_shape_kinds ) ||
+             ( shapes [ i ] == shape_polygon && !( polygon_ids [ i ] >= 0.0f && polygon_ids [ i ] < h.polygons ) ) ) {
+            return false;
+        }
+    }
+
+    for ( unsigned int i = 0; i < h.polygons; ++i ) {
+        if ( polygons [ i ].count < 3 || polygons [ i ].count > convex_polygon::k_max_vertices ) {
+            return false;
+        }
+    }
+
+    const contact_constraint* contacts = reinterpret_cast<const contact_constraint*> ( bytes + h.contacts_offset );
+
+    for ( unsigned int i = 0; i < h.contacts; ++i ) {
+        if ( contacts [ i ].a >= h.bodies || contacts [ i ].b >= h.bodies || contacts [ i ].count > 2 ) {
+            return false;
+        }
+    }
+
+    // joints have to be owned by their slot and join live bodies
+    const unsigned int* joint_slots = reinterpret_cast<const unsigned int*> ( bytes + h.joint_slots_offset );
+    const joint_constraint* joints = reinterpret_cast<const joint_constraint*> ( bytes + h.joints_offset );
+
+    for ( unsigned int i = 0; i < h.joints; ++i ) {
+        const joint_constraint& j = joints [ i ];
+
+        if ( j.kind >= k_num_joint_kinds || j.slot >= h.joint_slots || joint_slots [ j.slot * 2 ] != i ||
+             j.slot_a >= h.slots || slots [ j.slot_a * 2 ] >= h.bodies || owners [ slots [ j.slot_a * 2 ] ] != j.slot_a ||
+             j.slot_b >= h.slots || slots [ j.slot_b * 2 ] >= h.bodies || owners [ slots [ j.slot_b * 2 ] ] != j.slot_b ) {
+            return false;
+        }
+    }
+
+    // free slots are handed out as they are, so each has to be a slot
+    // in the file, once, that no live body or joint is using
+    const unsigned int* free_slots = reinterpret_cast<const unsigned int*> ( bytes + h.free_slots_offset );
+    std::vector<bool> freed ( h.slots, false );
+
+    for ( unsigned int i = 0; i < h.free_slots; ++i ) {
+        unsigned int s = free_slots [ i ];
+
+        if ( s >= h.slots || freed [ s ] || ( slots [ s * 2 ] < h.bodies && owners [ slots [ s * 2 ] ] == s ) ) {
+            return false;
+        }
+
+        freed [ s ] = true;
+    }
+
+    const unsigned int* free_joint_slots = reinterpret_cast<const unsigned int*> ( bytes + h.free_joint_slots_offset );
+    std::vector<bool> freed_joints ( h.joint_slots, false );
+
+    for ( unsigned int i = 0; i < h.free_joint_slots; ++i ) {
+        unsigned int s = free_joint_slots [ i ];
+
+        if ( s >= h.joint_slots || freed_joints [ s ] ||
+             ( joint_slots [ s * 2 ] < h.joints && joints [ joint_slots [ s * 2 ] ].slot == s ) ) {
+            return false;
+        }
+
+        freed_joints [ s ] = true;
+    }
+
+    return true;
+}
+
+bool quad_world::save ( const std::string& path ) const
+{
+    const std::vector<contact_constraint>& contacts = m_solver.contacts ( );
+
+    snapshot_header h;
+    std::memset ( &h, 0, sizeof ( h ) );
+
+    std::memcpy ( h.magic, k_magic, sizeof ( k_magic ) );
+    h.version = snapshot_view::k_version;
+    h.byte_order = k_byte_order;
+    h.header_size = sizeof ( snapshot_header );
+    h.stream_count = k_num_streams;
+    h.contact_size = sizeof ( contact_constraint );
+    h.joint_size = sizeof ( joint_constraint );
+    h.polygon_size = sizeof ( convex_polygon );
+
+    h.bodies = size ( );
+    h.awake = m_awake;
+    h.slots = static_cast<unsigned int> ( m_slots.size ( ) );
+    h.free_slots = static_cast<unsigned int> ( m_free_slots.size ( ) );
+    h.contacts = static_cast<unsigned int> ( contacts.size ( ) );
+    h.joints = m_joints.size ( );
+    h.joint_slots = m_joints.slot_count ( );
+    h.free_joint_slots = m_joints.free_slot_count ( );
+    h.polygons = polygon_count ( );
+
+    h.broad_phase = m_broad_phase_kind;
+    h.cell_size = m_cell_size;
+    h.gravity_x = m_gravity.x ( );
+    h.gravity_y = m_gravity.y ( );
+    h.fixed_dt = m_fixed_dt;
+    h.max_substeps = m_max_substeps;
+    h.accumulator = m_accumulator;
+
+    h.sleep_enabled = m_sleep.enabled;
+    h.linear_tolerance = m_sleep.linear_tolerance;
+    h.angular_tolerance = m_sleep.angular_tolerance;
+    h.time_to_sleep = m_sleep.time_to_sleep;
+
+    const solver_settings& solver = m_solver.settings ( );
+
+    h.velocity_iterations = solver.velocity_iterations;
+    h.warm_starting = solver.warm_starting;
+    h.friction = solver.friction;
+    h.restitution = solver.restitution;
+    h.restitution_threshold = solver.restitution_threshold;
+    h.baumgarte = solver.baumgarte;
+    h.slop = solver.slop;
+
+    unsigned long long body_bytes = h.bodies * sizeof ( float );
+
+    h.slots_offset = align_up ( sizeof ( snapshot_header ) );
+    h.free_slots_offset = align_up ( h.slots_offset + h.slots * sizeof ( slot ) );
+    h.owners_offset = align_up ( h.free_slots_offset + h.free_slots * sizeof ( unsigned int ) );
+    h.streams_offset = align_up ( h.owners_offset + body_bytes );
+    h.stream_stride = align_up ( body_bytes );
+    h.contacts_offset = h.streams_offset + h.stream_stride * k_num_streams;
+    h.joint_slots_offset = align_up ( h.contacts_offset + h.contacts * sizeof ( contact_constraint ) );
+    h.free_joint_slots_offset = align_up ( h.joint_slots_offset + h.joint_slots * 2 * sizeof ( unsigned int ) );
+    h.joints_offset = align_up ( h.free_joint_slots_offset + h.free_joint_slots * sizeof ( unsigned int ) );
+    h.polygons_offset = align_up ( h.joints_offset + h.joints * sizeof ( joint_constraint ) );
+    h.file_size = h.polygons_offset + h.polygons * sizeof ( convex_polygon );
+
+    std::ofstream out { path, std::ios::binary | std::ios::trunc };
+
+    if ( !out ) {
+        return false;
+    }
+
+    unsigned long long position = 0;
+
+    write_section ( out, position, 0, &h, sizeof ( h ) );
+    write_section ( out, position, h.slots_offset, m_slots.data ( ), h.slots * sizeof ( slot ) );
+    write_section ( out, position, h.free_slots_offset, m_free_slots.data ( ), h.free_slots * sizeof ( unsigned int ) );
+    write_section ( out, position, h.owners_offset, m_owners.data ( ), body_bytes );
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        write_section ( out, position, h.streams_offset + i * h.stream_stride, m_streams [ i ].data ( ), body_bytes );
+    }
+
+    write_section ( out, position, h.contacts_offset, contacts.data ( ), h.contacts * sizeof ( contact_constraint ) );
+    write_section ( out, position, h.joint_slots_offset, m_joints.slots ( ), h.joint_slots * 2 * sizeof ( unsigned int ) );
+    write_section ( out, position, h.free_joint_slots_offset, m_joints.free_slots ( ), h.free_joint_slots * sizeof ( unsigned int ) );
+    write_section ( out, position, h.joints_offset, m_joints.data ( ), h.joints * sizeof ( joint_constraint ) );
+    write_section ( out, position, h.polygons_offset, m_polygons.data ( ), h.polygons * sizeof ( convex_polygon ) );
+
+    return static_cast<bool> ( out );
+}
+
+bool quad_world::load ( const std::string& path )
+{
+    snapshot_view view;
+
+    return view.map ( path ) && load ( view );
+}
+
+bool quad_world::load ( const snapshot_view& view )
+{
+    static_assert ( sizeof ( slot ) == 2 * sizeof ( unsigned int ), "slots are written as index, generation pairs" );
+
+    if ( !view.valid ( ) ) {
+        return false;
+    }
+
+    const snapshot_header& h = view.header ( );
+
+    m_slots.resize ( h.slots );
+    std::memcpy ( m_slots.data ( ), view.slots ( ), h.slots * sizeof ( slot ) );
+
+    m_free_slots.assign ( view.free_slots ( ), view.free_slots ( ) + h.free_slots );
+    m_owners.assign ( view.owners ( ), view.owners ( ) + h.bodies );
+
+    for ( unsigned int i = 0; i < k_num_streams; ++i ) {
+        m_streams [ i ].assign ( view.stream ( i ), view.stream ( i ) + h.bodies );
+    }
+
+    m_polygons.assign ( view.polygons ( ), view.polygons ( ) + h.polygons );
+    m_bounds_stale = true;
+
+    m_awake = h.awake;
+    m_gravity = vec2 { h.gravity_x, h.gravity_y };
+    set_fixed_step ( h.fixed_dt, h.max_substeps );
+    m_accumulator = h.accumulator;
+
+    m_sleep.enabled = h.sleep_enabled != 0;
+    m_sleep.linear_tolerance = h.linear_tolerance;
+    m_sleep.angular_tolerance = h.angular_tolerance;
+    m_sleep.time_to_sleep = h.time_to_sleep;
+
+    solver_settings& solver = m_solver.settings ( );
+
+    solver.velocity_iterations = h.velocity_iterations;
+    solver.warm_starting = h.warm_starting != 0;
+    solver.friction = h.friction;
+    solver.restitution = h.restitution;
+    solver.restitution_threshold = h.restitution_threshold;
+    solver.baumgarte = h.baumgarte;
+    solver.slop = h.slop;
+
+    m_solver.restore ( view.contacts ( ), h.contacts );
+    m_joints.restore ( view.joints ( ), h.joints,
+                       view.joint_slots ( ), h.joint_slots,
+                       view.free_joint_slots ( ), h.free_joint_slots );
+
+    // the broad phase rebuilds itself from the bounds on the next step
+    set_broad_phase ( static_cast<broad_phase_kind> ( h.broad_phase ), h.cell_size );
+
+    return true;
+}
@@ -0,0 +1,144 @@
+#ifndef SNAPSHOT
+#define SNAPSHOT
+
+#include <cstddef>
+#include <string>
+
+#include "contact_solver.hpp"
+#include "joint.hpp"
+#include "shape_collision.hpp"
+
+// on disk image of a quad_world, written by quad_world::save and read
+// back by quad_world::load. it is the world's own memory laid end to
+// end: the header, the handle slots, the dense owners, every stream
+// as one run of floats, the contacts kept for warm starting, the
+// joints with their handle slots and the shared polygons, each
+// section starting on a 64 byte boundary. loading maps the file and
+// copies whole sections, nothing is parsed field by field.
+//
+// the format is native endian and holds contact_constraint,
+// joint_constraint and convex_polygon as they are laid out in memory,
+// so a snapshot only loads on a build with the same byte order,
+// version, stream count, contact, joint and polygon size.
+struct snapshot_header {
+    char magic [ 4 ];
+    unsigned int version;
+    unsigned int byte_order;
+    unsigned int header_size;
+    unsigned int stream_count;
+    unsigned int contact_size;
+    unsigned int joint_size;
+    unsigned int polygon_size;
+
+    unsigned int bodies;
+    unsigned int awake;
+    unsigned int slots;
+    unsigned int free_slots;
+    unsigned int contacts;
+    unsigned int joints;
+    unsigned int joint_slots;
+    unsigned int free_joint_slots;
+    unsigned int polygons;
+
+    unsigned int broad_phase;
+    float cell_size;
+
+    float gravity_x;
+    float gravity_y;
+
+    float fixed_dt;
+    unsigned int max_substeps;
+    float accumulator;
+
+    unsigned int sleep_enabled;
+    float linear_tolerance;
+    float angular_tolerance;
+    float time_to_sleep;
+
+    unsigned int velocity_iterations;
+    unsigned int warm_starting;
+    float friction;
+    float restitution;
+    float restitution_threshold;
+    float baumgarte;
+    float slop;
+
+    unsigned int reserved;
+
+    // byte offsets from the start of the file. streams are
+    // stream_stride bytes apart
+    unsigned long long slots_offset;
+    unsigned long long free_slots_offset;
+    unsigned long long owners_offset;
+    unsigned long long streams_offset;
+    unsigned long long stream_stride;
+    unsigned long long contacts_offset;
+    unsigned long long joint_slots_offset;
+    unsigned long long free_joint_slots_offset;
+    unsigned long long joints_offset;
+    unsigned long long polygons_offset;
+    unsigned long long file_size;
+};
+
+// read only view of a snapshot, either mapped from a file or over a
+// buffer the caller keeps alive. the accessors point straight into it.
+class snapshot_view {
+public:
+    static const unsigned int k_version = 4;
+
+    snapshot_view ( );
+    ~snapshot_view ( );
+
+    snapshot_view ( const snapshot_view& ) = delete;
+    snapshot_view& operator= ( const snapshot_view& ) = delete;
+
+    // returns false if the file cannot be mapped or is not a
+    // snapshot this build can read
+    bool map ( const std::string& path );
+
+    // same checks over memory, which must outlive the view
+    bool view ( const void* data, size_t size );
+
+    void close ( );
+
+    bool valid ( ) const { return m_data != nullptr; }
+    const snapshot_header& header ( ) const { return *static_cast<const snapshot_header*> ( m_data ); }
+
+    // index and generation of each handle slot, interleaved
+    const unsigned int* slots ( ) const { return at<unsigned int> ( header ( ).slots_offset ); }
+    const unsigned int* free_slots ( ) const { return at<unsigned int> ( header ( ).free_slots_offset ); }
+    const unsigned int* owners ( ) const { return at<unsigned int> ( header ( ).owners_offset ); }
+
+    // stream is a quad_world::stream
+    const float* stream ( unsigned int stream ) const
+    {
+        return at<float> ( header ( ).streams_offset + stream * header ( ).stream_stride );
+    }
+
+    const contact_constraint* contacts ( ) const { return at<contact_constraint> ( header ( ).contacts_offset ); }
+
+    // same layout as the body slots
+    const unsigned int* joint_slots ( ) const { return at<unsigned int> ( header ( ).joint_slots_offset ); }
+    const unsigned int* free_joint_slots ( ) const { return at<unsigned int> ( header ( ).free_joint_slots_offset ); }
+    const joint_constraint* joints ( ) const { return at<joint_constraint> ( header ( ).joints_offset ); }
+
+    const convex_polygon* polygons ( ) const { return at<convex_polygon> ( header ( ).polygons_offset ); }
+
+private:
+
+    template<typename T>
+    const T* at ( unsigned long long offset ) const
+    {
+        return reinterpret_cast<const T*> ( static_cast<const unsigned char*> ( m_data ) + offset );
+    }
+
+    bool check ( const void* data, size_t size ) const;
+
+    const void* m_data;
+
+    // set when the view owns a mapping
+    void* m_mapping;
+    size_t m_mapped_size;
+};
+
+#endif
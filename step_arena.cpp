@@ -0,0 +1,63 @@
+#include "step_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+
+    // room for the scratch of a few hundred bodies before the first grow
+    const size_t k_default_capacity = 64 * 1024;
+
+    size_t align_up ( size_t offset, size_t align )
+    {
+        return ( offset + align - 1 ) & ~( align - 1 );
+    }
+
+}
+
+step_arena::step_arena ( size_t capacity ) :
+    m_capacity { capacity ? capacity : k_default_capacity },
+    m_used { 0 },
+    m_overflow_used { 0 },
+    m_high_water { 0 }
+{
+    m_block.reset ( new unsigned char [ m_capacity ] );
+}
+
+void* step_arena::allocate ( size_t bytes, size_t align )
+{
+    uintptr_t base = reinterpret_cast<uintptr_t> ( m_block.get ( ) );
+    size_t offset = align_up ( base + m_used, align ) - base;
+
+    if ( offset + bytes <= m_capacity ) {
+        m_used = offset + bytes;
+        m_high_water = std::max ( m_high_water, used ( ) );
+
+        return m_block.get ( ) + offset;
+    }
+
+    // out of room this step, a block of its own keeps it simple and
+    // reset folds it into the main block
+    m_overflow.emplace_back ( new unsigned char [ bytes + align ] );
+    m_overflow_used += bytes + align;
+    m_high_water = std::max ( m_high_water, used ( ) );
+
+    uintptr_t overflow = reinterpret_cast<uintptr_t> ( m_overflow.back ( ).get ( ) );
+
+    return reinterpret_cast<void*> ( align_up ( overflow, align ) );
+}
+
+void step_arena::reset ( )
+{
+    if ( !m_overflow.empty ( ) ) {
+        m_overflow.clear ( );
+
+        // half again the worst step so far so a slowly growing scene
+        // does not reallocate every step
+        m_capacity = m_high_water + m_high_water / 2;
+        m_block.reset ( new unsigned char [ m_capacity ] );
+    }
+
+    m_used = 0;
+    m_overflow_used = 0;
+}
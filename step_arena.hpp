@@ -0,0 +1,55 @@
+#ifndef STEP_ARENA
+#define STEP_ARENA
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// bump allocator for scratch that only lives until the next step.
+// allocating is a pointer bump and reset frees everything at once. a
+// step that needs more than the block holds gets extra blocks, and the
+// next reset replaces them all with one block big enough for that
+// step, so after the first few steps of a scene nothing is allocated.
+// not thread safe, allocate from the stepping thread only.
+class step_arena {
+public:
+    explicit step_arena ( size_t capacity = 0 );
+
+    step_arena ( const step_arena& ) = delete;
+    step_arena& operator= ( const step_arena& ) = delete;
+
+    void* allocate ( size_t bytes, size_t align );
+
+    // uninitialized room for count objects, nothing is ever destroyed
+    template<typename T>
+    T* allocate ( size_t count )
+    {
+        static_assert ( std::is_trivially_destructible<T>::value, "arena objects are never destroyed" );
+        return static_cast<T*> ( allocate ( count * sizeof ( T ), alignof ( T ) ) );
+    }
+
+    // everything allocated since the last reset becomes invalid
+    void reset ( );
+
+    size_t capacity ( ) const { return m_capacity; }
+
+    // bytes handed out since the last reset, counting overflow
+    size_t used ( ) const { return m_used + m_overflow_used; }
+
+    // most bytes any one step has used
+    size_t high_water ( ) const { return m_high_water; }
+
+private:
+
+    std::unique_ptr<unsigned char [ ]> m_block;
+    size_t m_capacity;
+    size_t m_used;
+
+    std::vector<std::unique_ptr<unsigned char [ ]>> m_overflow;
+    size_t m_overflow_used;
+
+    size_t m_high_water;
+};
+
+#endif
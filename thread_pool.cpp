@@ -0,0 +1,182 @@
+#include "thread_pool.hpp"
+
+thread_pool::thread_pool ( unsigned int threads ) :
+    m_queued { 0 },
+    m_stop { false }
+{
+    if ( threads == 0 ) {
+        threads = std::thread::hardware_concurrency ( );
+    }
+
+    if ( threads == 0 ) {
+        threads = 1;
+    }
+
+    for ( unsigned int i = 0; i < threads; ++i ) {
+        m_queues.emplace_back ( new queue { } );
+    }
+
+    for ( unsigned int i = 1; i < threads; ++i ) {
+        m_threads.emplace_back ( &thread_pool::worker, this, i );
+    }
+}
+
+thread_pool::~thread_pool ( )
+{
+    {
+        std::lock_guard<std::mutex> lock ( m_wake_mutex );
+        m_stop = true;
+    }
+
+    m_wake.notify_all ( );
+
+    for ( unsigned int i = 0; i < m_threads.size ( ); ++i ) {
+        m_threads [ i ].join ( );
+    }
+}
+
+void thread_pool::run ( unsigned int count,
+                        unsigned int grain,
+                        invoke_function invoke,
+                        const void* task )
+{
+    if ( count == 0 ) {
+        return;
+    }
+
+    if ( grain == 0 ) {
+        grain = 1;
+    }
+
+    unsigned int chunks = ( count + grain - 1 ) / grain;
+
+    // not worth waking anyone up
+    if ( size ( ) == 1 || chunks == 1 ) {
+        invoke ( task, 0, count );
+        return;
+    }
+
+    std::atomic<unsigned int> remaining { chunks };
+
+    m_queued += chunks;
+
+    // deal the chunks out round robin so every queue starts with work
+    for ( unsigned int c = 0; c < chunks; ++c ) {
+        unsigned int first = c * grain;
+        unsigned int last = first + grain < count ? first + grain : count;
+
+        queue& q = *m_queues [ c % size ( ) ];
+
+        std::lock_guard<std::mutex> lock ( q.mutex );
+        q.push_back ( chunk { invoke, task, &remaining, first, last } );
+    }
+
+    {
+        std::lock_guard<std::mutex> lock ( m_wake_mutex );
+    }
+
+    m_wake.notify_all ( );
+
+    // help out until the last chunk has finished, which may be on
+    // another thread after our queues are empty
+    while ( remaining.load ( ) > 0 ) {
+        if ( !run_one ( 0 ) ) {
+            std::this_thread::yield ( );
+        }
+    }
+}
+
+void thread_pool::worker ( unsigned int index )
+{
+    for ( ;; ) {
+        if ( run_one ( index ) ) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock ( m_wake_mutex );
+
+        m_wake.wait ( lock, [ this ] { return m_stop || m_queued.load ( ) > 0; } );
+
+        if ( m_stop ) {
+            return;
+        }
+    }
+}
+
+bool thread_pool::run_one ( unsigned int index )
+{
+    chunk c { nullptr, nullptr, nullptr, 0, 0 };
+    bool found = false;
+
+    // newest from our own queue first, it is most likely still in cache
+    {
+        queue& own = *m_queues [ index ];
+        std::lock_guard<std::mutex> lock ( own.mutex );
+
+        if ( own.count > 0 ) {
+            c = own.pop_back ( );
+            found = true;
+        }
+    }
+
+    // then the oldest from everyone else
+    for ( unsigned int i = 1; !found && i < size ( ); ++i ) {
+        queue& victim = *m_queues [ ( index + i ) % size ( ) ];
+        std::lock_guard<std::mutex> lock ( victim.mutex );
+
+        if ( victim.count > 0 ) {
+            c = victim.pop_front ( );
+            found = true;
+        }
+    }
+
+    if ( !found ) {
+        return false;
+    }
+
+    m_queued--;
+
+    c.invoke ( c.task, c.first, c.last );
+
+    // last touch of the caller's state, it may return right after this
+    c.remaining->fetch_sub ( 1 );
+
+    return true;
+}
+
+void thread_pool::queue::push_back ( const chunk& c )
+{
+    unsigned int capacity = static_cast<unsigned int> ( chunks.size ( ) );
+
+    if ( count == capacity ) {
+        // unwrap into a buffer twice the size
+        std::vector<chunk> grown ( capacity ? capacity * 2 : 16 );
+
+        for ( unsigned int i = 0; i < count; ++i ) {
+            grown [ i ] = chunks [ ( head + i ) % capacity ];
+        }
+
+        chunks.swap ( grown );
+        head = 0;
+        capacity = static_cast<unsigned int> ( chunks.size ( ) );
+    }
+
+    chunks [ ( head + count ) % capacity ] = c;
+    count++;
+}
+
+thread_pool::chunk thread_pool::queue::pop_back ( )
+{
+    count--;
+    return chunks [ ( head + count ) % chunks.size ( ) ];
+}
+
+thread_pool::chunk thread_pool::queue::pop_front ( )
+{
+    chunk c = chunks [ head ];
+
+    head = ( head + 1 ) % static_cast<unsigned int> ( chunks.size ( ) );
+    count--;
+
+    return c;
+}
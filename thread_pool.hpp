@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads, each with its own task queue. a worker
+// takes from the back of its own queue and when that runs dry steals
+// from the front of the others, so uneven chunks even out. the thread
+// that calls parallel_for works on the chunks too instead of waiting.
+// once the queues have grown to the most chunks ever queued at once a
+// parallel_for allocates nothing.
+class thread_pool {
+public:
+    // threads counts the calling thread, 0 uses every hardware thread
+    // and 1 runs everything inline without starting any workers
+    explicit thread_pool ( unsigned int threads = 0 );
+    ~thread_pool ( );
+
+    thread_pool ( const thread_pool& ) = delete;
+    thread_pool& operator= ( const thread_pool& ) = delete;
+
+    unsigned int size ( ) const { return static_cast<unsigned int> ( m_queues.size ( ) ); }
+
+    // split [ 0, count ) into chunks of grain and call task ( first,
+    // last ) for each of them, returns once every chunk is done. the
+    // task is only referenced, never copied. must not be nested.
+    template<typename Task>
+    void parallel_for ( unsigned int count,
+                        unsigned int grain,
+                        const Task& task )
+    {
+        run ( count, grain, &invoke<Task>, &task );
+    }
+
+private:
+
+    typedef void ( *invoke_function ) ( const void* task, unsigned int first, unsigned int last );
+
+    template<typename Task>
+    static void invoke ( const void* task, unsigned int first, unsigned int last )
+    {
+        ( *static_cast<const Task*> ( task ) ) ( first, last );
+    }
+
+    struct chunk {
+        invoke_function invoke;
+        const void* task;
+        std::atomic<unsigned int>* remaining;
+        unsigned int first;
+        unsigned int last;
+    };
+
+    // ring buffer of chunks, grows by doubling and never shrinks
+    struct queue {
+        std::mutex mutex;
+        std::vector<chunk> chunks;
+        unsigned int head = 0;
+        unsigned int count = 0;
+
+        void push_back ( const chunk& c );
+        chunk pop_back ( );
+        chunk pop_front ( );
+    };
+
+    void run ( unsigned int count,
+               unsigned int grain,
+               invoke_function invoke,
+               const void* task );
+
+    void worker ( unsigned int index );
+
+    // run one chunk from queue index or stolen from another
+    bool run_one ( unsigned int index );
+
+    // the calling thread owns queue 0, worker i owns queue i
+    std::vector<std::unique_ptr<queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    // chunks sitting in any queue, workers sleep while it is zero
+    std::atomic<unsigned int> m_queued;
+
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+    bool m_stop;
+};
+
+#endif
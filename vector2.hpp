@@ -4,13 +4,15 @@
 #include <cmath>
 #include <limits>
 
+#include "fixed_point.hpp"
+
 template < typename T >
 class vector2 {
 public:
 
     // simple constructor
-    vector2 ( T x = 0.0f,
-              T y = 0.0f );
+    vector2 ( T x = T ( ),
+              T y = T ( ) );
 
     // operators
     vector2<T> operator- ( ) const;
@@ -32,7 +34,7 @@ public:
     T dot ( const vector2<T>& v ) const;
     T perp_dot ( const vector2<T>& v ) const;
 
-    float distance_to ( const vector2<T>& v ) const;
+    T distance_to ( const vector2<T>& v ) const;
 
     vector2<T> project_onto ( const vector2<T>& v ) const;
 
@@ -157,10 +159,10 @@ inline T vector2<T>::perp_dot ( const vector2<T>& v ) const
 }
 
 template < typename T >
-inline float vector2<T>::distance_to ( const vector2<T>& v ) const
+inline T vector2<T>::distance_to ( const vector2<T>& v ) const
 {
-    float x_diff = m_x - v.m_x;
-    float y_diff = m_y - v.m_y;
+    T x_diff = m_x - v.m_x;
+    T y_diff = m_y - v.m_y;
 
     return sqrt ( ( x_diff * x_diff ) + ( y_diff * y_diff ) );
 }
@@ -168,10 +170,10 @@ inline float vector2<T>::distance_to ( const vector2<T>& v ) const
 template < typename T >
 inline vector2<T> vector2<T>::project_onto ( const vector2<T>& v ) const
 {
-    float v_mag = v.mag ( );
+    T v_mag = v.mag ( );
 
-    float num = dot ( v );
-    float denum = v_mag * v_mag;
+    T num = dot ( v );
+    T denum = v_mag * v_mag;
 
     return v * ( num / denum );
 }
@@ -187,15 +189,15 @@ inline void vector2<T>::perp ()
 template < typename T >
 inline void vector2<T>::normalize ( )
 {
-    float m = mag ( );
+    T m = mag ( );
 
-    if( static_cast<float>(fabs(m)) < std::numeric_limits<float>::epsilon() ) {
-        m_x = 0.0f;
-        m_y = 0.0f;
+    if( fabs(m) < std::numeric_limits<T>::epsilon() ) {
+        m_x = T ( );
+        m_y = T ( );
         return;
     }
 
-    float d = 1.0f / m;
+    T d = T ( 1 ) / m;
 
     m_x *= d;
     m_y *= d;
@@ -204,8 +206,8 @@ inline void vector2<T>::normalize ( )
 template < typename T >
 inline void vector2<T>::zero ( )
 {
-    m_x = 0.0;
-    m_y = 0.0;
+    m_x = T ( );
+    m_y = T ( );
 }
 
 template < typename T >
@@ -216,6 +218,7 @@ inline void vector2<T>::negate ()
 }
 
 using vec2 = vector2<float>;
+using vec2_q16 = vector2<q16_16>;
 
 #endif
 